@@ -8,6 +8,7 @@ QT       += core gui
 QT       += network xml script
 
 CONFIG += network
+CONFIG += c++11
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -22,6 +23,24 @@ INCLUDEPATH += ./application/
 DEFINES     += STARSTIM_SIM  # Indicates Communicate DeviceManager to STARSTIM_SIM
 DEFINES     += NICBENCHMARK  # This is used for the NICBenchmark when using FileWriter
 
+# AVX2/FMA kernels of the noise reduction, opt-in with qmake "CONFIG+=avx2".
+# The binary then refuses to start on CPUs without them
+avx2 {
+    QMAKE_CXXFLAGS += -mavx2 -mfma
+}
+
+# Noise reduction accuracy harness, opt-in with qmake "CONFIG+=accuracy_harness".
+# It is run with "NICBenchmark2 --compare-arithmetics <file.easy> <channels>"
+accuracy_harness {
+    DEFINES += NOISEREDUCTION_ACCURACY_HARNESS
+}
+
+# Count the heap allocations of the poll thread, opt-in with qmake
+# "CONFIG+=count_allocations". They are logged every 30 seconds of streaming
+count_allocations {
+    DEFINES += COUNT_HEAP_ALLOCATIONS
+}
+
 # Output directories
 OBJECTS_DIR    = obj
 UI_HEADERS_DIR = obj
@@ -32,6 +51,9 @@ DESTDIR        = $${_PRO_FILE_PWD_}/output
 HEADERS  += src/mainwindow.h \
             src/commonparameters.h \
             src/devicestatus.h \
+            src/streamstatistics.h \
+            src/asynclogger.h \
+            src/logging.h \
     devicemanager/sleeper.h
 
 
@@ -45,7 +67,16 @@ HEADERS += devicemanager/icognosprotocol.h \
            devicemanager/fw/eeg_mgr.h \
            devicemanager/fw/stim_mgr.h \
            devicemanager/deviceconfiguration.h \
-           devicemanager/wifidevice.h
+           devicemanager/wifidevice.h \
+           devicemanager/decimator.h \
+           devicemanager/allocationcounter.h \
+           devicemanager/sampleblock.h \
+           devicemanager/biquadfilterbank.h \
+           devicemanager/noisereduction.h \
+           devicemanager/projectiongenerator.h \
+           devicemanager/linefrequencydetector.h \
+           devicemanager/mainsfrequencytracker.h \
+           devicemanager/taskpool.h
 
 
 HEADERS += application/protocoltemplates.h \
@@ -53,6 +84,17 @@ HEADERS += application/protocoltemplates.h \
            application/electrodes.h \
            application/protocoltypes.h \
            application/filewriter.h \
+           application/nedfencoder.h \
+           application/nedfreader.h \
+           application/asyncfilesink.h \
+           application/easyencoder.h \
+           application/easyreader.h \
+           application/crc32.h \
+           application/nedccodec.h \
+           application/nedcfile.h \
+           application/nedcconverter.h \
+           application/ringbuffer.h \
+           application/streammerge.h \
            application/trigger.h \
            application/protocolmanager.h \
 
@@ -61,6 +103,9 @@ HEADERS += application/protocoltemplates.h \
 SOURCES += src/main.cpp\
            src/mainwindow.cpp \
            src/devicestatus.cpp \
+           src/streamstatistics.cpp \
+           src/asynclogger.cpp \
+           src/logging.cpp \
 
 
 SOURCES += devicemanager/icognosprotocol.cpp \
@@ -68,12 +113,30 @@ SOURCES += devicemanager/icognosprotocol.cpp \
            devicemanager/devicemanager.cpp \
            devicemanager/icognoscom.cpp \
            devicemanager/deviceconfiguration.cpp \
-           devicemanager/wifidevice.cpp
+           devicemanager/wifidevice.cpp \
+           devicemanager/decimator.cpp \
+           devicemanager/allocationcounter.cpp \
+           devicemanager/biquadfilterbank.cpp \
+           devicemanager/noisereduction.cpp \
+           devicemanager/projectiongenerator.cpp \
+           devicemanager/linefrequencydetector.cpp \
+           devicemanager/mainsfrequencytracker.cpp \
+           devicemanager/taskpool.cpp
 
 
 SOURCES += application/stimprotocoltemplate.cpp  \
            application/electrodes.cpp \
            application/filewriter.cpp \
+           application/nedfencoder.cpp \
+           application/nedfreader.cpp \
+           application/asyncfilesink.cpp \
+           application/easyencoder.cpp \
+           application/easyreader.cpp \
+           application/crc32.cpp \
+           application/nedccodec.cpp \
+           application/nedcfile.cpp \
+           application/nedcconverter.cpp \
+           application/streammerge.cpp \
            application/trigger.cpp \
            application/protocolmanager.cpp \
 
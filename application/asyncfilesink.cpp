@@ -0,0 +1,329 @@
+#include "asyncfilesink.h"
+
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+AsyncFileSink::AsyncFileSink (QObject *parent) :
+    QThread(parent),
+    _file(0),
+    _numOfBuffers(1),
+    _isRunning(false),
+    _hasWriteError(false),
+    _syncPolicy(SYNC_NONE),
+    _syncInterval(1000),
+    _isPreallocationEnabled(false),
+    _isWritebackEnabled(true),
+    _expectedSize(0),
+    _position(0),
+    _reservedEnd(0),
+    _writebackStart(0),
+    _previousWritebackStart(0)
+{
+    // The capacity is reserved so that emptying a buffer keeps its memory
+    _active = new QByteArray();
+    _active->reserve(ASYNC_FILE_SINK_BUFFER_SIZE);
+
+    memset(&_statistics, 0, sizeof(_statistics));
+}
+
+AsyncFileSink::~AsyncFileSink ()
+{
+    close();
+
+    delete _active;
+    for (int i = 0; i < _free.size(); i++)
+        delete _free[i];
+}
+
+void AsyncFileSink::setSyncPolicy (SyncPolicy policy, int interval)
+{
+    _syncPolicy = policy;
+    _syncInterval = interval;
+}
+
+void AsyncFileSink::setPreallocation (bool enabled, qint64 expectedSize)
+{
+    _isPreallocationEnabled = enabled;
+    _expectedSize = expectedSize;
+}
+
+void AsyncFileSink::open (QFile *file)
+{
+    close();
+
+    // The writer thread is the only user of the positions until close()
+    _position = file->pos();
+    _reservedEnd = _position;
+    _writebackStart = _position;
+    _previousWritebackStart = _position;
+
+    {
+        QMutexLocker locker(&_mutex);
+        _isRunning = true;
+        _hasWriteError = false;
+        memset(&_statistics, 0, sizeof(_statistics));
+    }
+
+    _file = file;
+    start();
+}
+
+void AsyncFileSink::close ()
+{
+    if (_file == 0)
+        return;
+
+    flush();
+
+    {
+        QMutexLocker locker(&_mutex);
+        _isRunning = false;
+        _bufferQueued.wakeAll();
+    }
+
+    wait();
+    _file = 0;
+}
+
+void AsyncFileSink::append (const char *data, int size)
+{
+    if (_file == 0 || size <= 0)
+        return;
+
+    _active->append(data, size);
+
+    if (_active->size() >= ASYNC_FILE_SINK_BUFFER_SIZE)
+    {
+        QMutexLocker locker(&_mutex);
+        _swapActiveBuffer();
+    }
+}
+
+void AsyncFileSink::handOff ()
+{
+    if (_file == 0 || _active->isEmpty())
+        return;
+
+    QMutexLocker locker(&_mutex);
+    _swapActiveBuffer();
+}
+
+void AsyncFileSink::flush ()
+{
+    if (_file == 0)
+        return;
+
+    QMutexLocker locker(&_mutex);
+    if (!_active->isEmpty())
+        _swapActiveBuffer();
+
+    while (!_pending.isEmpty())
+        _bufferWritten.wait(&_mutex);
+}
+
+bool AsyncFileSink::takeWriteError ()
+{
+    QMutexLocker locker(&_mutex);
+    bool hasWriteError = _hasWriteError;
+    _hasWriteError = false;
+    return hasWriteError;
+}
+
+AsyncFileSink::Statistics AsyncFileSink::statistics ()
+{
+    QMutexLocker locker(&_mutex);
+    Statistics statistics = _statistics;
+    statistics.queueDepth = _pending.size();
+    return statistics;
+}
+
+void AsyncFileSink::_swapActiveBuffer ()
+{
+    // Backpressure: every buffer allowed is waiting for the file
+    if (_free.isEmpty() && _numOfBuffers >= ASYNC_FILE_SINK_MAX_BUFFERS)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (_free.isEmpty())
+            _bufferWritten.wait(&_mutex);
+        _statistics.producerStallTime += timer.elapsed();
+    }
+
+    QByteArray *buffer;
+    if (!_free.isEmpty())
+    {
+        buffer = _free.takeLast();
+    }
+    else
+    {
+        buffer = new QByteArray();
+        buffer->reserve(ASYNC_FILE_SINK_BUFFER_SIZE);
+        _numOfBuffers++;
+    }
+
+    _pending.append(_active);
+    _active = buffer;
+
+    if (_pending.size() > _statistics.maxQueueDepth)
+        _statistics.maxQueueDepth = _pending.size();
+
+    _bufferQueued.wakeOne();
+}
+
+void AsyncFileSink::_reserve (qint64 end)
+{
+#ifdef Q_OS_LINUX
+    if (!_isPreallocationEnabled || end <= _reservedEnd)
+        return;
+
+    // The size of the file is kept, so it only grows with the data. A file
+    // system without support is not asked again until the next extent.
+    if (end < _reservedEnd + ASYNC_FILE_SINK_EXTENT_SIZE)
+        end = _reservedEnd + ASYNC_FILE_SINK_EXTENT_SIZE;
+    fallocate(_file->handle(), FALLOC_FL_KEEP_SIZE, _reservedEnd, end - _reservedEnd);
+    _reservedEnd = end;
+#else
+    Q_UNUSED(end);
+#endif
+}
+
+void AsyncFileSink::_writeBack ()
+{
+#ifdef Q_OS_LINUX
+    if (_position - _writebackStart < ASYNC_FILE_SINK_WRITEBACK_SIZE)
+        return;
+
+    // The new range starts its way to the disk, the previous one is waited
+    // for, so at most two ranges are dirty in the page cache
+    int handle = _file->handle();
+    sync_file_range(handle, _writebackStart, _position - _writebackStart, SYNC_FILE_RANGE_WRITE);
+    if (_writebackStart > _previousWritebackStart)
+    {
+        sync_file_range(handle, _previousWritebackStart, _writebackStart - _previousWritebackStart,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    }
+    _previousWritebackStart = _writebackStart;
+    _writebackStart = _position;
+#endif
+}
+
+qint64 AsyncFileSink::_sync ()
+{
+    QElapsedTimer timer;
+    timer.start();
+#ifdef Q_OS_LINUX
+    fdatasync(_file->handle());
+#endif
+    return timer.elapsed();
+}
+
+void AsyncFileSink::run ()
+{
+    QElapsedTimer timer;
+    QElapsedTimer sinceSync;
+    bool isSynced = true;
+
+    _reserve(_position + _expectedSize);
+    sinceSync.start();
+
+    QMutexLocker locker(&_mutex);
+
+    for (;;)
+    {
+        // The data written is synced on time even if no more arrives
+        while (_pending.isEmpty() && _isRunning)
+        {
+            if (_syncPolicy != SYNC_PERIODIC || isSynced)
+                _bufferQueued.wait(&_mutex);
+            else if (sinceSync.elapsed() < _syncInterval)
+                _bufferQueued.wait(&_mutex, _syncInterval - sinceSync.elapsed());
+            else
+                break;
+        }
+
+        if (_pending.isEmpty() && !_isRunning)
+            break;
+
+        // The buffer stays queued while it is written, so flush() waits for
+        // it too
+        QByteArray *buffer = _pending.isEmpty() ? 0 : _pending.first();
+        locker.unlock();
+
+        qint64 writtenBytes = 0;
+        qint64 writeTime = 0;
+        if (buffer != 0)
+        {
+            _reserve(_position + buffer->size());
+
+            timer.start();
+            writtenBytes = _file->write(buffer->constData(), buffer->size());
+            _file->flush();
+            writeTime = timer.elapsed();
+
+            if (writtenBytes > 0)
+            {
+                _position += writtenBytes;
+                isSynced = false;
+            }
+            if (_isWritebackEnabled)
+                _writeBack();
+        }
+
+        qint64 syncTime = 0;
+        if (!isSynced && (_syncPolicy == SYNC_EACH_WRITE ||
+                          (_syncPolicy == SYNC_PERIODIC && sinceSync.elapsed() >= _syncInterval)))
+        {
+            syncTime = _sync();
+            isSynced = true;
+            sinceSync.start();
+        }
+
+        locker.relock();
+
+        if (syncTime > _statistics.maxSyncTime)
+            _statistics.maxSyncTime = syncTime;
+        if (buffer == 0)
+            continue;
+
+        if (writtenBytes != buffer->size())
+            _hasWriteError = true;
+        if (writtenBytes > 0)
+            _statistics.writtenBytes += writtenBytes;
+        if (writeTime > _statistics.maxWriteTime)
+            _statistics.maxWriteTime = writeTime;
+
+        buffer->resize(0);
+        _pending.removeFirst();
+        _free.append(buffer);
+        _bufferWritten.wakeAll();
+    }
+
+    locker.unlock();
+
+    if (_syncPolicy != SYNC_NONE && !isSynced)
+    {
+        qint64 syncTime = _sync();
+        locker.relock();
+        if (syncTime > _statistics.maxSyncTime)
+            _statistics.maxSyncTime = syncTime;
+        locker.unlock();
+    }
+
+#ifdef Q_OS_LINUX
+    // The space reserved past the data is released
+    if (_reservedEnd > _position)
+    {
+        struct stat status;
+        if (fstat(_file->handle(), &status) == 0)
+            ftruncate(_file->handle(), status.st_size);
+    }
+#endif
+}
@@ -0,0 +1,327 @@
+#ifndef ASYNCFILESINK_H
+#define ASYNCFILESINK_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+
+#define ASYNC_FILE_SINK_BUFFER_SIZE     (65536)     // [bytes] A buffer reaching it is handed to the writer
+#define ASYNC_FILE_SINK_MAX_BUFFERS     (32)        // Buffers in use before the producer has to wait
+#define ASYNC_FILE_SINK_EXTENT_SIZE     (16777216)  // [bytes] Space reserved at once past the expected size
+#define ASYNC_FILE_SINK_WRITEBACK_SIZE  (1048576)   // [bytes] Data sent to the disk at once by the background writeback
+
+/*!
+ * \class AsyncFileSink asyncfilesink.h
+ *
+ * \brief This class writes to a file from a thread of its own, so that the
+ * thread producing the data never waits for the disk. The producer appends
+ * the bytes to an active buffer in memory; when it is full, or when the
+ * producer hands it off, it is queued to the writer thread and replaced by
+ * an empty one. The buffers written are reused, and more of them are
+ * allocated while the file is slow, up to ASYNC_FILE_SINK_MAX_BUFFERS; only
+ * then the producer waits, and the time it waited is accounted in the
+ * statistics.
+ *
+ * The file must be opened and closed by the owner of the sink, and it can
+ * not be used by anyone else between open() and close().
+ *
+ * On Linux the writer thread can also reserve the space of the file in
+ * large extents, so that it does not grow by small allocations, send the
+ * written data to the disk in the background as it goes, so that the page
+ * cache does not fill up and stall a later write for a long time, and sync
+ * the data according to a durability policy. On other systems the data is
+ * only handed to the operating system.
+ */
+class AsyncFileSink : public QThread
+{
+public:
+
+    /*!
+     * Figures of the sink since it was opened
+     */
+    struct Statistics
+    {
+        int queueDepth;             // Buffers waiting to be written
+        int maxQueueDepth;          // Highest number of buffers waiting to be written
+        qint64 maxWriteTime;        // [ms] Longest write of a buffer
+        qint64 producerStallTime;   // [ms] Time the producer waited for a free buffer
+        qint64 writtenBytes;        // Bytes written to the file
+        qint64 maxSyncTime;         // [ms] Longest sync of the data to the disk
+    };
+
+    /*!
+     * When the data written is synced to the disk
+     */
+    enum SyncPolicy
+    {
+        SYNC_NONE = 0,          // When the operating system decides
+        SYNC_PERIODIC = 1,      // Every sync interval, if anything was written
+        SYNC_EACH_WRITE = 2     // After every buffer, i.e. every window handed off
+    };
+
+    /*!
+     * Constructor
+     *
+     * \param parent Parent object
+     */
+    AsyncFileSink (QObject *parent = 0);
+
+    /*!
+     * Default destructor. It closes the sink, writing the pending data.
+     */
+    virtual ~AsyncFileSink ();
+
+    /*!
+     * It sets when the data is synced to the disk. It applies from the next
+     * open(); with any policy but SYNC_NONE the data is synced on close()
+     * too.
+     *
+     * \param policy Durability policy, SYNC_NONE by default
+     *
+     * \param interval [ms] Time between syncs with SYNC_PERIODIC
+     */
+    void setSyncPolicy (SyncPolicy policy, int interval = 1000);
+
+    /*!
+     * It sets whether the space of the file is reserved ahead of the writes.
+     * It applies from the next open(); the space not used is released on
+     * close().
+     *
+     * \param enabled Whether the space is reserved, false by default
+     *
+     * \param expectedSize [bytes] Data expected, reserved when the sink is
+     * opened. Past it, or with 0, the space is reserved in extents of
+     * ASYNC_FILE_SINK_EXTENT_SIZE.
+     */
+    void setPreallocation (bool enabled, qint64 expectedSize = 0);
+
+    /*!
+     * It sets whether the data written is sent to the disk in the background
+     * every ASYNC_FILE_SINK_WRITEBACK_SIZE bytes, true by default. It
+     * applies from the next open().
+     */
+    void setBackgroundWriteback (bool enabled) { _isWritebackEnabled = enabled; }
+
+    /*!
+     * It starts the writer thread. The data is written at the current
+     * position of the file.
+     *
+     * \param file File already open for writing
+     */
+    void open (QFile *file);
+
+    /*!
+     * It writes all the data appended and stops the writer thread. The file
+     * is left open.
+     */
+    void close ();
+
+    /*!
+     * It returns whether the sink is open
+     */
+    bool isOpen () { return _file != 0; }
+
+    /*!
+     * It appends bytes to the active buffer. It does nothing if the sink is
+     * not open.
+     *
+     * \param data Bytes to append
+     *
+     * \param size Number of bytes
+     */
+    void append (const char *data, int size);
+
+    /*!
+     * It appends bytes to the active buffer
+     */
+    void append (const QByteArray &bytes) { append(bytes.constData(), bytes.size()); }
+
+    /*!
+     * It queues the active buffer to the writer thread, even if it is not
+     * full, so that the data appended reaches the file without waiting for
+     * more
+     */
+    void handOff ();
+
+    /*!
+     * It hands the active buffer off and waits until all the data appended
+     * has been written
+     */
+    void flush ();
+
+    /*!
+     * It returns whether a write failed since the previous call
+     */
+    bool takeWriteError ();
+
+    /*!
+     * It returns the figures of the sink since it was opened
+     */
+    Statistics statistics ();
+
+protected:
+
+    /*!
+     * Body of the writer thread
+     */
+    void run ();
+
+private:
+
+    /*!
+     * It queues the active buffer and takes an empty one, waiting if all of
+     * them are in use. _mutex must be locked.
+     */
+    void _swapActiveBuffer ();
+
+    /*!
+     * It reserves the space of the file up to an end position, if the
+     * preallocation is enabled. Called by the writer thread.
+     */
+    void _reserve (qint64 end);
+
+    /*!
+     * It sends the data written to the disk in the background, waiting for
+     * the previous range sent. Called by the writer thread.
+     */
+    void _writeBack ();
+
+    /*!
+     * It syncs the data written to the disk. Called by the writer thread
+     * with _mutex unlocked.
+     *
+     * \return [ms] Time taken
+     */
+    qint64 _sync ();
+
+    /*!
+     * \property AsyncFileSink::_file
+     *
+     * File written, NULL while the sink is closed
+     */
+    QFile *_file;
+
+    /*!
+     * \property AsyncFileSink::_active
+     *
+     * Buffer receiving the data, only used by the producer
+     */
+    QByteArray *_active;
+
+    /*!
+     * \property AsyncFileSink::_pending
+     *
+     * Buffers waiting to be written, oldest first. The one being written is
+     * removed once it is done.
+     */
+    QList<QByteArray*> _pending;
+
+    /*!
+     * \property AsyncFileSink::_free
+     *
+     * Empty buffers ready to become the active one
+     */
+    QList<QByteArray*> _free;
+
+    /*!
+     * \property AsyncFileSink::_numOfBuffers
+     *
+     * Number of buffers allocated
+     */
+    int _numOfBuffers;
+
+    /*!
+     * \property AsyncFileSink::_mutex
+     *
+     * It protects the queues, the statistics and the flags
+     */
+    QMutex _mutex;
+
+    /*!
+     * \property AsyncFileSink::_bufferQueued
+     *
+     * Condition the writer thread waits on for data
+     */
+    QWaitCondition _bufferQueued;
+
+    /*!
+     * \property AsyncFileSink::_bufferWritten
+     *
+     * Condition the producer waits on for free buffers
+     */
+    QWaitCondition _bufferWritten;
+
+    /*!
+     * \property AsyncFileSink::_isRunning
+     *
+     * It is cleared to stop the writer thread once the queue is empty
+     */
+    bool _isRunning;
+
+    /*!
+     * \property AsyncFileSink::_hasWriteError
+     *
+     * It is set when a buffer could not be written completely
+     */
+    bool _hasWriteError;
+
+    /*!
+     * \property AsyncFileSink::_syncPolicy
+     *
+     * When the data is synced to the disk
+     */
+    SyncPolicy _syncPolicy;
+
+    /*!
+     * \property AsyncFileSink::_syncInterval
+     *
+     * [ms] Time between syncs with SYNC_PERIODIC
+     */
+    int _syncInterval;
+
+    bool _isPreallocationEnabled;
+    bool _isWritebackEnabled;
+
+    /*!
+     * \property AsyncFileSink::_expectedSize
+     *
+     * [bytes] Data expected, reserved on open
+     */
+    qint64 _expectedSize;
+
+    /*!
+     * \property AsyncFileSink::_position
+     *
+     * Position of the next write, only used by the writer thread
+     */
+    qint64 _position;
+
+    /*!
+     * \property AsyncFileSink::_reservedEnd
+     *
+     * End of the space reserved, only used by the writer thread
+     */
+    qint64 _reservedEnd;
+
+    /*!
+     * \property AsyncFileSink::_writebackStart
+     *
+     * Beginning of the data not sent to the disk yet, and of the range sent
+     * before it whose completion has not been waited for. Only used by the
+     * writer thread.
+     */
+    qint64 _writebackStart;
+    qint64 _previousWritebackStart;
+
+    /*!
+     * \property AsyncFileSink::_statistics
+     *
+     * Figures since the sink was opened, its queue depth is not updated
+     */
+    Statistics _statistics;
+};
+
+#endif // ASYNCFILESINK_H
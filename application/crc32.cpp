@@ -0,0 +1,32 @@
+#include "crc32.h"
+
+/*!
+ * Checksum of every byte value, built once
+ */
+class Crc32Table
+{
+public:
+    Crc32Table ()
+    {
+        for (quint32 i = 0; i < 256; i++)
+        {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+            values[i] = crc;
+        }
+    }
+
+    quint32 values[256];
+};
+
+quint32 Crc32::compute (const void *data, qint64 size, quint32 crc)
+{
+    static const Crc32Table table;
+
+    const uchar *bytes = (const uchar*) data;
+    crc = ~crc;
+    for (qint64 i = 0; i < size; i++)
+        crc = table.values[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
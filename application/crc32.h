@@ -0,0 +1,29 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <QtGlobal>
+
+/*!
+ * \class Crc32 crc32.h
+ *
+ * \brief This class computes the CRC-32 used by zlib and PNG (reflected
+ * polynomial 0xEDB88320), so the checksums of the recordings can be checked
+ * with common tools.
+ */
+class Crc32
+{
+public:
+
+    /*!
+     * It computes the checksum of a buffer
+     *
+     * \param data First byte
+     *
+     * \param size Number of bytes
+     *
+     * \param crc Checksum of the preceding bytes, to continue it
+     */
+    static quint32 compute (const void *data, qint64 size, quint32 crc = 0);
+};
+
+#endif // CRC32_H
@@ -0,0 +1,194 @@
+#include "easyencoder.h"
+
+#include "commonparameters.h"
+
+// Two ASCII digits of every number from 0 to 99
+static const char digitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+/*!
+ * It returns the number of decimal digits of a value
+ */
+template <typename T>
+static int countDigits (T value)
+{
+    int numOfDigits = 1;
+    for (;;)
+    {
+        if (value < 10)
+            return numOfDigits;
+        if (value < 100)
+            return numOfDigits + 1;
+        if (value < 1000)
+            return numOfDigits + 2;
+        if (value < 10000)
+            return numOfDigits + 3;
+        value /= 10000;
+        numOfDigits += 4;
+    }
+}
+
+/*!
+ * It writes the digits of a value from the last one, two at a time
+ */
+template <typename T>
+static char* formatDigits (T value, char *out)
+{
+    char *end = out + countDigits(value);
+    char *position = end;
+
+    while (value >= 100)
+    {
+        int pair = (int) (value % 100) * 2;
+        value /= 100;
+        *--position = digitPairs[pair + 1];
+        *--position = digitPairs[pair];
+    }
+
+    if (value >= 10)
+    {
+        int pair = (int) value * 2;
+        *--position = digitPairs[pair + 1];
+        *--position = digitPairs[pair];
+    }
+    else
+    {
+        *--position = (char) ('0' + value);
+    }
+
+    return end;
+}
+
+EasyEncoder::EasyEncoder () :
+    _size(0)
+{
+}
+
+void EasyEncoder::begin (int numOfSamples, int numOfFields)
+{
+    _size = 0;
+    _reserve(numOfSamples * numOfFields);
+}
+
+void EasyEncoder::_reserve (int numOfFields)
+{
+    int required = _size + numOfFields * EASY_MAX_FIELD_LENGTH;
+    if (required <= _buffer.size())
+        return;
+
+    int capacity = 2 * _buffer.size();
+    _buffer.resize((capacity > required) ? capacity : required);
+}
+
+char* EasyEncoder::formatUnsigned (unsigned long long value, char *out)
+{
+    // 32-bit divisions whenever the value allows them
+    if (value <= 0xffffffffULL)
+        return formatDigits((quint32) value, out);
+    return formatDigits(value, out);
+}
+
+char* EasyEncoder::formatInt (int value, char *out)
+{
+    quint32 magnitude = (quint32) value;
+    if (value < 0)
+    {
+        *out++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    return formatDigits(magnitude, out);
+}
+
+void EasyEncoder::appendField (int value)
+{
+    _reserve(1);
+    char *out = formatInt(value, _buffer.data() + _size);
+    *out++ = '\t';
+    _size = out - _buffer.constData();
+}
+
+void EasyEncoder::appendEEG (ChannelData &data, int numOfChannels)
+{
+    if (numOfChannels > N_MAX_CHANNELS)
+        numOfChannels = N_MAX_CHANNELS;
+
+    _reserve(numOfChannels);
+    char *out = _buffer.data() + _size;
+
+    const int *nanoVolts = data.data();
+    unsigned int channelInfo = data.channelInfo();
+    for (int j = 0; j < numOfChannels; j++)
+    {
+        if (channelInfo & (1 << j))
+        {
+            out = formatInt(nanoVolts[j], out);
+        }
+        else
+        {
+            *out++ = '-';
+            *out++ = '1';
+        }
+        *out++ = '\t';
+    }
+
+    _size = out - _buffer.constData();
+}
+
+void EasyEncoder::appendLineEnd (int trigger, unsigned long long timestamp)
+{
+    _reserve(2);
+    char *out = formatInt(trigger, _buffer.data() + _size);
+    *out++ = '\t';
+    out = formatUnsigned(timestamp, out);
+    *out++ = '\n';
+    _size = out - _buffer.constData();
+}
+
+void EasyEncoder::appendStim (ChannelData &data, int numOfChannels)
+{
+    if (numOfChannels > N_MAX_CHANNELS)
+        numOfChannels = N_MAX_CHANNELS;
+
+    _reserve(numOfChannels);
+    char *out = _buffer.data() + _size;
+
+    const int *values = data.data();
+    unsigned int channelInfo = data.channelInfo();
+    for (int j = 0; j < numOfChannels; j++)
+    {
+        if (channelInfo & (1 << j))
+        {
+            int microAmps = values[j];
+            if (microAmps > 32768)
+                microAmps -= 65536;
+            microAmps *= 2000;
+            microAmps /= 32768;
+            out = formatInt(microAmps, out);
+        }
+        else
+        {
+            *out++ = '-';
+            *out++ = '1';
+        }
+        *out++ = '\t';
+    }
+
+    _size = out - _buffer.constData();
+}
+
+void EasyEncoder::appendStimLineEnd (unsigned long long timestamp)
+{
+    _reserve(1);
+    char *out = formatUnsigned(timestamp, _buffer.data() + _size);
+    *out++ = '\n';
+    _size = out - _buffer.constData();
+}
@@ -0,0 +1,127 @@
+#ifndef EASYENCODER_H
+#define EASYENCODER_H
+
+#include <QByteArray>
+
+#include "channeldata.h"
+
+#define EASY_MAX_FIELD_LENGTH   (24)    // [bytes] Longest number and separator of a line
+
+/*!
+ * \class EasyEncoder easyencoder.h
+ *
+ * \brief This class builds the lines of an EASY file for a whole flush
+ * window in memory. The fields are tab-separated decimal integers, the
+ * same text QString::number gives, formatted straight into a reusable
+ * buffer two digits at a time, so no string is allocated per sample. The
+ * buffer keeps its capacity between windows.
+ */
+class EasyEncoder
+{
+public:
+
+    /*!
+     * Constructor
+     */
+    EasyEncoder ();
+
+    /*!
+     * It empties the buffer and reserves room for a window
+     *
+     * \param numOfSamples Number of lines of the window
+     *
+     * \param numOfFields Number of fields of every line
+     */
+    void begin (int numOfSamples, int numOfFields);
+
+    /*!
+     * It appends a value followed by a tab
+     */
+    void appendField (int value);
+
+    /*!
+     * It appends the channels of an EEG sample in nV, each followed by a
+     * tab
+     *
+     * \param data EEG sample
+     *
+     * \param numOfChannels Number of channels, the channels not reported in
+     * the channel info of the sample are written as -1
+     */
+    void appendEEG (ChannelData &data, int numOfChannels);
+
+    /*!
+     * It appends the last two fields of a line and the end of line
+     *
+     * \param trigger Trigger code
+     *
+     * \param timestamp Timestamp of the sample
+     */
+    void appendLineEnd (int trigger, unsigned long long timestamp);
+
+    /*!
+     * It appends the channels of a stimulation sample in uA, each followed
+     * by a tab, as in the STIM file
+     *
+     * \param data Stimulation sample, in 16-bit two's complement units of
+     * 2000 uA full scale
+     *
+     * \param numOfChannels Number of channels, the channels not reported in
+     * the channel info of the sample are written as -1
+     */
+    void appendStim (ChannelData &data, int numOfChannels);
+
+    /*!
+     * It appends the timestamp and the end of line of a STIM line
+     *
+     * \param timestamp Timestamp of the sample
+     */
+    void appendStimLineEnd (unsigned long long timestamp);
+
+    /*!
+     * It returns the number of bytes encoded
+     */
+    int size () const { return _size; }
+
+    /*!
+     * It returns the bytes encoded
+     */
+    const char* data () const { return _buffer.constData(); }
+
+    /*!
+     * It writes the decimal digits of a value
+     *
+     * \return Position after the last digit
+     */
+    static char* formatUnsigned (unsigned long long value, char *out);
+
+    /*!
+     * It writes a value in decimal, with a minus sign if it is negative
+     *
+     * \return Position after the last character
+     */
+    static char* formatInt (int value, char *out);
+
+private:
+
+    /*!
+     * It makes sure there is room for a number of fields more
+     */
+    void _reserve (int numOfFields);
+
+    /*!
+     * \property EasyEncoder::_buffer
+     *
+     * Encoded bytes
+     */
+    QByteArray _buffer;
+
+    /*!
+     * \property EasyEncoder::_size
+     *
+     * Number of bytes encoded in _buffer
+     */
+    int _size;
+};
+
+#endif // EASYENCODER_H
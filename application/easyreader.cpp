@@ -0,0 +1,163 @@
+#include "easyreader.h"
+
+#include <string.h>
+
+EasyReader::EasyReader () :
+    _taskPool(0),
+    _numOfFields(0),
+    _numOfRows(0),
+    _errorLine(0)
+{
+}
+
+bool EasyReader::open (const QString &fileName)
+{
+    _numOfFields = 0;
+    _numOfRows = 0;
+    _errorLine = 0;
+    _values.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = file.size();
+    if (size == 0)
+        return true;
+
+    const char *data = (const char*) file.map(0, size);
+    if (data == 0)
+        return false;
+    const char *end = data + size;
+
+    // Fields of the first line that is not empty
+    const char *line = data;
+    while (line < end && (*line == '\n' || *line == '\r'))
+        line++;
+    if (line == end)
+        return true;
+    _numOfFields = 1;
+    for (const char *c = line; c < end && *c != '\n'; c++)
+    {
+        if (*c == '\t')
+            _numOfFields++;
+    }
+
+    // Chunks starting at a line, one per task
+    int numOfChunks = (int) (size / EASY_READER_CHUNK_SIZE) + 1;
+    int numOfThreads = (_taskPool != 0) ? 4 * (_taskPool->numOfThreads() + 1) : 1;
+    if (numOfChunks > numOfThreads)
+        numOfChunks = numOfThreads;
+
+    _chunks.resize(numOfChunks);
+    const char *begin = data;
+    for (int i = 0; i < numOfChunks; i++)
+    {
+        const char *chunkEnd = (i == numOfChunks - 1) ? end : data + size * (i + 1) / numOfChunks;
+        if (chunkEnd < begin)
+            chunkEnd = begin;
+        const char *newLine = (const char*) memchr(chunkEnd, '\n', end - chunkEnd);
+        chunkEnd = (newLine != 0) ? newLine + 1 : end;
+
+        _chunks[i].begin = begin;
+        _chunks[i].end = chunkEnd;
+        begin = chunkEnd;
+    }
+
+    if (_taskPool != 0)
+    {
+        _taskPool->run(_parseChunk, this, numOfChunks);
+    }
+    else
+    {
+        for (int i = 0; i < numOfChunks; i++)
+            _parseChunk(this, i);
+    }
+
+    // Rows in file order
+    for (int i = 0; i < numOfChunks; i++)
+    {
+        if (_chunks[i].error != 0)
+        {
+            _errorLine = 1;
+            for (const char *c = data; c < _chunks[i].error; c++)
+            {
+                if (*c == '\n')
+                    _errorLine++;
+            }
+            break;
+        }
+        _numOfRows += _chunks[i].numOfRows;
+    }
+
+    if (_errorLine == 0)
+    {
+        _values.resize((qint64) _numOfRows * _numOfFields);
+        qint64 *out = _values.data();
+        for (int i = 0; i < numOfChunks; i++)
+        {
+            memcpy(out, _chunks[i].values.constData(), _chunks[i].values.size() * sizeof(qint64));
+            out += _chunks[i].values.size();
+        }
+    }
+    else
+    {
+        _numOfRows = 0;
+    }
+
+    _chunks.clear();
+    file.unmap((uchar*) data);
+    return _errorLine == 0;
+}
+
+void EasyReader::_parseChunk (void *context, int index)
+{
+    EasyReader *reader = (EasyReader*) context;
+    _parse(reader->_chunks[index], reader->_numOfFields);
+}
+
+void EasyReader::_parse (Chunk &chunk, int numOfFields)
+{
+    chunk.values.clear();
+    chunk.values.reserve((chunk.end - chunk.begin) / (4 * numOfFields) + numOfFields);
+    chunk.numOfRows = 0;
+    chunk.error = 0;
+
+    const char *c = chunk.begin;
+    while (c < chunk.end)
+    {
+        // Empty lines are skipped
+        if (*c == '\n' || *c == '\r')
+        {
+            c++;
+            continue;
+        }
+
+        const char *line = c;
+        for (int field = 0; field < numOfFields; field++)
+        {
+            bool isNegative = (c < chunk.end && *c == '-');
+            if (isNegative)
+                c++;
+
+            const char *digits = c;
+            qint64 value = 0;
+            while (c < chunk.end && *c >= '0' && *c <= '9')
+                value = 10 * value + (*c++ - '0');
+
+            // Every field has digits and is followed by its separator
+            char separator = (c < chunk.end) ? *c : '\n';
+            bool isLast = (field == numOfFields - 1);
+            if (c == digits || (isLast ? (separator != '\n' && separator != '\r') : (separator != '\t')))
+            {
+                chunk.error = line;
+                return;
+            }
+            if (!isLast)
+                c++;
+
+            chunk.values.append(isNegative ? -value : value);
+        }
+        chunk.numOfRows++;
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef EASYREADER_H
+#define EASYREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include "taskpool.h"
+
+#define EASY_READER_CHUNK_SIZE  (262144)    // [bytes] Minimum text parsed by a task
+
+/*!
+ * \class EasyReader easyreader.h
+ *
+ * \brief This class parses the text recordings, EASY and STIM files, which
+ * are lines of tab-separated integers. The file is mapped in memory and
+ * split into chunks at line boundaries that are parsed in parallel on a
+ * task pool; the values are stored row by row, one row per line.
+ *
+ * The reader does not interpret the columns. In an EASY file they are the
+ * EEG channels, the accelerometer axes and the additional channel when they
+ * were recorded, the trigger code and the timestamp; in a STIM file the
+ * channels and the timestamp.
+ */
+class EasyReader
+{
+public:
+
+    /*!
+     * Constructor
+     */
+    EasyReader ();
+
+    /*!
+     * Sets the pool parsing the chunks in parallel, usually
+     * TaskPool::instance(). With NULL, the default, the file is parsed in
+     * the calling thread.
+     *
+     * \param pool task pool, it must outlive the reader
+     */
+    void setTaskPool (TaskPool *pool) { _taskPool = pool; }
+
+    /*!
+     * It parses a file. The number of fields is taken from the first line.
+     *
+     * \return false if the file can not be read, or a line has a field that
+     * is not an integer or a different number of fields
+     */
+    bool open (const QString &fileName);
+
+    /*!
+     * It returns the number of lines parsed
+     */
+    int numOfRows () const { return _numOfRows; }
+
+    /*!
+     * It returns the number of fields of every line
+     */
+    int numOfFields () const { return _numOfFields; }
+
+    /*!
+     * It returns the fields of a line
+     */
+    const qint64* row (int index) const { return _values.constData() + (qint64) index * _numOfFields; }
+
+    /*!
+     * It returns a field of a line
+     */
+    qint64 value (int row, int field) const { return _values[(qint64) row * _numOfFields + field]; }
+
+    /*!
+     * It returns the 1-based number of the first malformed line, 0 if the
+     * file was parsed
+     */
+    qint64 errorLine () const { return _errorLine; }
+
+private:
+
+    /*!
+     * Chunk of the file parsed by a task
+     */
+    struct Chunk
+    {
+        const char *begin;
+        const char *end;
+        QVector<qint64> values;
+        int numOfRows;
+        const char *error;      // First malformed line, 0 if none
+    };
+
+    /*!
+     * Task parsing a chunk
+     */
+    static void _parseChunk (void *context, int index);
+
+    /*!
+     * It parses the lines of a chunk
+     *
+     * \param numOfFields Fields of every line
+     */
+    static void _parse (Chunk &chunk, int numOfFields);
+
+    TaskPool *_taskPool;
+    int _numOfFields;
+    int _numOfRows;
+    qint64 _errorLine;
+
+    /*!
+     * \property EasyReader::_chunks
+     *
+     * Chunks of the file being parsed
+     */
+    QVector<Chunk> _chunks;
+
+    /*!
+     * \property EasyReader::_values
+     *
+     * Fields of every line, row by row
+     */
+    QVector<qint64> _values;
+};
+
+#endif // EASYREADER_H
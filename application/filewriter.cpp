@@ -1,6 +1,5 @@
 #include <QDir>
 #include <QtCore>
-#include <QTextStream>
 
 #include "filewriter.h"
 #include "icognosData.h"
@@ -22,6 +21,7 @@ FileWriter::FileWriter (bool start, QString fileName, QString outDir) :
     _handleFile(_outDir + _fileID),
     _handleStimFile(_outDir +_fileID),
     _handleBinaryFile(_outDir +_fileID),
+    _handleCompressedFile(_outDir +_fileID),
     //_appendTimestamp(appendTimestamp),
     //_trigger(0)
     //_triggersMutex(QMutex::Recursive),
@@ -29,12 +29,20 @@ FileWriter::FileWriter (bool start, QString fileName, QString outDir) :
     _isPostEEG(false),
     _isRecordingAdditionalChannel(false),
     _isRecordingAccelerometer(false),
+    _isRecordingNEDC(false),
+    _expectedDuration(0),
     _firstEEGTimeStamp(0),
     _firstStimTimeStamp(0),
     _firstAccelerometerTimeStamp(0),
     _numberOfEEGSamples(0),
     _isStimulating(0),
-    _isEEGNotesAfterStimPending(0)
+    _isEEGNotesAfterStimPending(0),
+    dataToWrite(FILEWRITER_EASY_QUEUE_LEN),
+    stimDataToWrite(FILEWRITER_STIM_QUEUE_LEN),
+    binaryEEGDataToWrite(FILEWRITER_NEDF_QUEUE_LEN),
+    binaryStimDataToWrite(FILEWRITER_STIM_QUEUE_LEN),
+    binaryAccelerometerDataToWrite(FILEWRITER_ACCEL_QUEUE_LEN),
+    accelerometerToWrite(FILEWRITER_ACCEL_QUEUE_LEN)
 {
 
 //    _isRecordingNEDF = false;
@@ -169,6 +177,8 @@ bool FileWriter::startWriting ()
             return false;
         }
 
+        _easySink.setPreallocation(true, _expectedSize((_numOfChannels + 6) * FILEWRITER_EASY_FIELD_SIZE));
+        _easySink.open(&_handleFile);
         _currentStatus=NO_ERROR_IN_FILE_WRITER;
     }
 
@@ -188,7 +198,34 @@ bool FileWriter::startWriting ()
             return false;
         }
 
-        _handleBinaryFile.seek(5120);
+        _handleBinaryFile.seek(NEDF_HEADER_SIZE);
+        _binarySink.setPreallocation(true, _expectedSize(_numOfChannels * NEDF_SAMPLE_BYTES + 1 + (_isRecordingAccelerometer ? 2 : 0)));
+        _binarySink.open(&_handleBinaryFile);
+        _currentStatus=NO_ERROR_IN_FILE_WRITER;
+    }
+
+    QString compressedFilename = fileName;
+    if (!compressedFilename.endsWith(".nedc"))
+        compressedFilename.append(".nedc");
+
+    _handleCompressedFile.setFileName(compressedFilename);
+
+    if (_isRecordingNEDC)
+    {
+        if (!_handleCompressedFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qDebug()<<"Error opening compressed file"<<compressedFilename;
+            _currentStatus=ERROR_ON_OPENING;
+            emit statusChanged(FileWriter::ERROR_ON_OPENING);
+            return false;
+        }
+
+        // The NEDF size bounds the compressed one
+        _compressedSink.setPreallocation(true, _expectedSize(_numOfChannels * NEDF_SAMPLE_BYTES + 1));
+        _compressedSink.open(&_handleCompressedFile);
+        _nedcWriter.begin(NedcLayout(_numOfChannels, _isRecordingAccelerometer, _isRecordingAdditionalChannel), FREQ_SAMP);
+        _compressedSink.append(_nedcWriter.output());
+        _nedcWriter.clearOutput();
         _currentStatus=NO_ERROR_IN_FILE_WRITER;
     }
 
@@ -210,6 +247,29 @@ void FileWriter::setRecordingSTIMFile (bool recordSTIM)
     _isRecordingSTIM = recordSTIM;
 }
 
+void FileWriter::setRecordingNEDCFile (bool recordNEDC)
+{
+    _isRecordingNEDC = recordNEDC;
+}
+
+void FileWriter::setExpectedDuration (int seconds)
+{
+    _expectedDuration = (seconds > 0) ? seconds : 0;
+}
+
+void FileWriter::setSyncPolicy (AsyncFileSink::SyncPolicy policy, int interval)
+{
+    _easySink.setSyncPolicy(policy, interval);
+    _binarySink.setSyncPolicy(policy, interval);
+    _compressedSink.setSyncPolicy(policy, interval);
+    _stimSink.setSyncPolicy(policy, interval);
+}
+
+qint64 FileWriter::_expectedSize (int bytesPerSample)
+{
+    return (qint64) (_expectedDuration * FREQ_SAMP) * bytesPerSample;
+}
+
 
 bool FileWriter::startWritingStimData ()
 {
@@ -256,6 +316,7 @@ bool FileWriter::startWritingStimData ()
             return false;
         }
 
+        _stimSink.open(&_handleStimFile);
         _currentStatus=NO_ERROR_IN_FILE_WRITER;
     }
 #ifndef NICBENCHMARK
@@ -333,81 +394,15 @@ void FileWriter::stopWriting (){
     {
         qDebug() << "FileWriter::stopWriting stimDataToWrite" << remainingStimSamples;
 
-        QString text;
-
-        //Stimulation data
-        //for (int i=0;i<stimDataToWrite.size();i++)
-        for (int i=0;i<remainingStimSamples;i++)
+        // Everything queued reaches the file before it is closed
+        _stimToFile();
+        _stimSink.close();
+        if (_stimSink.takeWriteError())
         {
-            text="";
-            int auxNumber=0;
-
-            for (int j = 0; j < _numOfChannels; j ++)
-            {
-                if (stimDataToWrite[i].channelInfo() & (1 << j))
-                {
-                    auxNumber=stimDataToWrite[i].data()[j];
-
-                    if (auxNumber>32768)
-                        auxNumber -= 65536;
-
-                    auxNumber*=2000;
-                    auxNumber/=32768;
-
-                    text += QString::number(auxNumber);
-                }
-                else
-                {
-                    text += "-1";
-                }
-
-                text += "\t";
-            }
-
-            text+=QString::number(stimDataToWrite[i].timestamp());
-            text += "\n";
-
-            QByteArray bytes = text.toLatin1();
-            qint64 writenBytes = _handleStimFile.write(bytes);
-            if (writenBytes < bytes.length())
-            {
-                _currentStatus=ERROR_ON_WRITING;
-                emit statusChanged(FileWriter::ERROR_ON_WRITING);
-            }
+            _currentStatus=ERROR_ON_WRITING;
+            emit statusChanged(FileWriter::ERROR_ON_WRITING);
         }
 
-        //EEG data
-        /*for (int i=0;i<dataToWrite.size();i++)
-        {
-            text="";
-            int auxNumber=0;
-
-            for (int j = 0; j < _numOfChannels; j ++)
-            {
-                if (dataToWrite[i].channelInfo() & (1 << j))
-                {
-                    auxNumber=dataToWrite[i].data()[j];
-
-                    text += QString::number(auxNumber);
-                }
-                else
-                {
-                    text += "-1";
-                }
-                text += "\t";
-            }
-
-            text+=QString::number(dataToWrite[i].timestamp());
-            text += "\n";
-
-            QByteArray bytes = text.toLatin1();
-            qint64 writenBytes = _handleFile.write(bytes);
-            if (writenBytes < bytes.length())
-            {
-                emit statusChanged(FileWriter::ERROR_ON_WRITING);
-            }
-        }*/
-
         _handleStimFile.close();
     }
     else
@@ -431,15 +426,34 @@ void FileWriter::stopWriting (){
     writeEEG = false;
     writeStim = false;
 
-    if ((!_handleFile.isOpen())&&(!_handleBinaryFile.isOpen()))
+    if ((!_handleFile.isOpen())&&(!_handleBinaryFile.isOpen())&&(!_handleCompressedFile.isOpen()))
     {
         //If we were not recording EASY
         qDebug()<<"\tWe were not recording EEG";
         _firstEEGTimeStamp=0;
     }
 
+    // The last block and the block index end the NEDC file
+    if (_handleCompressedFile.isOpen())
+    {
+        _nedcWriter.finish();
+        _compressedSink.append(_nedcWriter.output());
+        _nedcWriter.clearOutput();
+    }
+
+    // Everything queued reaches the files before they are closed
+    _easySink.close();
+    _binarySink.close();
+    _compressedSink.close();
+    if (_easySink.takeWriteError() || _binarySink.takeWriteError() || _compressedSink.takeWriteError())
+    {
+        _currentStatus=ERROR_ON_WRITING;
+        emit statusChanged(FileWriter::ERROR_ON_WRITING);
+    }
+
     _handleFile.close();
     _handleBinaryFile.close();
+    _handleCompressedFile.close();
 
 
     qInstallMessageHandler(handler);
@@ -597,148 +611,102 @@ void FileWriter::setNumOfChannels(int channels)
 
 void FileWriter::_dataToFile(int numSamples)
 {
-    qint64 currentTriggerTimestamp = 0;
-    qint64 currentAccelerometerTimestamp = 0;
-    qint64 currentAdditionalTimestamp = 0;
+    // The same samples feed the EASY and the NEDC files
+    bool isWritingEASY = _easySink.isOpen();
+    bool isWritingNEDC = _handleCompressedFile.isOpen();
+
+    // EEG, accelerometer, additional channel, trigger and timestamp
+    _easyEncoder.begin(isWritingEASY ? numSamples : 0, _numOfChannels + 6);
 
+    // Every EEG sample takes at most one sample of each side stream
+    StreamCursor<ChannelData> accelerometer(accelerometerToWrite);
+    StreamCursor<ChannelData> additional(additionalToWrite);
+    StreamCursor<Trigger> triggers(triggerToWrite);
+    _streamMerge.align(dataToWrite, numSamples, &accelerometer, &additional, &triggers);
 
-    QTextStream stream(&_handleFile);
     for (int i = 0; i < numSamples; i++)
     {
-        // get timestamps from trigger, accelerometer and additional
-        if (currentTriggerTimestamp == 0 && triggerToWrite.size() > 0)
-        {
-            currentTriggerTimestamp = (*triggerToWrite.begin()).getTimestamp();
-        }
-        if (currentAccelerometerTimestamp == 0 && accelerometerToWrite.size() > 0)
-        {
-            currentAccelerometerTimestamp = (*accelerometerToWrite.begin()).timestamp();
-        }
-        if (currentAdditionalTimestamp == 0 && additionalToWrite.size() > 0)
-        {
-            currentAdditionalTimestamp = (*additionalToWrite.begin()).timestamp();
-        }
+        ChannelData *data = &dataToWrite[i];
+        const StreamMerge::Sample &aligned = _streamMerge[i];
 
-        QString text = "";
-        QList<ChannelData>::iterator data = dataToWrite.begin();
         // EEG to file
-        for (int i = 0; i < _numOfChannels; i ++)
-        {
-            if ((*data).channelInfo() & (1 << i))
-            {
-                text += QString::number((*data).data()[i]);
-            }
-            else
-            {
-                text += "-1";
-            }
-            text += "\t";
-        }
+        if (isWritingEASY)
+            _easyEncoder.appendEEG(*data, _numOfChannels);
 
         // Accelerometer to file
-        if (currentAccelerometerTimestamp > 0 &&
-            (*data).timestamp() >= currentAccelerometerTimestamp)
+        if (aligned.accelerometer != 0)
         {
-            // ACCEL timestamp coincides with EEG
-            if (((*data).timestamp() - currentAccelerometerTimestamp) != 0)
-            {
-                //qDebug() << "_dataToFile" << ((*data).timestamp() - currentAccelerometerTimestamp) <<
-                        //(*data).timestamp() << currentAccelerometerTimestamp;
-            }
-            //loggerMacroDebug("Update on accel value at " + QString::number((*accelerometerToWrite.begin()).timestamp()))
-            _lastAccelerometerValue[0] = (*accelerometerToWrite.begin()).data()[0];
-            text += QString::number(_lastAccelerometerValue[0]) + "\t";
-            _lastAccelerometerValue[1] = (*accelerometerToWrite.begin()).data()[1];
-            text += QString::number(_lastAccelerometerValue[1]) + "\t";
-            _lastAccelerometerValue[2] = (*accelerometerToWrite.begin()).data()[2];
-            text += QString::number(_lastAccelerometerValue[2]) + "\t";
-            accelerometerToWrite.pop_front();
-            currentAccelerometerTimestamp = 0;
-
+            _lastAccelerometerValue[0] = aligned.accelerometer->data()[0];
+            _lastAccelerometerValue[1] = aligned.accelerometer->data()[1];
+            _lastAccelerometerValue[2] = aligned.accelerometer->data()[2];
         }
-        else if(_isRecordingAccelerometer)
+        if (isWritingEASY && (aligned.accelerometer != 0 || _isRecordingAccelerometer))
         {
             // ACCEL timestamp coincides with EEG => store last accel value
             //loggerMacroDebug("Repeating last accel sample")
-            text += QString::number(_lastAccelerometerValue[0]) + "\t";
-            text += QString::number(_lastAccelerometerValue[1]) + "\t";
-            text += QString::number(_lastAccelerometerValue[2]) + "\t";
+            _easyEncoder.appendField(_lastAccelerometerValue[0]);
+            _easyEncoder.appendField(_lastAccelerometerValue[1]);
+            _easyEncoder.appendField(_lastAccelerometerValue[2]);
         }
 
-        //_previousTextLine = text;
-        if (currentAdditionalTimestamp > 0 &&
-            (*data).timestamp() >= currentAdditionalTimestamp)
-        {
-            /*
-            if ((*data).timestamp() != currentAdditionalTimestamp &&
-                !_previousTextLine.isEmpty())
-            {
-
-                // insert new timestamp with previous EEG sample and trigger forced to zero
-                _previousTextLine += QString::number((*additionalToWrite.begin()).data()[0]) + "\t";
-                _previousTextLine += "0\t" + QString::number(currentAdditionalTimestamp) + "\n";
-                int nBytes = text.size();
-                if (_handleFile.write(_previousTextLine.toLatin1()) < nBytes)
-                {
-                    emit statusChanged(FileWriter::ERROR_ON_WRITING);
-                }
-            }
-            */
-            _lastAdditionalValue = (*additionalToWrite.begin()).data()[0];
-            text += QString::number(_lastAdditionalValue) + "\t";
-            additionalToWrite.pop_front();
-            currentAdditionalTimestamp = 0;
-        }
-        else if (_isRecordingAdditionalChannel)
-        {
-            text += QString::number(_lastAdditionalValue) + "\t";
-        }
+        if (aligned.additional != 0)
+            _lastAdditionalValue = aligned.additional->data()[0];
+        if (isWritingEASY && (aligned.additional != 0 || _isRecordingAdditionalChannel))
+            _easyEncoder.appendField(_lastAdditionalValue);
 
-        if (currentTriggerTimestamp > 0 &&
-            (*data).timestamp() >= currentTriggerTimestamp)
+        int trigger = 0;
+        if (aligned.trigger != 0)
         {
-            //qDebug() << ((*data).timestamp() - currentTriggerTimestamp);
-            text += QString::number((*triggerToWrite.begin()).getCode());
-            triggerToWrite.pop_front();
-            currentTriggerTimestamp = 0;
+            trigger = aligned.trigger->getCode();
         }
-        else
+        else if ((*data).isRepeated())
         {
-            if ((*data).isRepeated())
-            {
-                _countTrigger255++;
-                text += QString::number(255);
-            }
-//            else if ((*data).isCompressionOverflow())
-//            {
-//                _countTrigger254++;
-//                text += QString::number(254);
-//                //qDebug()<<"_dataToFile trigger 254"<<(*data).timestamp();
-//            }
-            else
-                text += "0";
+            _countTrigger255++;
+            trigger = 255;
         }
 
-        text += "\t";
-        text += QString::number((*data).timestamp());
-        //text += "\n";
-        /*
-        int nBytes = text.size();
-        if (_handleFile.write(text.toLatin1()) < nBytes)
-        {
-            emit statusChanged(FileWriter::ERROR_ON_WRITING);
-        }
-        */
+        if (isWritingEASY)
+            _easyEncoder.appendLineEnd(trigger, (*data).timestamp());
+        if (isWritingNEDC)
+            _nedcWriter.appendSample(*data, _lastAccelerometerValue, _lastAdditionalValue, trigger);
+    }
+
+    dataToWrite.pop_front(numSamples);
+    accelerometer.commit();
+    additional.commit();
+    triggers.commit();
 
-        //                        if ((_currentTimestamp-_firstEEGTimeStamp)>3000)
-//                                    emit newEEGData(_lastEEGData);
-        //                        else
-        //                            qDebug()<<"Timestamps dif"<<(_currentTimestamp-_firstEEGTimeStamp);
+    _easySink.append(_easyEncoder.data(), _easyEncoder.size());
+    _handOff(_easySink);
 
-        stream << text << endl;
+    _compressedSink.append(_nedcWriter.output());
+    _nedcWriter.clearOutput();
+    _handOff(_compressedSink);
+}
 
-        stream.flush();
-        dataToWrite.pop_front();
+void FileWriter::_stimToFile()
+{
+    // Channels and timestamp
+    int numSamples = stimDataToWrite.size();
+    _stimEncoder.begin(numSamples, _numOfChannels + 1);
+    for (int i = 0; i < numSamples; i++)
+    {
+        _stimEncoder.appendStim(stimDataToWrite[i], _numOfChannels);
+        _stimEncoder.appendStimLineEnd(stimDataToWrite[i].timestamp());
+    }
+    stimDataToWrite.clear();
+
+    _stimSink.append(_stimEncoder.data(), _stimEncoder.size());
+    _handOff(_stimSink);
+}
+
+void FileWriter::_handOff (AsyncFileSink &sink)
+{
+    sink.handOff();
+    if (sink.takeWriteError())
+    {
+        _currentStatus=ERROR_ON_WRITING;
+        emit statusChanged(FileWriter::ERROR_ON_WRITING);
     }
 }
 
@@ -752,15 +720,15 @@ void FileWriter::onNewData(ChannelData data)
     }*/
 
     bool startedStoringData= false;
-    if (_handleFile.isOpen()||_handleBinaryFile.isOpen())
+    if (_handleFile.isOpen()||_handleBinaryFile.isOpen()||_handleCompressedFile.isOpen())
     {
         startedStoringData = true;
 
         _numberOfEEGSamples++;
     }
 
-    //EASY file
-    if (_isRecordingEASY)
+    //EASY and NEDC files
+    if (_isRecordingEASY || _isRecordingNEDC)
     {
         if (_handleFile.isOpen()||startedStoringData == true)
         {
@@ -846,13 +814,13 @@ void FileWriter::onNewTrigger (Trigger trigger)
     }
 
     bool startedStoringData = false;
-    if (_handleFile.isOpen()||_handleBinaryFile.isOpen())
+    if (_handleFile.isOpen()||_handleBinaryFile.isOpen()||_handleCompressedFile.isOpen())
     {
         startedStoringData = true;
     }
 
-    //EASY file
-    if (_isRecordingEASY)
+    //EASY and NEDC files
+    if (_isRecordingEASY || _isRecordingNEDC)
     {
         if (_handleFile.isOpen()||startedStoringData == true)
         {
@@ -874,7 +842,7 @@ void FileWriter::onNewAdditionalData (ChannelData data)
 {
     QMutexLocker locker(&_mutex);
 
-    if ((!isWriting()) || (!_isRecordingAdditionalChannel))
+    if ((!isWriting() && !_handleCompressedFile.isOpen()) || (!_isRecordingAdditionalChannel))
     {
         return;
     }
@@ -937,13 +905,13 @@ void FileWriter::onNewAccelerometerData (ChannelData data)
     }
 
     bool startedStoringData = false;
-    if (_handleFile.isOpen()||_handleBinaryFile.isOpen())
+    if (_handleFile.isOpen()||_handleBinaryFile.isOpen()||_handleCompressedFile.isOpen())
     {
         startedStoringData = true;
     }
 
-    //EASY file
-    if (_isRecordingEASY)
+    //EASY and NEDC files
+    if (_isRecordingEASY || _isRecordingNEDC)
     {
         if (_handleFile.isOpen()||startedStoringData == true)
         {
@@ -972,97 +940,45 @@ void FileWriter::onNewAccelerometerData (ChannelData data)
 
 void FileWriter::EEGbinaryDataToFile (int numSamples)
 {
-    QDataStream data(&_handleBinaryFile);
-    int auxNumber,aux;
+    // The whole window is encoded in memory and written at once
+    const int noAccelerometer[NEDF_ACCELEROMETER_AXES] = {0, 0, 0};
+    _nedfEncoder.begin(numSamples, _numOfChannels, false);
 
-    unsigned long long timestampEEGlow, timestampEEGhigh;
-    long long timestampEEG;
-    long long timestampTrigger;
-    unsigned long long timestampAccelerometer;
-    int trigger;
-    int p;
+    // Every EEG sample takes at most one trigger, the accelerometer is
+    // written every fifth sample with the first record of its 8 ms
+    StreamCursor<ChannelData> accelerometer(binaryAccelerometerDataToWrite);
+    StreamCursor<Trigger> triggers(binaryTriggerToWrite);
+    _streamMerge.align(binaryEEGDataToWrite, numSamples, 0, 0, &triggers);
 
-    char b;
+    unsigned long long timestampEEGlow;
+    int trigger;
 
     for (int k = 0; k < numSamples; k ++)
     {
-        timestampEEG = (*binaryEEGDataToWrite.begin()).timestamp();
-        if (counterAcc == 1)
-        {
-            timestampEEGlow = timestampEEG;
-        }
+        ChannelData &eeg = binaryEEGDataToWrite[k];
 
-        bool dataWritten;
         if (_isRecordingAccelerometer==true)
         {
             if (counterAcc == 1)
             {
                 counterAcc = 5;
-                timestampEEGhigh = timestampEEGlow+8;
-                dataWritten = false;
-                if (binaryAccelerometerDataToWrite.size() >0)
+                timestampEEGlow = eeg.timestamp();
+                if (!accelerometer.isEmpty())
                 {
-                    while (binaryAccelerometerDataToWrite.size() >0)
+                    ChannelData *record = accelerometer.takeRange(timestampEEGlow, timestampEEGlow + 8);
+                    if (record != 0)
                     {
-                        timestampAccelerometer = binaryAccelerometerDataToWrite[0].timestamp();
-
-                        //qDebug() << "timestampAccelerometer" << timestampAccelerometer;
-                        //qDebug() << "timestampEEGlow" << timestampEEGlow;
-
-                        if ((timestampAccelerometer >= timestampEEGlow)&&(timestampAccelerometer <= timestampEEGhigh))
-                        {
-                            if (dataWritten == false)
-                            {
-                                _latestAccelerometerWritten=binaryAccelerometerDataToWrite[0];
-                                for (p=0;p<3;p++)
-                                {
-                                    auxNumber = (*binaryAccelerometerDataToWrite.begin()).data()[p];
-                                    //streamEEG << accelerometer;
-                                    for (int i=2;i>=0;i--)
-                                    {
-                                        b = ((auxNumber>>i*8) & 0xff);
-                                        data.writeRawData(&b,1);
-                                    }
-                                    //outArray << sample;
-                                }
-
-                                dataWritten = true;
-                            }
-                            binaryAccelerometerDataToWrite.pop_front();
-                        }
-                        else
-                        {
-                            if (dataWritten == false)
-                            {
-                                for (p=0;p<3;p++)
-                                {
-                                    auxNumber = _latestAccelerometerWritten.data()[p];
-                                    //streamEEG << accelerometer;
-                                    for (int i=2;i>=0;i--)
-                                    {
-                                        b = ((auxNumber>>i*8) & 0xff);
-                                        data.writeRawData(&b,1);
-                                    }
-                                }
-
-                                dataWritten = true;
-                            }
-                            break;
-                        }
+                        _latestAccelerometerWritten = *record;
+                        _nedfEncoder.appendAccelerometer(record->data());
+                    }
+                    else
+                    {
+                        _nedfEncoder.appendAccelerometer(_latestAccelerometerWritten.data());
                     }
                 }
                 else //Accelerometer data has not stated yet
                 {
-                    for (p=0;p<3;p++)
-                    {
-                        auxNumber = 0;
-                        //streamEEG << accelerometer;
-                        for (int i=2;i>=0;i--)
-                        {
-                            b = ((auxNumber>>i*8) & 0xff);
-                            data.writeRawData(&b,1);
-                        }
-                    }
+                    _nedfEncoder.appendAccelerometer(noAccelerometer);
                 }
             }
             else
@@ -1071,102 +987,46 @@ void FileWriter::EEGbinaryDataToFile (int numSamples)
             }
         }
 
-        for (int j = 0; j < _numOfChannels; j ++)
-        {
-            // EEG to file
-            if ((*binaryEEGDataToWrite.begin()).channelInfo() & (1 << j))
-            {
-                //data << (*binaryEEGDataToWrite.begin()).data()[j];
-                aux = (*binaryEEGDataToWrite.begin()).data()[j];
-                /*dataEEG[i] = (dataEEG[i] * 2.4 * 1000000000) /
-                8388607.0 / 6.0;*/
-                auxNumber = round(aux /2.4/1000000000* 6.0 * 8388607.0);
-                b = ((auxNumber>>3*8) & 0xff);
-                for (int i=2;i>=0;i--)
-                {
-                    b = ((auxNumber>>i*8) & 0xff);
-                    data.writeRawData(&b,1);
-                }
-            }
-            else
-            {
-                //data << -1;
+        // EEG to file
+        _nedfEncoder.appendEEG(eeg, _numOfChannels);
 
-                auxNumber = -1;
-                //Write only the first 3 bytes
-                for (int i=2;i>=0;i--)
-                {
-                    b = ((auxNumber>>i*8) & 0xff);
-                    data.writeRawData(&b,1);
-                }
-            }
+        if (_streamMerge[k].trigger != 0)
+        {
+            trigger = _streamMerge[k].trigger->getCode();
         }
-
-        if (binaryTriggerToWrite.size() > 0)
+        else if (eeg.isRepeated())
         {
-            timestampTrigger = binaryTriggerToWrite[0].getTimestamp();
-
-
-            //if (timestampTrigger >= timestampEEG)
-            if (timestampEEG >= timestampTrigger)
-            {
-                trigger = binaryTriggerToWrite[0].getCode();
-                b = ((trigger>>0*8) & 0xff);
-                data.writeRawData(&b,1);
-                binaryTriggerToWrite.pop_front();
-            }
-            else
-            {
-                if ((*binaryEEGDataToWrite.begin()).isRepeated())
-                {
-                    trigger = 255;
-                    if (!_isRecordingEASY)
-                        _countTrigger255++;
-                }
-//                else if ((*binaryEEGDataToWrite.begin()).isCompressionOverflow())
-//                {
-//                    trigger = 254;
-//                    if (!_isRecordingEASY)
-//                        _countTrigger254++;
-//                    //qDebug()<<"EEGBinaryDataToFile trigger 254"<<(*binaryEEGDataToWrite.begin()).timestamp();
-//                }
-                else
-                    trigger = 0;
-
-                b = ((trigger>>0*8) & 0xff);
-                data.writeRawData(&b,1);
-            }
+            trigger = 255;
+            if (!_isRecordingEASY)
+                _countTrigger255++;
         }
+//        else if (eeg.isCompressionOverflow())
+//        {
+//            trigger = 254;
+//            if (!_isRecordingEASY)
+//                _countTrigger254++;
+//        }
         else
         {
-            if ((*binaryEEGDataToWrite.begin()).isRepeated())
-            {
-                trigger = 255;
-                if (!_isRecordingEASY)
-                    _countTrigger255++;
-            }
-//            else if ((*binaryEEGDataToWrite.begin()).isCompressionOverflow())
-//            {
-//                trigger = 254;
-//                if (!_isRecordingEASY)
-//                    _countTrigger254++;
-//                //qDebug()<<"EEGBinaryDataToFile trigger 254"<<(*binaryEEGDataToWrite.begin()).timestamp();
-//            }
-            else
-                trigger = 0;
-
-            b = ((trigger>>0*8) & 0xff);
-            data.writeRawData(&b,1);
+            trigger = 0;
         }
 
-        binaryEEGDataToWrite.pop_front();
-
+        _nedfEncoder.appendTrigger(trigger);
     }
+
+    binaryEEGDataToWrite.pop_front(numSamples);
+    accelerometer.commit();
+    triggers.commit();
+
+    _binarySink.append(_nedfEncoder.data(), _nedfEncoder.size());
+    _handOff(_binarySink);
 }
 
 void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
 {
-    QDataStream data(&_handleBinaryFile);
+    // The whole window is encoded in memory and written at once
+    const int noAccelerometer[NEDF_ACCELEROMETER_AXES] = {0, 0, 0};
+    _nedfEncoder.begin(numSamples, _numOfChannels, true);
 
     unsigned long long timestampEEG;
     unsigned long long timestampStim;
@@ -1174,10 +1034,13 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
     //unsigned long long timestampStimLow,timestampStimHigh;
 
     unsigned long long timestampLow,timestampHigh;
-    unsigned long long timestampAccelerometer;
 
-    int auxNumber,aux,p;
-    auxNumber = -1;
+    // The accelerometer is written every fifth EEG sample and at most one
+    // trigger with every EEG sample
+    StreamCursor<ChannelData> accelerometer(binaryAccelerometerDataToWrite);
+    StreamCursor<Trigger> triggers(binaryTriggerToWrite);
+
+    int p;
 
    /* int sizeEEG = binaryEEGDataToWrite.size();
     int sizeStim = binaryStimDataToWrite.size();
@@ -1201,7 +1064,6 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
     }*/
 
 
-    char b;
     int trigger;
 
     int diff;
@@ -1213,8 +1075,8 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
     {
         if ((binaryEEGDataToWrite.size()>0)&&(binaryStimDataToWrite.size()>0))
         {
-            timestampEEG = (*binaryEEGDataToWrite.begin()).timestamp();
-            timestampStim = (*binaryStimDataToWrite.begin()).timestamp();
+            timestampEEG = binaryEEGDataToWrite.first().timestamp();
+            timestampStim = binaryStimDataToWrite.first().timestamp();
             if (counterAcc == 1)
             {
                 timestampLow = timestampEEG;
@@ -1276,86 +1138,30 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
             }
         }
 
-        bool dataWritten = false;
-
         if (_isRecordingAccelerometer==true)
         {
             if (counterAcc == 1)
             {
                 counterAcc = 5;
                 timestampHigh = timestampLow + 8;
-                if (binaryAccelerometerDataToWrite.size() >0)
+                if (!accelerometer.isEmpty())
                 {
-                    dataWritten = false;
-                    while (binaryAccelerometerDataToWrite.size() >0)
+                    // Late records are dropped. Nothing is written if only
+                    // late records were left.
+                    ChannelData *record = accelerometer.takeThrough(timestampLow, timestampHigh);
+                    if (record != 0)
                     {
-                            timestampAccelerometer = binaryAccelerometerDataToWrite[0].timestamp();
-
-                            while (timestampAccelerometer < timestampLow)
-                            {
-                                binaryAccelerometerDataToWrite.pop_front();
-                                if (binaryAccelerometerDataToWrite.size()>0)
-                                    timestampAccelerometer = binaryAccelerometerDataToWrite[0].timestamp();
-                                else
-                                    break;
-                            }
-
-                            if (binaryAccelerometerDataToWrite.size()<=0)
-                                break;
-
-
-                        if (((timestampAccelerometer >= timestampLow)&&(timestampAccelerometer <= timestampHigh)))                        
-                        {
-                            if (dataWritten == false)
-                            {
-                                _latestAccelerometerWritten=binaryAccelerometerDataToWrite[0];
-
-                                for (p=0;p<3;p++)
-                                {
-                                    auxNumber = (*binaryAccelerometerDataToWrite.begin()).data()[p];
-                                    for (int i=2;i>=0;i--)
-                                    {
-                                        b = ((auxNumber>>i*8) & 0xff);
-                                        data.writeRawData(&b,1);
-                                    }
-                                }
-                                dataWritten = true;
-                            }
-                            binaryAccelerometerDataToWrite.pop_front();
-
-                            if (binaryAccelerometerDataToWrite.size()<=0)
-                                break;
-                        }
-                        else
-                        {
-                            if (dataWritten == false)
-                            {
-                                for (p=0;p<3;p++)
-                                {
-                                    auxNumber = _latestAccelerometerWritten.data()[p];
-                                    for (int i=2;i>=0;i--)
-                                    {
-                                        b = ((auxNumber>>i*8) & 0xff);
-                                        data.writeRawData(&b,1);
-                                    }
-                                }
-                                dataWritten = true;
-                            }
-                            break;
-                        }
+                        _latestAccelerometerWritten = *record;
+                        _nedfEncoder.appendAccelerometer(record->data());
+                    }
+                    else if (!accelerometer.isEmpty())
+                    {
+                        _nedfEncoder.appendAccelerometer(_latestAccelerometerWritten.data());
                     }
                 }
                 else
                 {
-                    for (p=0;p<3;p++)
-                    {
-                        auxNumber = 0;
-                        for (int i=2;i>=0;i--)
-                        {
-                            b = ((auxNumber>>i*8) & 0xff);
-                            data.writeRawData(&b,1);
-                        }
-                    }
+                    _nedfEncoder.appendAccelerometer(noAccelerometer);
                 }
             }
             else
@@ -1365,46 +1171,11 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
         }
 
 
-        for (int j = 0 ; j < _numOfChannels ; j ++)
-        {
-            // EEG to file
-            if((writeEEG == true)&&(binaryEEGDataToWrite.size()>0)) //EEG data starts later
-            {
-                //incrementEEGIndex = true;
-                if ((*binaryEEGDataToWrite.begin()).channelInfo() & (1 << j))
-                {
-                    aux = (*binaryEEGDataToWrite.begin()).data()[j];
-                    auxNumber = round(aux /2.4/1000000000* 6.0 * 8388607.0);
-                    //Write only the first 3 bytes
-                    for (int i=2;i>=0;i--)
-                    {
-                        b = ((auxNumber>>i*8) & 0xff);
-                        data.writeRawData(&b,1);
-                    }
-                }
-                else
-                {
-                    auxNumber = -1;
-                    //Write only the first 3 bytes
-                    for (int i=2;i>=0;i--)
-                    {
-                        b = ((auxNumber>>i*8) & 0xff);
-                        data.writeRawData(&b,1);
-                    }
-                }
-            }
-            else
-            {
-                auxNumber = -1;
-                //Write only the first 3 bytes
-                for (int i=2;i>=0;i--)
-                {
-                    b = ((auxNumber>>i*8) & 0xff);
-                    data.writeRawData(&b,1);
-                }
-
-            }
-        }
+        // EEG to file
+        if((writeEEG == true)&&(binaryEEGDataToWrite.size()>0))
+            _nedfEncoder.appendEEG(binaryEEGDataToWrite.first(), _numOfChannels);
+        else //EEG data starts later
+            _nedfEncoder.appendMissing(_numOfChannels);
 
         /*if (auxNumber != -1)
             binaryEEGDataToWrite.pop_front();*/
@@ -1418,110 +1189,37 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
                 break;
             }
 
-            for (int j = 0 ; j < _numOfChannels ; j ++)
-            {
-                //Stim data to file
-                if ((writeStim == true)&&(binaryStimDataToWrite.size()>0))
-                {
-                    if (binaryStimDataToWrite[p].channelInfo() & (1 << j))
-                    {
-                        auxNumber=binaryStimDataToWrite[p].data()[j];
-
-                        if (auxNumber>32768)
-                            auxNumber -= 65536;
-
-                        auxNumber*=2000;
-                        auxNumber/=32768;
-
-                        //Write only the first 3 bytes
-                        for (int i=2;i>=0;i--)
-                        {
-                            b = ((auxNumber>>i*8) & 0xff);
-                            data.writeRawData(&b,1);
-                        }
-                    }
-                    else
-                    {
-                        auxNumber = -1;
-                        //Write only the first 3 bytes
-                        for (int i=2;i>=0;i--)
-                        {
-                            b = ((auxNumber>>i*8) & 0xff);
-                            data.writeRawData(&b,1);
-                        }
-                    }
-                }
-                else //Stimulation data starts later
-                {
-                    auxNumber = -1;
-                    //Write only the first 3 bytes
-                    for (int i=2 ;i>=0;i--)
-                    {
-                        b = ((auxNumber>>i*8) & 0xff);
-                        data.writeRawData(&b,1);
-                    }
-                }
-            }
+            //Stim data to file
+            if ((writeStim == true)&&(binaryStimDataToWrite.size()>0))
+                _nedfEncoder.appendStim(binaryStimDataToWrite[p], _numOfChannels);
+            else //Stimulation data starts later
+                _nedfEncoder.appendMissing(_numOfChannels);
         }
 
-        long long timestampTrigger;
-
-        if (binaryTriggerToWrite.size() > 0)
+        Trigger *aligned = triggers.takeUntil(timestampEEG);
+        if (aligned != 0)
         {
-            timestampTrigger = binaryTriggerToWrite[0].getTimestamp();
-
-            //if (timestampTrigger >= timestampEEG)
-            if (timestampEEG >= timestampTrigger)
-            {
-                trigger = binaryTriggerToWrite[0].getCode();
-                b = ((trigger>>0*8) & 0xff);
-                data.writeRawData(&b,1);
-                binaryTriggerToWrite.pop_front();
-            }
-            else
-            {
-                if ((*binaryEEGDataToWrite.begin()).isRepeated())
-                {
-                    trigger = 255;
-                    if (!_isRecordingEASY)
-                        _countTrigger255++;
-                }
-//                else if ((*binaryEEGDataToWrite.begin()).isCompressionOverflow())
-//                {
-//                    trigger = 254;
-//                    if (!_isRecordingEASY)
-//                        _countTrigger254++;
-//                    //qDebug()<<"EEGBinaryDataToFile trigger 254"<<(*binaryEEGDataToWrite.begin()).timestamp();
-//                }
-                else
-                    trigger = 0;
-
-                b = ((trigger>>0*8) & 0xff);
-                data.writeRawData(&b,1);
-            }
+            trigger = aligned->getCode();
         }
+        else if (binaryEEGDataToWrite.first().isRepeated())
+        {
+            trigger = 255;
+            if (!_isRecordingEASY)
+                _countTrigger255++;
+        }
+//        else if (binaryEEGDataToWrite.first().isCompressionOverflow())
+//        {
+//            trigger = 254;
+//            if (!_isRecordingEASY)
+//                _countTrigger254++;
+//        }
         else
         {
-            if ((*binaryEEGDataToWrite.begin()).isRepeated())
-            {
-                trigger = 255;
-                if (!_isRecordingEASY)
-                    _countTrigger255++;
-            }
-//            else if ((*binaryEEGDataToWrite.begin()).isCompressionOverflow())
-//            {
-//                trigger = 254;
-//                if (!_isRecordingEASY)
-//                    _countTrigger254++;
-//                //qDebug()<<"EEGBinaryDataToFile trigger 254"<<(*binaryEEGDataToWrite.begin()).timestamp();
-//            }
-            else
-                trigger = 0;
-
-            b = ((trigger>>0*8) & 0xff);
-            data.writeRawData(&b,1);
+            trigger = 0;
         }
 
+        _nedfEncoder.appendTrigger(trigger);
+
         if ((writeStim == true)&&(binaryStimDataToWrite.size()>0))
         {
             if (binaryStimDataToWrite.size()>0)
@@ -1541,6 +1239,12 @@ void FileWriter::StimEEGbinaryDataToFile (int numSamples, bool endOfRecording)
                 binaryEEGDataToWrite.pop_front();
         }
     }
+
+    accelerometer.commit();
+    triggers.commit();
+
+    _binarySink.append(_nedfEncoder.data(), _nedfEncoder.size());
+    _handOff(_binarySink);
 }
 
 void FileWriter::onNewStimData (ChannelData data)
@@ -1581,50 +1285,7 @@ void FileWriter::onNewStimData (ChannelData data)
             stimDataToWrite.push_back(data);
 
             if (stimDataToWrite.size() >= 500) // wait for one second of data on the list
-            {
-                //qDebug() << "FileWriter::onNewData" << dataToWrite.size();
-
-                QString text = "";
-                int auxNumber=0;
-
-                for (int i=0;i<stimDataToWrite.size();i++)
-                {
-                    text="";
-
-                    for (int j = 0; j < _numOfChannels; j ++)
-                    {
-                        if (stimDataToWrite[i].channelInfo() & (1 << j))
-                        {
-                            auxNumber=stimDataToWrite[i].data()[j];
-
-                            if (auxNumber>32768)
-                                auxNumber -= 65536;
-
-                            auxNumber*=2000;
-                            auxNumber/=32768;
-
-                            text += QString::number(auxNumber);
-                        }
-                        else
-                        {
-                            text += "-1";
-                        }
-                        text += "\t";
-                    }
-
-                    text+=QString::number(stimDataToWrite[i].timestamp());
-                    text += "\n";
-
-                    QByteArray bytes = text.toLatin1();
-                    qint64 writtenBytes = _handleStimFile.write(bytes);
-                    if (writtenBytes < bytes.length())
-                    {
-                        _currentStatus=ERROR_ON_WRITING;
-                        emit statusChanged(FileWriter::ERROR_ON_WRITING);
-                    }
-                }
-                stimDataToWrite.clear();
-            }
+                _stimToFile();
         }
     }
 
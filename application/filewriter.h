@@ -8,8 +8,20 @@
 
 #include "channeldata.h"
 #include "trigger.h"
+#include "nedfencoder.h"
+#include "easyencoder.h"
+#include "nedcfile.h"
+#include "asyncfilesink.h"
+#include "ringbuffer.h"
+#include "streammerge.h"
 #include "commonparameters.h"
 
+#define FILEWRITER_EASY_QUEUE_LEN   ((int) (12 * FREQ_SAMP))    // EEG samples, 10 s are gathered before writing the EASY file
+#define FILEWRITER_NEDF_QUEUE_LEN   ((int) (2 * FREQ_SAMP))     // EEG samples, 1 s is gathered before writing the NEDF file
+#define FILEWRITER_STIM_QUEUE_LEN   ((int) (4 * FREQ_SAMP))     // Stimulation samples, two per EEG sample
+#define FILEWRITER_ACCEL_QUEUE_LEN  ((int) (3 * FREQ_SAMP))     // Accelerometer samples, one every five EEG samples
+#define FILEWRITER_EASY_FIELD_SIZE  (9)                         // [bytes] Expected length of an EASY field with its separator
+
 /*!
  * \class FileWriter FileWriter.h
  *
@@ -94,6 +106,28 @@ public:
      */
     bool isWritingBinaryData();
 
+    /*!
+     * It returns the figures of the thread writing the EASY file: the
+     * buffers waiting for the disk and the time the data reception had to
+     * wait for them
+     */
+    AsyncFileSink::Statistics easyWriterStatistics () { return _easySink.statistics(); }
+
+    /*!
+     * It returns the figures of the thread writing the NEDF file
+     */
+    AsyncFileSink::Statistics binaryWriterStatistics () { return _binarySink.statistics(); }
+
+    /*!
+     * It returns the figures of the thread writing the NEDC file
+     */
+    AsyncFileSink::Statistics compressedWriterStatistics () { return _compressedSink.statistics(); }
+
+    /*!
+     * It returns the figures of the thread writing the STIM file
+     */
+    AsyncFileSink::Statistics stimWriterStatistics () { return _stimSink.statistics(); }
+
     /*!
      * It informs if the incoming stimulation data is being recorded.
      *
@@ -317,6 +351,33 @@ public:
     void setRecordingEASYFile (bool recordEASY);
     void setRecordingSTIMFile (bool recordSTIM);
 
+    /*!
+     * \param recordNEDC
+     *
+     * It sets whether the EEG is also recorded in a NEDC file, the losslessly
+     * compressed format. It takes the same data as the EASY file.
+     */
+    void setRecordingNEDCFile (bool recordNEDC);
+
+    /*!
+     * \param seconds Expected length of the next recordings, 0 if unknown
+     *
+     * The space of the files is reserved from the start for that long; past
+     * it, or if it is unknown, the space is reserved in large extents. The
+     * space not used is released when the files are closed.
+     */
+    void setExpectedDuration (int seconds);
+
+    /*!
+     * \param policy When the data of the recordings is synced to the disk
+     *
+     * \param interval [ms] Time between syncs with
+     * AsyncFileSink::SYNC_PERIODIC
+     *
+     * It applies from the next call to startWriting().
+     */
+    void setSyncPolicy (AsyncFileSink::SyncPolicy policy, int interval = 1000);
+
     bool _isStimulating;
 
     //This boolean is useful to emit EEGNotes after a stim session
@@ -399,6 +460,25 @@ private:
 
     void _dataToFile(int numSamples);
 
+    /*!
+     * It formats the stimulation samples waiting in stimDataToWrite, hands
+     * them to the STIM sink and removes them
+     */
+    void _stimToFile();
+
+    /*!
+     * It queues the data appended to a sink to be written and reports the
+     * writes that failed meanwhile
+     */
+    void _handOff (AsyncFileSink &sink);
+
+    /*!
+     * It returns the bytes expected in a file for the expected duration
+     *
+     * \param bytesPerSample Bytes written per EEG sample
+     */
+    qint64 _expectedSize (int bytesPerSample);
+
     /*!
      * \property FileWriter::_numOfChannels
      *
@@ -455,6 +535,42 @@ private:
      */
     QFile _handleBinaryFile;
 
+    /*!
+     * \property FileWriter::_easySink
+     *
+     * It writes the EASY file from a thread of its own, so that the data
+     * reception never waits for the disk.
+     */
+    AsyncFileSink _easySink;
+
+    /*!
+     * \property FileWriter::_binarySink
+     *
+     * It writes the NEDF file from a thread of its own.
+     */
+    AsyncFileSink _binarySink;
+
+    /*!
+     * \property FileWriter::_handleCompressedFile
+     *
+     * Handle to the NEDC file.
+     */
+    QFile _handleCompressedFile;
+
+    /*!
+     * \property FileWriter::_compressedSink
+     *
+     * It writes the NEDC file from a thread of its own.
+     */
+    AsyncFileSink _compressedSink;
+
+    /*!
+     * \property FileWriter::_stimSink
+     *
+     * It writes the STIM file from a thread of its own.
+     */
+    AsyncFileSink _stimSink;
+
 
 
     bool _isPreEEG;
@@ -464,20 +580,28 @@ private:
     bool _isRecordingNEDF;
     bool _isRecordingSTIM;
     bool _isRecordingEASY;    
+    bool _isRecordingNEDC;
+
+    /*!
+     * \property FileWriter::_expectedDuration
+     *
+     * [s] Expected length of the recordings, 0 if unknown
+     */
+    int _expectedDuration;
 
     //QStringList dataToWrite;
-    QList<ChannelData> dataToWrite;
-    QList<ChannelData> stimDataToWrite;
-    QList<ChannelData> binaryEEGDataToWrite;
-    QList<ChannelData> binaryStimDataToWrite;
-    QList<ChannelData> binaryAccelerometerDataToWrite;
-    QList<Trigger> binaryTriggerToWrite;
-    QList<Trigger> triggerToWrite;
+    RingBuffer<ChannelData> dataToWrite;
+    RingBuffer<ChannelData> stimDataToWrite;
+    RingBuffer<ChannelData> binaryEEGDataToWrite;
+    RingBuffer<ChannelData> binaryStimDataToWrite;
+    RingBuffer<ChannelData> binaryAccelerometerDataToWrite;
+    RingBuffer<Trigger> binaryTriggerToWrite;
+    RingBuffer<Trigger> triggerToWrite;
 
     QStringList AdditionaldataToWrite;
     QStringList AccelerometerDataToWrite;
-    QList<ChannelData> accelerometerToWrite;
-    QList<ChannelData> additionalToWrite;
+    RingBuffer<ChannelData> accelerometerToWrite;
+    RingBuffer<ChannelData> additionalToWrite;
 
     int _lastAccelerometerValue[3];
 
@@ -495,6 +619,42 @@ private:
      */
     ChannelData _latestAccelerometerWritten;
 
+    /*!
+     * \property FileWriter::_nedfEncoder
+     *
+     * It encodes every window of the NEDF file before writing it.
+     */
+    NedfEncoder _nedfEncoder;
+
+    /*!
+     * \property FileWriter::_easyEncoder
+     *
+     * It formats every window of the EASY file before writing it.
+     */
+    EasyEncoder _easyEncoder;
+
+    /*!
+     * \property FileWriter::_stimEncoder
+     *
+     * It formats every window of the STIM file before writing it.
+     */
+    EasyEncoder _stimEncoder;
+
+    /*!
+     * \property FileWriter::_nedcWriter
+     *
+     * It compresses the samples of the NEDC file in blocks.
+     */
+    NedcWriter _nedcWriter;
+
+    /*!
+     * \property FileWriter::_streamMerge
+     *
+     * It aligns the triggers and side channels with every window of EEG
+     * samples written.
+     */
+    StreamMerge _streamMerge;
+
     int _numberOfEEGSamples;
     int _numberOfStimSamples;
 
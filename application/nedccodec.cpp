@@ -0,0 +1,280 @@
+#include "nedccodec.h"
+
+#include <string.h>
+
+#define NEDC_RAW_PARAMETER  (31)    // Rice parameter meaning 32-bit residuals
+
+/*!
+ * It returns a mask of the given number of low bits, up to 32
+ */
+static inline quint32 lowBits (int numOfBits)
+{
+    return (numOfBits >= 32) ? 0xffffffffu : ((1u << numOfBits) - 1);
+}
+
+/*!
+ * It maps a signed residual to an unsigned one: 0, -1, 1, -2...
+ */
+static inline quint32 zigzag (quint32 residual)
+{
+    return (residual << 1) ^ (quint32) ((qint32) residual >> 31);
+}
+
+static inline quint32 unzigzag (quint32 value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+/*!
+ * It writes bits to a byte array, most significant bit first
+ */
+class BitWriter
+{
+public:
+    BitWriter (QByteArray &out) : _out(out), _bits(0), _count(0) {}
+
+    // Up to 32 bits at a time
+    void write (quint32 value, int numOfBits)
+    {
+        _bits = (_bits << numOfBits) | (value & lowBits(numOfBits));
+        _count += numOfBits;
+        while (_count >= 8)
+        {
+            _count -= 8;
+            _out.append((char) (_bits >> _count));
+        }
+    }
+
+    // It completes the last byte with zeros
+    void flush ()
+    {
+        if (_count > 0)
+            _out.append((char) (_bits << (8 - _count)));
+        _count = 0;
+    }
+
+private:
+    QByteArray &_out;
+    quint64 _bits;
+    int _count;
+};
+
+/*!
+ * It reads the bits written by BitWriter
+ */
+class BitReader
+{
+public:
+    BitReader (const char *data, int size) :
+        _data((const uchar*) data), _size(size), _position(0), _bits(0), _count(0) {}
+
+    // Up to 32 bits at a time, zeros past the end
+    quint32 read (int numOfBits)
+    {
+        while (_count < numOfBits)
+        {
+            quint64 byte = (_position < _size) ? _data[_position] : 0;
+            _position++;
+            _bits = (_bits << 8) | byte;
+            _count += 8;
+        }
+        _count -= numOfBits;
+        return (quint32) (_bits >> _count) & lowBits(numOfBits);
+    }
+
+    // Whether more bytes were read than available
+    bool isOverrun () const { return _position > _size; }
+
+private:
+    const uchar *_data;
+    int _size;
+    int _position;
+    quint64 _bits;
+    int _count;
+};
+
+/*!
+ * It computes the residuals of a fixed predictor
+ *
+ * \param padded Column preceded by NEDC_MAX_ORDER zeros
+ */
+static void predict (const quint32 *padded, int numOfSamples, int order, quint32 *residuals)
+{
+    const quint32 *x = padded + NEDC_MAX_ORDER;
+    switch (order)
+    {
+    case 0:
+        for (int i = 0; i < numOfSamples; i++)
+            residuals[i] = x[i];
+        break;
+    case 1:
+        for (int i = 0; i < numOfSamples; i++)
+            residuals[i] = x[i] - x[i - 1];
+        break;
+    case 2:
+        for (int i = 0; i < numOfSamples; i++)
+            residuals[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+    default:
+        for (int i = 0; i < numOfSamples; i++)
+            residuals[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+    }
+}
+
+/*!
+ * It rebuilds a column from the residuals of a fixed predictor
+ *
+ * \param padded Destination, preceded by NEDC_MAX_ORDER zeros
+ */
+static void reconstruct (const quint32 *residuals, int numOfSamples, int order, quint32 *padded)
+{
+    quint32 *x = padded + NEDC_MAX_ORDER;
+    switch (order)
+    {
+    case 0:
+        for (int i = 0; i < numOfSamples; i++)
+            x[i] = residuals[i];
+        break;
+    case 1:
+        for (int i = 0; i < numOfSamples; i++)
+            x[i] = residuals[i] + x[i - 1];
+        break;
+    case 2:
+        for (int i = 0; i < numOfSamples; i++)
+            x[i] = residuals[i] + 2 * x[i - 1] - x[i - 2];
+        break;
+    default:
+        for (int i = 0; i < numOfSamples; i++)
+            x[i] = residuals[i] + 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+        break;
+    }
+}
+
+/*!
+ * It returns the sum of the zigzag-mapped residuals
+ */
+static quint64 magnitude (const quint32 *residuals, int numOfSamples)
+{
+    quint64 sum = 0;
+    for (int i = 0; i < numOfSamples; i++)
+        sum += zigzag(residuals[i]);
+    return sum;
+}
+
+void NedcCodec::encode (const NedcBlock &block, int numOfColumns, QByteArray &out)
+{
+    const int n = block.numOfSamples;
+    quint32 padded[NEDC_MAX_ORDER + NEDC_BLOCK_SAMPLES];
+    quint32 residuals[NEDC_MAX_ORDER + 1][NEDC_BLOCK_SAMPLES];
+    memset(padded, 0, sizeof(padded));
+
+    out.reserve(out.size() + numOfColumns * n * 4);
+    BitWriter writer(out);
+
+    for (int c = 0; c < numOfColumns; c++)
+    {
+        memcpy(padded + NEDC_MAX_ORDER, block.columns[c], n * sizeof(quint32));
+
+        // Predictor with the smallest residuals
+        int order = 0;
+        quint64 sum = 0;
+        for (int o = 0; o <= NEDC_MAX_ORDER; o++)
+        {
+            predict(padded, n, o, residuals[o]);
+            quint64 s = magnitude(residuals[o], n);
+            if (o == 0 || s < sum)
+            {
+                order = o;
+                sum = s;
+            }
+        }
+
+        // Rice parameter close to log2 of the mean residual, unless plain
+        // 32-bit values are smaller
+        int parameter = 0;
+        while (parameter < NEDC_MAX_RICE_PARAMETER && ((quint64) n << (parameter + 1)) <= sum)
+            parameter++;
+        if ((quint64) n * (parameter + 1) + (sum >> parameter) >= (quint64) n * 32)
+            parameter = NEDC_RAW_PARAMETER;
+
+        writer.write(order, 2);
+        writer.write(parameter, 5);
+
+        const quint32 *r = residuals[order];
+        if (parameter == NEDC_RAW_PARAMETER)
+        {
+            for (int i = 0; i < n; i++)
+                writer.write(r[i], 32);
+            continue;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            quint32 value = zigzag(r[i]);
+            quint32 quotient = value >> parameter;
+            if (quotient < NEDC_RICE_ESCAPE)
+            {
+                // Unary quotient ended by a one, then the low bits
+                writer.write(1, quotient + 1);
+                writer.write(value, parameter);
+            }
+            else
+            {
+                writer.write(0, NEDC_RICE_ESCAPE);
+                writer.write(value, 32);
+            }
+        }
+    }
+
+    writer.flush();
+}
+
+bool NedcCodec::decode (const char *data, int size, int numOfColumns, NedcBlock &block)
+{
+    const int n = block.numOfSamples;
+    if (n < 0 || n > NEDC_BLOCK_SAMPLES || numOfColumns > NEDC_MAX_COLUMNS)
+        return false;
+
+    quint32 padded[NEDC_MAX_ORDER + NEDC_BLOCK_SAMPLES];
+    quint32 residuals[NEDC_BLOCK_SAMPLES];
+    memset(padded, 0, sizeof(padded));
+
+    BitReader reader(data, size);
+
+    for (int c = 0; c < numOfColumns; c++)
+    {
+        int order = reader.read(2);
+        int parameter = reader.read(5);
+
+        if (parameter == NEDC_RAW_PARAMETER)
+        {
+            for (int i = 0; i < n; i++)
+                residuals[i] = reader.read(32);
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+            {
+                quint32 quotient = 0;
+                while (quotient < NEDC_RICE_ESCAPE && reader.read(1) == 0)
+                    quotient++;
+
+                quint32 value;
+                if (quotient < NEDC_RICE_ESCAPE)
+                    value = (quotient << parameter) | reader.read(parameter);
+                else
+                    value = reader.read(32);
+                residuals[i] = unzigzag(value);
+            }
+        }
+
+        if (reader.isOverrun())
+            return false;
+
+        reconstruct(residuals, n, order, padded);
+        memcpy(block.columns[c], padded + NEDC_MAX_ORDER, n * sizeof(quint32));
+    }
+
+    return true;
+}
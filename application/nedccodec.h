@@ -0,0 +1,111 @@
+#ifndef NEDCCODEC_H
+#define NEDCCODEC_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include "commonparameters.h"
+
+#define NEDC_BLOCK_SAMPLES      (256)                   // Samples of a full block
+#define NEDC_MAX_COLUMNS        (N_MAX_CHANNELS + 7)    // EEG, channel info, accelerometer, additional, trigger and timestamp
+#define NEDC_MAX_ORDER          (3)                     // Highest order of the fixed predictors
+#define NEDC_RICE_ESCAPE        (24)                    // Quotients from it on are escaped and stored in 32 bits
+#define NEDC_MAX_RICE_PARAMETER (30)                    // Highest Rice parameter, 31 stores the residuals in 32 bits
+
+/*!
+ * \class NedcBlock nedccodec.h
+ *
+ * \brief This class holds the samples of a block of a NEDC file, one column
+ * per stored value. The columns are, in order: the EEG channels, the
+ * channel info, the three accelerometer axes and the additional channel
+ * when they are recorded, the trigger code and the timestamp difference
+ * with the previous sample.
+ */
+class NedcBlock
+{
+public:
+
+    /*!
+     * Units of the EEG columns
+     */
+    enum Units
+    {
+        UNITS_COUNTS = 0,       // ADC counts, as in NEDF files
+        UNITS_NANOVOLTS = 1     // nV, for data that can not be expressed in counts
+    };
+
+    /*!
+     * Constructor
+     */
+    NedcBlock () : numOfSamples(0), units(UNITS_COUNTS), firstTimestamp(0) {}
+
+    /*!
+     * Number of samples in the block
+     */
+    int numOfSamples;
+
+    /*!
+     * Units of the EEG columns
+     */
+    int units;
+
+    /*!
+     * Timestamp of the first sample
+     */
+    quint64 firstTimestamp;
+
+    /*!
+     * Values of every column
+     */
+    qint32 columns[NEDC_MAX_COLUMNS][NEDC_BLOCK_SAMPLES];
+
+    /*!
+     * Timestamp of every sample, filled when the block is read from a file
+     */
+    quint64 timestamps[NEDC_BLOCK_SAMPLES];
+};
+
+/*!
+ * \class NedcCodec nedccodec.h
+ *
+ * \brief This class compresses the columns of a NEDC block losslessly.
+ * Every column is predicted with the fixed polynomial predictor of order 0
+ * to NEDC_MAX_ORDER that gives the smallest residuals, the samples before
+ * the block being taken as zero, and the residuals are stored with a Rice
+ * code whose parameter is chosen per column. The arithmetic wraps around
+ * 32 bits, so any value is stored exactly. Predictions and residuals are
+ * computed by straight loops over a column, which the compiler vectorizes.
+ */
+class NedcCodec
+{
+public:
+
+    /*!
+     * It appends the compressed columns of a block
+     *
+     * \param block Block to compress
+     *
+     * \param numOfColumns Number of columns stored
+     *
+     * \param out Destination of the bytes
+     */
+    static void encode (const NedcBlock &block, int numOfColumns, QByteArray &out);
+
+    /*!
+     * It decompresses the columns of a block. The number of samples must be
+     * set in the block beforehand.
+     *
+     * \param data Compressed bytes
+     *
+     * \param size Number of compressed bytes
+     *
+     * \param numOfColumns Number of columns stored
+     *
+     * \param block Destination of the columns
+     *
+     * \return false if the data ends before all the columns are read
+     */
+    static bool decode (const char *data, int size, int numOfColumns, NedcBlock &block);
+};
+
+#endif // NEDCCODEC_H
@@ -0,0 +1,215 @@
+#include "nedcconverter.h"
+
+#include <QFile>
+
+#include "channeldata.h"
+#include "commonparameters.h"
+#include "easyencoder.h"
+#include "easyreader.h"
+#include "nedcfile.h"
+#include "nedfencoder.h"
+#include "nedfreader.h"
+
+/*!
+ * It writes the output of a NEDC writer to a file
+ */
+static bool writeOutput (NedcWriter &writer, QFile &file)
+{
+    const QByteArray &output = writer.output();
+    bool isComplete = (file.write(output.constData(), output.size()) == output.size());
+    writer.clearOutput();
+    return isComplete;
+}
+
+bool NedcConverter::easyToNedc (const QString &easyFileName, const QString &nedcFileName, int numOfChannels)
+{
+    EasyReader easy;
+    easy.setTaskPool(TaskPool::instance());
+    QFile nedcFile(nedcFileName);
+    if (numOfChannels <= 0 || numOfChannels > N_MAX_CHANNELS || !easy.open(easyFileName))
+        return false;
+
+    // Accelerometer and additional channel columns between the EEG and the
+    // trigger
+    int numOfFields = easy.numOfFields();
+    int numOfExtra = (easy.numOfRows() > 0) ? numOfFields - numOfChannels - 2 : 0;
+    if (numOfExtra != 0 && numOfExtra != 1 && numOfExtra != 3 && numOfExtra != 4)
+        return false;
+    if (!nedcFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    NedcLayout layout(numOfChannels, numOfExtra >= 3, numOfExtra % 3 == 1);
+    NedcWriter writer;
+    writer.begin(layout, FREQ_SAMP);
+
+    for (int r = 0; r < easy.numOfRows(); r++)
+    {
+        const qint64 *fields = easy.row(r);
+
+        ChannelData eeg;
+        unsigned int channelInfo = 0;
+        for (int j = 0; j < numOfChannels; j++)
+        {
+            int value = (int) fields[j];
+            eeg.setData(j, value);
+            if (value != -1)
+                channelInfo |= (1 << j);
+        }
+        eeg.setChannelInfo(channelInfo);
+        eeg.setTimestamp(fields[numOfFields - 1]);
+
+        int field = numOfChannels;
+        int accelerometer[3] = { 0, 0, 0 };
+        if (layout.hasAccelerometer)
+        {
+            for (int axis = 0; axis < 3; axis++)
+                accelerometer[axis] = (int) fields[field++];
+        }
+        int additional = layout.hasAdditional ? (int) fields[field++] : 0;
+
+        writer.appendSample(eeg, accelerometer, additional, (int) fields[field]);
+        if (writer.output().size() >= NEDC_CONVERTER_FLUSH_BYTES && !writeOutput(writer, nedcFile))
+            return false;
+    }
+
+    writer.finish();
+    return writeOutput(writer, nedcFile);
+}
+
+bool NedcConverter::nedfToNedc (const QString &nedfFileName, const QString &nedcFileName,
+                                int numOfChannels, bool hasAccelerometer, quint64 firstTimestamp)
+{
+    NedfReader nedf;
+    QFile nedcFile(nedcFileName);
+    if (!nedf.open(nedfFileName, NedfLayout(numOfChannels, hasAccelerometer, false)) ||
+        !nedcFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    NedcWriter writer;
+    writer.begin(NedcLayout(numOfChannels, hasAccelerometer, false), FREQ_SAMP);
+
+    const double period = 1000.0 / FREQ_SAMP;
+    int accelerometer[NEDF_ACCELEROMETER_AXES] = { 0, 0, 0 };
+    qint32 counts[N_MAX_CHANNELS];
+    ChannelData eeg;
+    eeg.setChannelInfo((numOfChannels < 32) ? (1u << numOfChannels) - 1 : 0xffffffffu);
+    eeg.setHasRawData(true);
+    eeg.setRepeated(false);
+
+    for (qint64 sample = 0; sample < nedf.numOfSamples(); sample++)
+    {
+        if (hasAccelerometer)
+            NedfReader::unpack24(nedf.accelerometer(sample), NEDF_ACCELEROMETER_AXES, accelerometer);
+
+        nedf.readEEG(sample, counts);
+        for (int j = 0; j < numOfChannels; j++)
+        {
+            eeg.setRawData(j, counts[j]);
+            eeg.setData(j, (counts[j] * 2.4 * 1000000000) / 8388607.0 / 6.0);
+        }
+        eeg.setTimestamp(firstTimestamp + (quint64) (sample * period));
+
+        writer.appendSample(eeg, accelerometer, 0, nedf.trigger(sample));
+        if (writer.output().size() >= NEDC_CONVERTER_FLUSH_BYTES && !writeOutput(writer, nedcFile))
+            return false;
+    }
+
+    writer.finish();
+    return writeOutput(writer, nedcFile);
+}
+
+bool NedcConverter::nedcToEasy (const QString &nedcFileName, const QString &easyFileName)
+{
+    NedcReader reader;
+    QFile easyFile(easyFileName);
+    if (!reader.open(nedcFileName) || !easyFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const NedcLayout &layout = reader.layout();
+    EasyEncoder encoder;
+    NedcBlock *block = new NedcBlock();
+    bool isComplete = true;
+
+    for (int b = 0; b < reader.numOfBlocks() && isComplete; b++)
+    {
+        if (!reader.readBlock(b, *block))
+        {
+            isComplete = false;
+            break;
+        }
+
+        encoder.begin(block->numOfSamples, layout.numOfColumns());
+        for (int i = 0; i < block->numOfSamples; i++)
+        {
+            ChannelData eeg;
+            eeg.setChannelInfo(block->columns[layout.channelInfoColumn()][i]);
+            for (int j = 0; j < layout.numOfChannels; j++)
+                eeg.setData(j, NedcReader::nanoVolts(*block, j, i));
+            encoder.appendEEG(eeg, layout.numOfChannels);
+
+            if (layout.hasAccelerometer)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                    encoder.appendField(block->columns[layout.accelerometerColumn() + axis][i]);
+            }
+            if (layout.hasAdditional)
+                encoder.appendField(block->columns[layout.additionalColumn()][i]);
+
+            encoder.appendLineEnd(block->columns[layout.triggerColumn()][i], block->timestamps[i]);
+        }
+
+        isComplete = (easyFile.write(encoder.data(), encoder.size()) == encoder.size());
+    }
+
+    delete block;
+    return isComplete;
+}
+
+bool NedcConverter::nedcToNedf (const QString &nedcFileName, const QString &nedfFileName)
+{
+    NedcReader reader;
+    QFile nedfFile(nedfFileName);
+    if (!reader.open(nedcFileName) || !nedfFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const NedcLayout &layout = reader.layout();
+    NedfEncoder encoder;
+    NedcBlock *block = new NedcBlock();
+    bool isComplete = (nedfFile.write(QByteArray(NEDF_HEADER_SIZE, 0)) == NEDF_HEADER_SIZE);
+    qint64 sample = 0;
+
+    for (int b = 0; b < reader.numOfBlocks() && isComplete; b++)
+    {
+        if (!reader.readBlock(b, *block))
+        {
+            isComplete = false;
+            break;
+        }
+
+        encoder.begin(block->numOfSamples, layout.numOfChannels, false);
+        for (int i = 0; i < block->numOfSamples; i++, sample++)
+        {
+            if (layout.hasAccelerometer && sample % NEDF_ACCELEROMETER_PERIOD == 0)
+            {
+                int accelerometer[NEDF_ACCELEROMETER_AXES];
+                for (int axis = 0; axis < NEDF_ACCELEROMETER_AXES; axis++)
+                    accelerometer[axis] = block->columns[layout.accelerometerColumn() + axis][i];
+                encoder.appendAccelerometer(accelerometer);
+            }
+
+            ChannelData eeg;
+            eeg.setChannelInfo(block->columns[layout.channelInfoColumn()][i]);
+            for (int j = 0; j < layout.numOfChannels; j++)
+                eeg.setRawData(j, NedcReader::counts(*block, j, i));
+            eeg.setHasRawData(true);
+            encoder.appendEEG(eeg, layout.numOfChannels);
+
+            encoder.appendTrigger(block->columns[layout.triggerColumn()][i]);
+        }
+
+        isComplete = (nedfFile.write(encoder.data(), encoder.size()) == encoder.size());
+    }
+
+    delete block;
+    return isComplete;
+}
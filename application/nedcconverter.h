@@ -0,0 +1,61 @@
+#ifndef NEDCCONVERTER_H
+#define NEDCCONVERTER_H
+
+#include <QString>
+
+#define NEDC_CONVERTER_FLUSH_BYTES  (65536)     // [bytes] Compressed output written to the file at once
+
+/*!
+ * \class NedcConverter nedcconverter.h
+ *
+ * \brief This class converts recordings between the NEDC format and the
+ * EASY and NEDF formats offline.
+ *
+ * An EASY file converted to NEDC and back is rebuilt byte by byte; the
+ * EASY value -1 is taken as a channel without data, as it is written. NEDF
+ * files carry neither timestamps nor channel info, so they are rebuilt
+ * from the sample rate and every channel is taken as present. The
+ * accelerometer of a NEDF file is the record of every fifth sample, which
+ * is held for the samples in between. Files with stimulation data are not
+ * supported.
+ */
+class NedcConverter
+{
+public:
+
+    /*!
+     * It converts an EASY file
+     *
+     * \param numOfChannels Number of EEG channels of the file, the other
+     * columns are deduced from the number of fields
+     *
+     * \return false if the files can not be read or written, or the EASY
+     * file is malformed
+     */
+    static bool easyToNedc (const QString &easyFileName, const QString &nedcFileName, int numOfChannels);
+
+    /*!
+     * It converts a NEDF file without stimulation data
+     *
+     * \param numOfChannels Number of EEG channels of the file
+     *
+     * \param hasAccelerometer Whether the file has accelerometer records
+     *
+     * \param firstTimestamp Timestamp given to the first sample
+     */
+    static bool nedfToNedc (const QString &nedfFileName, const QString &nedcFileName,
+                            int numOfChannels, bool hasAccelerometer, quint64 firstTimestamp = 0);
+
+    /*!
+     * It converts a NEDC file to EASY
+     */
+    static bool nedcToEasy (const QString &nedcFileName, const QString &easyFileName);
+
+    /*!
+     * It converts a NEDC file to NEDF. The 5120 bytes of the header are left
+     * empty, as the file writer does.
+     */
+    static bool nedcToNedf (const QString &nedcFileName, const QString &nedfFileName);
+};
+
+#endif // NEDCCONVERTER_H
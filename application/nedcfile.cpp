@@ -0,0 +1,438 @@
+#include "nedcfile.h"
+
+#include <QtEndian>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "crc32.h"
+
+static const char NEDC_MAGIC[4] = { 'N', 'E', 'D', 'C' };
+static const char NEDC_INDEX_MAGIC[4] = { 'N', 'E', 'D', 'I' };
+
+/*!
+ * It converts ADC counts to nV as the device driver does
+ */
+static inline int countsToNanoVolts (int counts)
+{
+    return (counts * 2.4 * 1000000000) / 8388607.0 / 6.0;
+}
+
+/*!
+ * It converts nV to ADC counts as the NEDF files are written
+ */
+static inline int nanoVoltsToCounts (int nanoVolts)
+{
+    return round(nanoVolts /2.4/1000000000* 6.0 * 8388607.0);
+}
+
+/*!
+ * It writes the summary of a block as stored in the block index
+ */
+static void writeIndexEntry (const NedcBlockInfo &info, uchar *entry)
+{
+    qToLittleEndian<quint64>(info.offset, entry);
+    qToLittleEndian<quint64>(info.firstTimestamp, entry + 8);
+    qToLittleEndian<quint64>(info.lastTimestamp, entry + 16);
+    qToLittleEndian<quint32>(info.numOfSamples, entry + 24);
+    qToLittleEndian<quint32>(info.channelMask, entry + 28);
+    qToLittleEndian<quint32>(info.numOfTriggers, entry + 32);
+}
+
+static NedcBlockInfo readIndexEntry (const uchar *entry)
+{
+    NedcBlockInfo info;
+    info.offset = qFromLittleEndian<quint64>(entry);
+    info.firstTimestamp = qFromLittleEndian<quint64>(entry + 8);
+    info.lastTimestamp = qFromLittleEndian<quint64>(entry + 16);
+    info.numOfSamples = qFromLittleEndian<quint32>(entry + 24);
+    info.channelMask = qFromLittleEndian<quint32>(entry + 28);
+    info.numOfTriggers = qFromLittleEndian<quint32>(entry + 32);
+    return info;
+}
+
+NedcWriter::NedcWriter () :
+    _hasExactCounts(true),
+    _channelMask(0),
+    _previousTimestamp(0),
+    _numOfSamples(0),
+    _numOfBlockTriggers(0),
+    _outputOffset(0)
+{
+}
+
+void NedcWriter::begin (const NedcLayout &layout, double sampleRate)
+{
+    _layout = layout;
+    if (_layout.numOfChannels > N_MAX_CHANNELS)
+        _layout.numOfChannels = N_MAX_CHANNELS;
+
+    _block.numOfSamples = 0;
+    _hasExactCounts = true;
+    _channelMask = 0;
+    _previousTimestamp = 0;
+    _numOfSamples = 0;
+    _index.clear();
+    _triggers.clear();
+    _numOfBlockTriggers = 0;
+    _output.resize(0);
+    _outputOffset = 0;
+
+    uchar header[NEDC_FILE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, NEDC_MAGIC, 4);
+    qToLittleEndian<quint16>(NEDC_VERSION, header + 4);
+    qToLittleEndian<quint16>(_layout.numOfChannels, header + 6);
+    qToLittleEndian<quint16>(NEDC_BLOCK_SAMPLES, header + 8);
+    qToLittleEndian<quint16>((_layout.hasAccelerometer ? 1 : 0) | (_layout.hasAdditional ? 2 : 0), header + 10);
+    qToLittleEndian<quint32>((quint32) (sampleRate * 1000.0 + 0.5), header + 12);
+    _output.append((const char*) header, sizeof(header));
+}
+
+void NedcWriter::appendSample (ChannelData &eeg, const int *accelerometer, int additional, int trigger)
+{
+    const int i = _block.numOfSamples;
+    const unsigned int channelInfo = eeg.channelInfo();
+    const int *nanoVolts = eeg.data();
+    const int *raw = eeg.rawData();
+    const bool hasRawData = eeg.hasRawData();
+
+    for (int j = 0; j < _layout.numOfChannels; j++)
+    {
+        if (!(channelInfo & (1 << j)))
+        {
+            _block.columns[j][i] = 0;
+            _nanoVolts[j][i] = 0;
+            continue;
+        }
+
+        _nanoVolts[j][i] = nanoVolts[j];
+        if (hasRawData)
+        {
+            _block.columns[j][i] = raw[j];
+        }
+        else
+        {
+            int counts = nanoVoltsToCounts(nanoVolts[j]);
+            _block.columns[j][i] = counts;
+            if (countsToNanoVolts(counts) != nanoVolts[j])
+                _hasExactCounts = false;
+        }
+    }
+    _channelMask |= channelInfo;
+
+    _block.columns[_layout.channelInfoColumn()][i] = channelInfo;
+    if (_layout.hasAccelerometer)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            _block.columns[_layout.accelerometerColumn() + axis][i] = accelerometer[axis];
+    }
+    if (_layout.hasAdditional)
+        _block.columns[_layout.additionalColumn()][i] = additional;
+    _block.columns[_layout.triggerColumn()][i] = trigger;
+
+    // Timestamps as the difference with the previous sample
+    quint64 timestamp = eeg.timestamp();
+    if (i == 0)
+        _block.firstTimestamp = timestamp;
+    _block.columns[_layout.timestampColumn()][i] = (i == 0) ? 0 : (qint32) (timestamp - _previousTimestamp);
+    _previousTimestamp = timestamp;
+
+    if (trigger != 0)
+    {
+        _triggers.append(NedcTriggerEntry(timestamp, trigger, _index.size()));
+        _numOfBlockTriggers++;
+    }
+
+    _block.numOfSamples++;
+    _numOfSamples++;
+    if (_block.numOfSamples == NEDC_BLOCK_SAMPLES)
+        _writeBlock();
+}
+
+void NedcWriter::_writeBlock ()
+{
+    if (_block.numOfSamples == 0)
+        return;
+
+    _block.units = _hasExactCounts ? NedcBlock::UNITS_COUNTS : NedcBlock::UNITS_NANOVOLTS;
+    if (!_hasExactCounts)
+    {
+        for (int j = 0; j < _layout.numOfChannels; j++)
+            memcpy(_block.columns[j], _nanoVolts[j], _block.numOfSamples * sizeof(qint32));
+    }
+
+    NedcBlockInfo info;
+    info.offset = numOfBytes();
+    info.firstTimestamp = _block.firstTimestamp;
+    info.lastTimestamp = _previousTimestamp;
+    info.numOfSamples = _block.numOfSamples;
+    info.channelMask = _channelMask;
+    info.numOfTriggers = _numOfBlockTriggers;
+    _index.append(info);
+
+    // The header is completed once the payload is known
+    int headerPosition = _output.size();
+    _output.resize(headerPosition + NEDC_BLOCK_HEADER_SIZE);
+    NedcCodec::encode(_block, _layout.numOfColumns(), _output);
+
+    uchar *header = (uchar*) _output.data() + headerPosition;
+    const char *payload = _output.constData() + headerPosition + NEDC_BLOCK_HEADER_SIZE;
+    int payloadSize = _output.size() - headerPosition - NEDC_BLOCK_HEADER_SIZE;
+    qToLittleEndian<quint32>(payloadSize, header);
+    qToLittleEndian<quint16>(_block.numOfSamples, header + 4);
+    qToLittleEndian<quint16>(_block.units, header + 6);
+    qToLittleEndian<quint64>(info.firstTimestamp, header + 8);
+    qToLittleEndian<quint64>(info.lastTimestamp, header + 16);
+    qToLittleEndian<quint32>(info.channelMask, header + 24);
+    qToLittleEndian<quint32>(info.numOfTriggers, header + 28);
+    qToLittleEndian<quint32>(Crc32::compute(payload, payloadSize), header + 32);
+    qToLittleEndian<quint32>(Crc32::compute(header, 36), header + 36);
+
+    _block.numOfSamples = 0;
+    _hasExactCounts = true;
+    _channelMask = 0;
+    _numOfBlockTriggers = 0;
+}
+
+void NedcWriter::finish ()
+{
+    _writeBlock();
+
+    qint64 indexOffset = numOfBytes();
+    int indexPosition = _output.size();
+    for (int i = 0; i < _index.size(); i++)
+    {
+        uchar entry[NEDC_INDEX_ENTRY_SIZE];
+        writeIndexEntry(_index[i], entry);
+        _output.append((const char*) entry, sizeof(entry));
+    }
+
+    std::sort(_triggers.begin(), _triggers.end());
+    for (int i = 0; i < _triggers.size(); i++)
+    {
+        uchar entry[NEDC_TRIGGER_ENTRY_SIZE];
+        qToLittleEndian<quint64>(_triggers[i].timestamp, entry);
+        qToLittleEndian<quint32>(_triggers[i].code, entry + 8);
+        qToLittleEndian<quint32>(_triggers[i].block, entry + 12);
+        _output.append((const char*) entry, sizeof(entry));
+    }
+
+    uchar trailer[NEDC_TRAILER_SIZE];
+    qToLittleEndian<quint64>(indexOffset, trailer);
+    qToLittleEndian<quint32>(_index.size(), trailer + 8);
+    qToLittleEndian<quint32>(_triggers.size(), trailer + 12);
+    qToLittleEndian<quint32>(Crc32::compute(_output.constData() + indexPosition, _output.size() - indexPosition), trailer + 16);
+    memcpy(trailer + 20, NEDC_INDEX_MAGIC, 4);
+    _output.append((const char*) trailer, sizeof(trailer));
+}
+
+NedcReader::NedcReader () :
+    _sampleRate(0),
+    _isRecovered(false)
+{
+}
+
+bool NedcReader::open (const QString &fileName)
+{
+    close();
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly))
+        return false;
+
+    uchar header[NEDC_FILE_HEADER_SIZE];
+    if (_file.read((char*) header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, NEDC_MAGIC, 4) != 0 ||
+        qFromLittleEndian<quint16>(header + 4) != NEDC_VERSION)
+    {
+        close();
+        return false;
+    }
+
+    int flags = qFromLittleEndian<quint16>(header + 10);
+    _layout = NedcLayout(qFromLittleEndian<quint16>(header + 6), flags & 1, flags & 2);
+    _sampleRate = qFromLittleEndian<quint32>(header + 12) / 1000.0;
+    if (_layout.numOfChannels > N_MAX_CHANNELS)
+    {
+        close();
+        return false;
+    }
+
+    if (!_readIndex())
+    {
+        _isRecovered = true;
+        _scanBlocks();
+    }
+    return true;
+}
+
+bool NedcReader::_readIndex ()
+{
+    qint64 fileSize = _file.size();
+    uchar trailer[NEDC_TRAILER_SIZE];
+    if (fileSize < NEDC_FILE_HEADER_SIZE + NEDC_TRAILER_SIZE ||
+        !_file.seek(fileSize - NEDC_TRAILER_SIZE) ||
+        _file.read((char*) trailer, sizeof(trailer)) != sizeof(trailer) ||
+        memcmp(trailer + 20, NEDC_INDEX_MAGIC, 4) != 0)
+        return false;
+
+    qint64 indexOffset = qFromLittleEndian<quint64>(trailer);
+    qint64 numOfBlocks = qFromLittleEndian<quint32>(trailer + 8);
+    qint64 numOfTriggers = qFromLittleEndian<quint32>(trailer + 12);
+    qint64 indexSize = numOfBlocks * NEDC_INDEX_ENTRY_SIZE + numOfTriggers * NEDC_TRIGGER_ENTRY_SIZE;
+    if (indexOffset < NEDC_FILE_HEADER_SIZE || indexOffset + indexSize + NEDC_TRAILER_SIZE != fileSize ||
+        !_file.seek(indexOffset))
+        return false;
+
+    QByteArray index = _file.read(indexSize);
+    if (index.size() != indexSize ||
+        Crc32::compute(index.constData(), index.size()) != qFromLittleEndian<quint32>(trailer + 16))
+        return false;
+
+    const uchar *entry = (const uchar*) index.constData();
+    _blocks.resize(numOfBlocks);
+    for (int i = 0; i < numOfBlocks; i++, entry += NEDC_INDEX_ENTRY_SIZE)
+        _blocks[i] = readIndexEntry(entry);
+
+    _triggers.resize(numOfTriggers);
+    for (int i = 0; i < numOfTriggers; i++, entry += NEDC_TRIGGER_ENTRY_SIZE)
+    {
+        _triggers[i] = NedcTriggerEntry(qFromLittleEndian<quint64>(entry),
+                                        qFromLittleEndian<quint32>(entry + 8),
+                                        qFromLittleEndian<quint32>(entry + 12));
+    }
+    return true;
+}
+
+void NedcReader::_scanBlocks ()
+{
+    _blocks.clear();
+    _triggers.clear();
+
+    NedcBlock *block = new NedcBlock();
+    qint64 offset = NEDC_FILE_HEADER_SIZE;
+    NedcBlockInfo info;
+    int units;
+
+    // Up to the first block that was not completely written
+    while (_readBlockData(offset, info, units))
+    {
+        block->numOfSamples = info.numOfSamples;
+        if (!NedcCodec::decode(_payload.constData(), _payload.size(), _layout.numOfColumns(), *block))
+            break;
+
+        const qint32 *triggers = block->columns[_layout.triggerColumn()];
+        const qint32 *differences = block->columns[_layout.timestampColumn()];
+        quint64 timestamp = info.firstTimestamp;
+        for (int i = 0; i < info.numOfSamples; i++)
+        {
+            timestamp += (qint64) differences[i];
+            if (triggers[i] != 0)
+                _triggers.append(NedcTriggerEntry(timestamp, triggers[i], _blocks.size()));
+        }
+
+        _blocks.append(info);
+        offset += NEDC_BLOCK_HEADER_SIZE + _payload.size();
+    }
+
+    delete block;
+    std::sort(_triggers.begin(), _triggers.end());
+}
+
+bool NedcReader::_readBlockData (qint64 offset, NedcBlockInfo &info, int &units)
+{
+    uchar header[NEDC_BLOCK_HEADER_SIZE];
+    if (!_file.seek(offset) ||
+        _file.read((char*) header, sizeof(header)) != sizeof(header) ||
+        Crc32::compute(header, 36) != qFromLittleEndian<quint32>(header + 36))
+        return false;
+
+    int payloadSize = qFromLittleEndian<quint32>(header);
+    info.offset = offset;
+    info.numOfSamples = qFromLittleEndian<quint16>(header + 4);
+    units = qFromLittleEndian<quint16>(header + 6);
+    info.firstTimestamp = qFromLittleEndian<quint64>(header + 8);
+    info.lastTimestamp = qFromLittleEndian<quint64>(header + 16);
+    info.channelMask = qFromLittleEndian<quint32>(header + 24);
+    info.numOfTriggers = qFromLittleEndian<quint32>(header + 28);
+    if (payloadSize < 0 || info.numOfSamples == 0 || info.numOfSamples > NEDC_BLOCK_SAMPLES ||
+        offset + NEDC_BLOCK_HEADER_SIZE + payloadSize > _file.size())
+        return false;
+
+    _payload.resize(payloadSize);
+    return _file.read(_payload.data(), payloadSize) == payloadSize &&
+           Crc32::compute(_payload.constData(), payloadSize) == qFromLittleEndian<quint32>(header + 32);
+}
+
+void NedcReader::close ()
+{
+    if (_file.isOpen())
+        _file.close();
+    _blocks.clear();
+    _triggers.clear();
+    _isRecovered = false;
+}
+
+int NedcReader::findBlock (quint64 timestamp) const
+{
+    if (_blocks.isEmpty())
+        return -1;
+
+    // The blocks are in timestamp order
+    int low = 0;
+    int high = _blocks.size();
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (_blocks[middle].firstTimestamp <= timestamp)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return (low > 0) ? low - 1 : 0;
+}
+
+int NedcReader::findTrigger (int code, quint64 fromTimestamp) const
+{
+    const NedcTriggerEntry *first = std::lower_bound(_triggers.constBegin(), _triggers.constEnd(),
+                                                     NedcTriggerEntry(fromTimestamp, code));
+    if (first == _triggers.constEnd() || first->code != code)
+        return -1;
+    return first - _triggers.constBegin();
+}
+
+bool NedcReader::readBlock (int index, NedcBlock &block)
+{
+    NedcBlockInfo info;
+    int units;
+    if (index < 0 || index >= _blocks.size() || !_readBlockData(_blocks[index].offset, info, units))
+        return false;
+
+    block.numOfSamples = info.numOfSamples;
+    block.units = units;
+    block.firstTimestamp = info.firstTimestamp;
+    if (!NedcCodec::decode(_payload.constData(), _payload.size(), _layout.numOfColumns(), block))
+        return false;
+
+    const qint32 *differences = block.columns[_layout.timestampColumn()];
+    quint64 timestamp = block.firstTimestamp;
+    for (int i = 0; i < block.numOfSamples; i++)
+    {
+        timestamp += (qint64) differences[i];
+        block.timestamps[i] = timestamp;
+    }
+
+    return true;
+}
+
+int NedcReader::nanoVolts (const NedcBlock &block, int channel, int sample)
+{
+    int value = block.columns[channel][sample];
+    return (block.units == NedcBlock::UNITS_COUNTS) ? countsToNanoVolts(value) : value;
+}
+
+int NedcReader::counts (const NedcBlock &block, int channel, int sample)
+{
+    int value = block.columns[channel][sample];
+    return (block.units == NedcBlock::UNITS_COUNTS) ? value : nanoVoltsToCounts(value);
+}
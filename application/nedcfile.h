@@ -0,0 +1,432 @@
+#ifndef NEDCFILE_H
+#define NEDCFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "channeldata.h"
+#include "nedccodec.h"
+
+#define NEDC_VERSION            (1)
+#define NEDC_FILE_HEADER_SIZE   (32)    // [bytes] Magic, version, layout and sample rate
+#define NEDC_BLOCK_HEADER_SIZE  (40)    // [bytes] Payload size, samples, units, timestamps, channel mask, triggers and checksums
+#define NEDC_INDEX_ENTRY_SIZE   (36)    // [bytes] Offset, timestamps, samples, channel mask and triggers of a block
+#define NEDC_TRIGGER_ENTRY_SIZE (16)    // [bytes] Timestamp, code and block of a trigger
+#define NEDC_TRAILER_SIZE       (24)    // [bytes] Index offset, number of blocks and triggers, checksum and magic
+
+/*!
+ * \class NedcLayout nedcfile.h
+ *
+ * \brief This class describes the columns stored in the blocks of a NEDC
+ * file.
+ */
+class NedcLayout
+{
+public:
+
+    NedcLayout (int numOfChannels = 0, bool hasAccelerometer = false, bool hasAdditional = false) :
+        numOfChannels(numOfChannels),
+        hasAccelerometer(hasAccelerometer),
+        hasAdditional(hasAdditional)
+    {
+    }
+
+    int channelInfoColumn () const { return numOfChannels; }
+    int accelerometerColumn () const { return numOfChannels + 1; }
+    int additionalColumn () const { return accelerometerColumn() + (hasAccelerometer ? 3 : 0); }
+    int triggerColumn () const { return additionalColumn() + (hasAdditional ? 1 : 0); }
+    int timestampColumn () const { return triggerColumn() + 1; }
+    int numOfColumns () const { return timestampColumn() + 1; }
+
+    int numOfChannels;
+    bool hasAccelerometer;
+    bool hasAdditional;
+};
+
+/*!
+ * \class NedcBlockInfo nedcfile.h
+ *
+ * \brief This class summarizes a block of a NEDC file, as stored in its
+ * header and in the block index.
+ */
+class NedcBlockInfo
+{
+public:
+
+    NedcBlockInfo () :
+        offset(0),
+        firstTimestamp(0),
+        lastTimestamp(0),
+        numOfSamples(0),
+        channelMask(0),
+        numOfTriggers(0)
+    {
+    }
+
+    qint64 offset;              // Position of the block header in the file
+    quint64 firstTimestamp;
+    quint64 lastTimestamp;
+    int numOfSamples;
+    quint32 channelMask;        // Channels with data in any of the samples
+    int numOfTriggers;          // Samples with a trigger code other than 0
+};
+
+/*!
+ * \class NedcTriggerEntry nedcfile.h
+ *
+ * \brief This class locates a trigger of a NEDC file.
+ */
+class NedcTriggerEntry
+{
+public:
+
+    NedcTriggerEntry (quint64 timestamp = 0, int code = 0, int block = 0) :
+        timestamp(timestamp),
+        code(code),
+        block(block)
+    {
+    }
+
+    bool operator< (const NedcTriggerEntry &other) const
+    {
+        return (code != other.code) ? (code < other.code) : (timestamp < other.timestamp);
+    }
+
+    quint64 timestamp;
+    int code;
+    int block;                  // Block holding the sample of the trigger
+};
+
+/*!
+ * \class NedcWriter nedcfile.h
+ *
+ * \brief This class builds a NEDC file, the losslessly compressed
+ * recording format. The samples are gathered in blocks of
+ * NEDC_BLOCK_SAMPLES, a fixed duration at the EEG sample rate, that are
+ * compressed independently with NedcCodec. Every block header carries the
+ * summary of the block and the checksums of the header and the payload, so
+ * a crash can only damage the last block.
+ *
+ * When the file is finished, the index of the blocks and the table of the
+ * triggers, sorted by code and timestamp, are appended, so a reader finds
+ * any time or trigger with a binary search.
+ *
+ * The EEG is stored as ADC counts whenever the nV values of a block can be
+ * obtained back from them exactly, so both EASY and NEDF files can be
+ * rebuilt without any difference; otherwise the block keeps the nV.
+ *
+ * The bytes are produced in memory; the owner takes them with output()
+ * and clearOutput() and writes them in order.
+ */
+class NedcWriter
+{
+public:
+
+    /*!
+     * Constructor
+     */
+    NedcWriter ();
+
+    /*!
+     * It starts a new file, its header is the first output
+     *
+     * \param layout Columns stored
+     *
+     * \param sampleRate EEG sample rate in Hz
+     */
+    void begin (const NedcLayout &layout, double sampleRate);
+
+    /*!
+     * It appends a sample
+     *
+     * \param eeg EEG sample, the channels not reported in its channel info
+     * are not stored
+     *
+     * \param accelerometer Accelerometer values, ignored if the layout has
+     * no accelerometer
+     *
+     * \param additional Additional channel value, ignored if the layout has
+     * no additional channel
+     *
+     * \param trigger Trigger code
+     */
+    void appendSample (ChannelData &eeg, const int *accelerometer, int additional, int trigger);
+
+    /*!
+     * It compresses the pending samples and appends the index of the
+     * blocks. No sample can be appended afterwards.
+     */
+    void finish ();
+
+    /*!
+     * It returns the bytes produced and not cleared yet
+     */
+    const QByteArray& output () const { return _output; }
+
+    /*!
+     * It empties the output, its bytes having been written
+     */
+    void clearOutput () { _outputOffset += _output.size(); _output.resize(0); }
+
+    /*!
+     * It returns the number of samples appended
+     */
+    qint64 numOfSamples () const { return _numOfSamples; }
+
+    /*!
+     * It returns the number of bytes produced, cleared or not
+     */
+    qint64 numOfBytes () const { return _outputOffset + _output.size(); }
+
+private:
+
+    /*!
+     * Entry of the block index
+     */
+    /*!
+     * It compresses the samples gathered and appends the block
+     */
+    void _writeBlock ();
+
+    /*!
+     * \property NedcWriter::_layout
+     *
+     * Columns stored
+     */
+    NedcLayout _layout;
+
+    /*!
+     * \property NedcWriter::_block
+     *
+     * Samples gathered for the next block. The EEG columns hold counts.
+     */
+    NedcBlock _block;
+
+    /*!
+     * \property NedcWriter::_nanoVolts
+     *
+     * EEG of the samples gathered in nV
+     */
+    qint32 _nanoVolts[N_MAX_CHANNELS][NEDC_BLOCK_SAMPLES];
+
+    /*!
+     * \property NedcWriter::_hasExactCounts
+     *
+     * Whether the counts of all the samples gathered give their nV back
+     */
+    bool _hasExactCounts;
+
+    /*!
+     * \property NedcWriter::_channelMask
+     *
+     * Channels with data in any of the samples gathered
+     */
+    quint32 _channelMask;
+
+    /*!
+     * \property NedcWriter::_previousTimestamp
+     *
+     * Timestamp of the last sample appended
+     */
+    quint64 _previousTimestamp;
+
+    /*!
+     * \property NedcWriter::_numOfSamples
+     *
+     * Number of samples appended
+     */
+    qint64 _numOfSamples;
+
+    /*!
+     * \property NedcWriter::_index
+     *
+     * Blocks written
+     */
+    QVector<NedcBlockInfo> _index;
+
+    /*!
+     * \property NedcWriter::_triggers
+     *
+     * Triggers of the blocks written and of the samples gathered
+     */
+    QVector<NedcTriggerEntry> _triggers;
+
+    /*!
+     * \property NedcWriter::_numOfBlockTriggers
+     *
+     * Triggers of the samples gathered
+     */
+    int _numOfBlockTriggers;
+
+    /*!
+     * \property NedcWriter::_output
+     *
+     * Bytes produced and not cleared yet
+     */
+    QByteArray _output;
+
+    /*!
+     * \property NedcWriter::_outputOffset
+     *
+     * Position in the file of the first byte of _output
+     */
+    qint64 _outputOffset;
+};
+
+/*!
+ * \class NedcReader nedcfile.h
+ *
+ * \brief This class reads the blocks of a NEDC file. The block index at the
+ * end of the file is used when present; the blocks of a file that was not
+ * finished are found by walking their headers, up to the first block whose
+ * checksums do not match.
+ *
+ * The blocks are found by timestamp and the triggers by code with binary
+ * searches, so a window of a long recording is read without going through
+ * the rest of the file.
+ */
+class NedcReader
+{
+public:
+
+    /*!
+     * Constructor
+     */
+    NedcReader ();
+
+    /*!
+     * It opens a file and reads its header and block index
+     *
+     * \return false if the file can not be read or it is not a NEDC file
+     */
+    bool open (const QString &fileName);
+
+    /*!
+     * It closes the file
+     */
+    void close ();
+
+    /*!
+     * It returns the columns stored
+     */
+    const NedcLayout& layout () const { return _layout; }
+
+    /*!
+     * It returns the EEG sample rate in Hz
+     */
+    double sampleRate () const { return _sampleRate; }
+
+    /*!
+     * It returns the number of blocks
+     */
+    int numOfBlocks () const { return _blocks.size(); }
+
+    /*!
+     * It returns the summary of a block
+     */
+    const NedcBlockInfo& blockInfo (int index) const { return _blocks[index]; }
+
+    /*!
+     * It returns whether the index was rebuilt from the blocks because the
+     * file was not finished
+     */
+    bool isRecovered () const { return _isRecovered; }
+
+    /*!
+     * It finds the block holding a timestamp
+     *
+     * \return Index of the last block starting at or before the timestamp,
+     * 0 if all the blocks start after it, -1 if there are no blocks
+     */
+    int findBlock (quint64 timestamp) const;
+
+    /*!
+     * It returns the number of triggers
+     */
+    int numOfTriggers () const { return _triggers.size(); }
+
+    /*!
+     * It returns a trigger. They are sorted by code and timestamp.
+     */
+    const NedcTriggerEntry& trigger (int index) const { return _triggers[index]; }
+
+    /*!
+     * It finds the first trigger with a code at or after a timestamp. The
+     * next occurrences of the code follow it in the table.
+     *
+     * \return Index of the trigger, -1 if there is none
+     */
+    int findTrigger (int code, quint64 fromTimestamp = 0) const;
+
+    /*!
+     * It reads and decompresses a block
+     *
+     * \param index Block to read
+     *
+     * \param block Destination, its timestamps are resolved too
+     *
+     * \return false if the block is corrupted
+     */
+    bool readBlock (int index, NedcBlock &block);
+
+    /*!
+     * It returns the nV of an EEG value of a block
+     */
+    static int nanoVolts (const NedcBlock &block, int channel, int sample);
+
+    /*!
+     * It returns the ADC counts of an EEG value of a block
+     */
+    static int counts (const NedcBlock &block, int channel, int sample);
+
+private:
+
+    /*!
+     * It reads the block index and the trigger table of a finished file
+     */
+    bool _readIndex ();
+
+    /*!
+     * It finds the blocks by walking their headers, and rebuilds the
+     * trigger table from their samples
+     */
+    void _scanBlocks ();
+
+    /*!
+     * It reads the header and the payload of a block
+     *
+     * \return false if they can not be read or their checksums do not match
+     */
+    bool _readBlockData (qint64 offset, NedcBlockInfo &info, int &units);
+
+    QFile _file;
+    NedcLayout _layout;
+    double _sampleRate;
+
+    /*!
+     * \property NedcReader::_blocks
+     *
+     * Summary of every block, in file order
+     */
+    QVector<NedcBlockInfo> _blocks;
+
+    /*!
+     * \property NedcReader::_triggers
+     *
+     * Triggers sorted by code and timestamp
+     */
+    QVector<NedcTriggerEntry> _triggers;
+
+    bool _isRecovered;
+
+    /*!
+     * \property NedcReader::_payload
+     *
+     * Compressed bytes of the last block read
+     */
+    QByteArray _payload;
+};
+
+#endif // NEDCFILE_H
@@ -0,0 +1,141 @@
+#include "nedfencoder.h"
+
+#include <QtEndian>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define NEDFENCODER_USE_SSSE3
+#endif
+
+NedfEncoder::NedfEncoder () :
+    _size(0)
+{
+}
+
+void NedfEncoder::begin (int numOfSamples, int numOfChannels, bool isStimulating)
+{
+    // Accelerometer, EEG, two stimulation samples and trigger of every sample
+    int valuesPerSample = NEDF_ACCELEROMETER_AXES + numOfChannels;
+    if (isStimulating)
+        valuesPerSample += 2 * numOfChannels;
+
+    _size = 0;
+    _reserve(numOfSamples * (valuesPerSample * NEDF_SAMPLE_BYTES + 1));
+}
+
+void NedfEncoder::_reserve (int numOfBytes)
+{
+    int required = _size + numOfBytes + NEDF_PACK_SLACK;
+    if (required <= _buffer.size())
+        return;
+
+    int capacity = 2 * _buffer.size();
+    _buffer.resize((capacity > required) ? capacity : required);
+}
+
+void NedfEncoder::pack24 (const int *values, int numOfValues, char *out)
+{
+    int i = 0;
+
+#ifdef NEDFENCODER_USE_SSSE3
+    // Four values per shuffle: bytes 2, 1 and 0 of every 32-bit lane, the
+    // last four bytes are zeroed and overwritten by the next group
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    for (; i + 4 <= numOfValues; i += 4)
+    {
+        __m128i group = _mm_loadu_si128((const __m128i*) (values + i));
+        _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(group, order));
+        out += 4 * NEDF_SAMPLE_BYTES;
+    }
+#endif
+
+    // A 32-bit big-endian store whose last byte is overwritten by the next
+    // value
+    for (; i < numOfValues; i++)
+    {
+        qToBigEndian<quint32>((quint32) values[i] << 8, (uchar*) out);
+        out += NEDF_SAMPLE_BYTES;
+    }
+}
+
+void NedfEncoder::appendValues (const int *values, int numOfValues)
+{
+    _reserve(numOfValues * NEDF_SAMPLE_BYTES);
+    pack24(values, numOfValues, _buffer.data() + _size);
+    _size += numOfValues * NEDF_SAMPLE_BYTES;
+}
+
+void NedfEncoder::appendMissing (int numOfValues)
+{
+    _reserve(numOfValues * NEDF_SAMPLE_BYTES);
+    memset(_buffer.data() + _size, 0xff, numOfValues * NEDF_SAMPLE_BYTES);
+    _size += numOfValues * NEDF_SAMPLE_BYTES;
+}
+
+void NedfEncoder::appendEEG (ChannelData &data, int numOfChannels)
+{
+    if (numOfChannels > N_MAX_CHANNELS)
+        numOfChannels = N_MAX_CHANNELS;
+
+    int values[N_MAX_CHANNELS];
+    unsigned int channelInfo = data.channelInfo();
+    if (data.hasRawData())
+    {
+        // The counts sent by the device, without any floating point
+        const int *counts = data.rawData();
+        for (int j = 0; j < numOfChannels; j++)
+            values[j] = (channelInfo & (1 << j)) ? counts[j] : -1;
+    }
+    else
+    {
+        const int *nanoVolts = data.data();
+        for (int j = 0; j < numOfChannels; j++)
+        {
+            if (channelInfo & (1 << j))
+                values[j] = round(nanoVolts[j] /2.4/1000000000* 6.0 * 8388607.0);
+            else
+                values[j] = -1;
+        }
+    }
+
+    appendValues(values, numOfChannels);
+}
+
+void NedfEncoder::appendStim (ChannelData &data, int numOfChannels)
+{
+    if (numOfChannels > N_MAX_CHANNELS)
+        numOfChannels = N_MAX_CHANNELS;
+
+    int values[N_MAX_CHANNELS];
+    const int *raw = data.data();
+    unsigned int channelInfo = data.channelInfo();
+    for (int j = 0; j < numOfChannels; j++)
+    {
+        if (channelInfo & (1 << j))
+        {
+            int value = raw[j];
+            if (value > 32768)
+                value -= 65536;
+            values[j] = value * 2000 / 32768;
+        }
+        else
+        {
+            values[j] = -1;
+        }
+    }
+
+    appendValues(values, numOfChannels);
+}
+
+void NedfEncoder::appendAccelerometer (const int *values)
+{
+    appendValues(values, NEDF_ACCELEROMETER_AXES);
+}
+
+void NedfEncoder::appendTrigger (int code)
+{
+    _reserve(1);
+    _buffer.data()[_size++] = (char) (code & 0xff);
+}
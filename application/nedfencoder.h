@@ -0,0 +1,139 @@
+#ifndef NEDFENCODER_H
+#define NEDFENCODER_H
+
+#include <QByteArray>
+
+#include "channeldata.h"
+#include "commonparameters.h"
+
+#define NEDF_HEADER_SIZE        (5120)  // [bytes] Reserved at the beginning of the file
+#define NEDF_SAMPLE_BYTES       (3)     // Bytes of a 24-bit value
+#define NEDF_ACCELEROMETER_AXES (3)     // Values of an accelerometer record
+#define NEDF_PACK_SLACK         (16)    // [bytes] Written past the end by the packing
+
+/*!
+ * \class NedfEncoder nedfencoder.h
+ *
+ * \brief This class builds the binary data of a NEDF file for a whole flush
+ * window in memory, so that it reaches the file writer all at once. The
+ * values are stored as 24-bit big-endian integers, packed in groups with
+ * SSSE3 byte shuffles when the code is compiled with them enabled; the
+ * channels missing from a sample are written as -1. The buffer keeps its
+ * capacity between windows, so no allocation happens once it has grown to
+ * the size of a window.
+ */
+class NedfEncoder
+{
+public:
+
+    /*!
+     * Constructor
+     */
+    NedfEncoder ();
+
+    /*!
+     * It empties the buffer and reserves room for a window
+     *
+     * \param numOfSamples Number of EEG samples of the window
+     *
+     * \param numOfChannels Number of channels
+     *
+     * \param isStimulating Whether every sample carries two stimulation
+     * samples too
+     */
+    void begin (int numOfSamples, int numOfChannels, bool isStimulating);
+
+    /*!
+     * It appends values as 24-bit big-endian integers
+     *
+     * \param values Values to append, only their 24 least significant bits
+     * are kept
+     *
+     * \param numOfValues Number of values
+     */
+    void appendValues (const int *values, int numOfValues);
+
+    /*!
+     * It appends the value -1 several times, as written for the channels
+     * without data
+     */
+    void appendMissing (int numOfValues);
+
+    /*!
+     * It appends an EEG sample as ADC counts: the ones sent by the device if
+     * the sample carries them, otherwise converted from nV
+     *
+     * \param data EEG sample
+     *
+     * \param numOfChannels Number of channels, the channels not reported in
+     * the channel info of the sample are written as -1
+     */
+    void appendEEG (ChannelData &data, int numOfChannels);
+
+    /*!
+     * It appends a stimulation sample converted to uA
+     *
+     * \param data Stimulation sample
+     *
+     * \param numOfChannels Number of channels, the channels not reported in
+     * the channel info of the sample are written as -1
+     */
+    void appendStim (ChannelData &data, int numOfChannels);
+
+    /*!
+     * It appends an accelerometer record
+     *
+     * \param values The NEDF_ACCELEROMETER_AXES values of the record
+     */
+    void appendAccelerometer (const int *values);
+
+    /*!
+     * It appends a trigger byte
+     */
+    void appendTrigger (int code);
+
+    /*!
+     * It returns the number of bytes encoded
+     */
+    int size () const { return _size; }
+
+    /*!
+     * It returns the bytes encoded
+     */
+    const char* data () const { return _buffer.constData(); }
+
+    /*!
+     * It packs values as 24-bit big-endian integers
+     *
+     * \param values Values to pack
+     *
+     * \param numOfValues Number of values
+     *
+     * \param out Destination of NEDF_SAMPLE_BYTES * numOfValues bytes; up to
+     * NEDF_PACK_SLACK bytes past them are overwritten
+     */
+    static void pack24 (const int *values, int numOfValues, char *out);
+
+private:
+
+    /*!
+     * It makes sure there is room for a number of bytes more
+     */
+    void _reserve (int numOfBytes);
+
+    /*!
+     * \property NedfEncoder::_buffer
+     *
+     * Encoded bytes, followed by NEDF_PACK_SLACK spare bytes
+     */
+    QByteArray _buffer;
+
+    /*!
+     * \property NedfEncoder::_size
+     *
+     * Number of bytes encoded in _buffer
+     */
+    int _size;
+};
+
+#endif // NEDFENCODER_H
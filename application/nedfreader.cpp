@@ -0,0 +1,99 @@
+#include "nedfreader.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define NEDFREADER_USE_SSSE3
+#endif
+
+NedfReader::NedfReader () :
+    _data(0),
+    _recordSize(0),
+    _groupSize(0),
+    _samplesPerGroup(1),
+    _accelerometerSize(0),
+    _numOfSamples(0)
+{
+}
+
+NedfReader::~NedfReader ()
+{
+    close();
+}
+
+bool NedfReader::open (const QString &fileName, const NedfLayout &layout)
+{
+    close();
+    if (layout.numOfChannels <= 0 || layout.numOfChannels > N_MAX_CHANNELS)
+        return false;
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 fileSize = _file.size();
+    if (fileSize < NEDF_HEADER_SIZE || (_data = _file.map(0, fileSize)) == 0)
+    {
+        close();
+        return false;
+    }
+
+    _layout = layout;
+    _recordSize = _layout.numOfChannels * NEDF_SAMPLE_BYTES * (_layout.isStimulating ? 3 : 1) + 1;
+    _samplesPerGroup = _layout.hasAccelerometer ? NEDF_ACCELEROMETER_PERIOD : 1;
+    _accelerometerSize = _layout.hasAccelerometer ? NEDF_ACCELEROMETER_AXES * NEDF_SAMPLE_BYTES : 0;
+    _groupSize = _accelerometerSize + _samplesPerGroup * _recordSize;
+
+    // Complete groups, then the complete samples of the last one
+    qint64 dataSize = fileSize - NEDF_HEADER_SIZE;
+    qint64 remaining = dataSize % _groupSize - _accelerometerSize;
+    _numOfSamples = (dataSize / _groupSize) * _samplesPerGroup + ((remaining > 0) ? remaining / _recordSize : 0);
+    return true;
+}
+
+void NedfReader::close ()
+{
+    if (_data != 0)
+        _file.unmap((uchar*) _data);
+    _data = 0;
+    if (_file.isOpen())
+        _file.close();
+    _numOfSamples = 0;
+}
+
+void NedfReader::readChannel (int channel, qint64 firstSample, int numOfSamples, qint32 *out) const
+{
+    const int offset = channel * NEDF_SAMPLE_BYTES;
+    for (int i = 0; i < numOfSamples; i++)
+        out[i] = unpack24(_record(firstSample + i) + offset);
+}
+
+void NedfReader::unpack24 (const uchar *in, int numOfValues, qint32 *out)
+{
+    int i = 0;
+
+#ifdef NEDFREADER_USE_SSSE3
+    // Four values per shuffle: their three bytes in the top of every 32-bit
+    // lane, then an arithmetic shift extends the sign. The 16 bytes loaded
+    // must lie within the input, hence the two spare values.
+    const __m128i order = _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+    for (; i + 6 <= numOfValues; i += 4)
+    {
+        __m128i group = _mm_loadu_si128((const __m128i*) in);
+        _mm_storeu_si128((__m128i*) (out + i), _mm_srai_epi32(_mm_shuffle_epi8(group, order), 8));
+        in += 4 * NEDF_SAMPLE_BYTES;
+    }
+#endif
+
+    for (; i < numOfValues; i++)
+    {
+        out[i] = unpack24(in);
+        in += NEDF_SAMPLE_BYTES;
+    }
+}
+
+void NedfReader::unpack24 (const uchar *in, int numOfValues, float *out, float scale)
+{
+    // A straight loop the compiler vectorizes
+    for (int i = 0; i < numOfValues; i++)
+        out[i] = unpack24(in + i * NEDF_SAMPLE_BYTES) * scale;
+}
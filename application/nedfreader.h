@@ -0,0 +1,247 @@
+#ifndef NEDFREADER_H
+#define NEDFREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+
+#include "nedfencoder.h"
+
+#define NEDF_ACCELEROMETER_PERIOD   (5)     // EEG samples per accelerometer record
+
+/*!
+ * \class NedfLayout nedfreader.h
+ *
+ * \brief This class describes the records of a NEDF file. The file does not
+ * carry it, it is the configuration the file writer had.
+ */
+class NedfLayout
+{
+public:
+
+    NedfLayout (int numOfChannels = 0, bool hasAccelerometer = false, bool isStimulating = false) :
+        numOfChannels(numOfChannels),
+        hasAccelerometer(hasAccelerometer),
+        isStimulating(isStimulating)
+    {
+    }
+
+    int numOfChannels;
+    bool hasAccelerometer;      // A record before every NEDF_ACCELEROMETER_PERIOD samples
+    bool isStimulating;         // Two stimulation samples after the EEG of every sample
+};
+
+/*!
+ * \class NedfReader nedfreader.h
+ *
+ * \brief This class reads a NEDF file mapped in memory. The samples are
+ * accessed in place by index, there is no parsing pass and nothing is
+ * copied until the values are unpacked.
+ *
+ * The file must have the same layout from start to end: the accelerometer
+ * record of the first of every NEDF_ACCELEROMETER_PERIOD samples, and the
+ * stimulation samples either in all the samples or in none. A trailing
+ * sample written partially is ignored.
+ */
+class NedfReader
+{
+public:
+
+    /*!
+     * \class NedfReader::ChannelIterator nedfreader.h
+     *
+     * \brief This class walks the values of an EEG channel sample by sample.
+     */
+    class ChannelIterator
+    {
+    public:
+
+        ChannelIterator (const NedfReader *reader, int channel, qint64 sample) :
+            _reader(reader), _channel(channel), _sample(sample) {}
+
+        qint32 operator* () const { return unpack24(_reader->eeg(_sample) + _channel * NEDF_SAMPLE_BYTES); }
+        ChannelIterator& operator++ () { _sample++; return *this; }
+        bool operator!= (const ChannelIterator &other) const { return _sample != other._sample; }
+        bool operator== (const ChannelIterator &other) const { return _sample == other._sample; }
+        qint64 sample () const { return _sample; }
+
+    private:
+        const NedfReader *_reader;
+        int _channel;
+        qint64 _sample;
+    };
+
+    /*!
+     * \class NedfReader::SampleIterator nedfreader.h
+     *
+     * \brief This class walks the samples; it gives their index, to be
+     * passed to the accessors of the reader.
+     */
+    class SampleIterator
+    {
+    public:
+
+        SampleIterator (qint64 sample) : _sample(sample) {}
+
+        qint64 operator* () const { return _sample; }
+        SampleIterator& operator++ () { _sample++; return *this; }
+        bool operator!= (const SampleIterator &other) const { return _sample != other._sample; }
+        bool operator== (const SampleIterator &other) const { return _sample == other._sample; }
+
+    private:
+        qint64 _sample;
+    };
+
+    /*!
+     * Constructor
+     */
+    NedfReader ();
+
+    /*!
+     * Default destructor. It unmaps the file.
+     */
+    virtual ~NedfReader ();
+
+    /*!
+     * It maps a file
+     *
+     * \param layout Records of the file
+     *
+     * \return false if the file can not be mapped or it is shorter than the
+     * header
+     */
+    bool open (const QString &fileName, const NedfLayout &layout);
+
+    /*!
+     * It unmaps the file
+     */
+    void close ();
+
+    const NedfLayout& layout () const { return _layout; }
+
+    /*!
+     * It returns the number of complete samples
+     */
+    qint64 numOfSamples () const { return _numOfSamples; }
+
+    /*!
+     * It returns the 24-bit EEG values of a sample, one per channel
+     */
+    const uchar* eeg (qint64 sample) const { return _record(sample); }
+
+    /*!
+     * It returns the 24-bit values of a stimulation sample, one per channel
+     *
+     * \param index First or second stimulation sample of the EEG sample
+     */
+    const uchar* stim (qint64 sample, int index) const
+    {
+        return _record(sample) + (1 + index) * _layout.numOfChannels * NEDF_SAMPLE_BYTES;
+    }
+
+    /*!
+     * It returns the 24-bit values of the accelerometer record in force at
+     * a sample: the one written with the first sample of its period
+     */
+    const uchar* accelerometer (qint64 sample) const
+    {
+        return _record(sample - sample % NEDF_ACCELEROMETER_PERIOD) - NEDF_ACCELEROMETER_AXES * NEDF_SAMPLE_BYTES;
+    }
+
+    /*!
+     * It returns the trigger code of a sample
+     */
+    int trigger (qint64 sample) const { return _record(sample)[_recordSize - 1]; }
+
+    /*!
+     * It unpacks the EEG of a sample
+     *
+     * \param out Destination of one value per channel
+     */
+    void readEEG (qint64 sample, qint32 *out) const { unpack24(eeg(sample), _layout.numOfChannels, out); }
+
+    /*!
+     * It unpacks the values of an EEG channel for consecutive samples
+     *
+     * \param out Destination of numOfSamples values
+     */
+    void readChannel (int channel, qint64 firstSample, int numOfSamples, qint32 *out) const;
+
+    ChannelIterator channelBegin (int channel) const { return ChannelIterator(this, channel, 0); }
+    ChannelIterator channelEnd (int channel) const { return ChannelIterator(this, channel, _numOfSamples); }
+
+    SampleIterator begin () const { return SampleIterator(0); }
+    SampleIterator end () const { return SampleIterator(_numOfSamples); }
+
+    /*!
+     * It unpacks a 24-bit big-endian value
+     */
+    static qint32 unpack24 (const uchar *in)
+    {
+        return ((qint32) (((quint32) in[0] << 24) | ((quint32) in[1] << 16) | ((quint32) in[2] << 8))) >> 8;
+    }
+
+    /*!
+     * It unpacks 24-bit big-endian values, the reverse of
+     * NedfEncoder::pack24
+     *
+     * \param in NEDF_SAMPLE_BYTES * numOfValues bytes, nothing past them is
+     * read
+     *
+     * \param numOfValues Number of values
+     *
+     * \param out Destination of the values
+     */
+    static void unpack24 (const uchar *in, int numOfValues, qint32 *out);
+
+    /*!
+     * It unpacks 24-bit big-endian values and scales them, e.g. to convert
+     * ADC counts to physical units
+     *
+     * \param scale Factor applied to every value
+     */
+    static void unpack24 (const uchar *in, int numOfValues, float *out, float scale);
+
+private:
+
+    /*!
+     * It returns the EEG of a sample, the beginning of its record after the
+     * accelerometer
+     */
+    const uchar* _record (qint64 sample) const
+    {
+        return _data + NEDF_HEADER_SIZE + (sample / _samplesPerGroup) * _groupSize +
+               _accelerometerSize + (sample % _samplesPerGroup) * _recordSize;
+    }
+
+    QFile _file;
+    NedfLayout _layout;
+
+    /*!
+     * \property NedfReader::_data
+     *
+     * Mapped file
+     */
+    const uchar *_data;
+
+    /*!
+     * \property NedfReader::_recordSize
+     *
+     * Bytes of a sample: EEG, stimulation and trigger
+     */
+    qint64 _recordSize;
+
+    /*!
+     * \property NedfReader::_groupSize
+     *
+     * Bytes of the samples sharing an accelerometer record, the record
+     * included
+     */
+    qint64 _groupSize;
+
+    int _samplesPerGroup;
+    int _accelerometerSize;
+    qint64 _numOfSamples;
+};
+
+#endif // NEDFREADER_H
@@ -249,6 +249,11 @@ public:
     QString  displayReference;
     QString  displayLink;
 
+    // Whole session in seconds: pre EEG, stimulation with its ramps and post EEG
+    int sessionDuration() const{
+        return preEEG + rampUpDuration + stimulationDuration + rampDownDuration + postEEG;
+    }
+
     QString toString() const{
         QString str = "protocolId: "     + QString::number(protocolId) + " \n" +
                       "name: "           + name + "\n" +
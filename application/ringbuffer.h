@@ -0,0 +1,141 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QVector>
+
+/*!
+ * \class RingBuffer ringbuffer.h
+ *
+ * \brief This class is a FIFO queue stored in a circular array allocated
+ * beforehand. The elements are kept by value next to each other and are
+ * overwritten when the slot is reused, so queueing and consuming do not
+ * allocate. A queue that becomes full doubles its capacity, which only
+ * happens until it has grown to the largest backlog seen.
+ *
+ * The index operator counts from the oldest element.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param capacity Number of elements allocated, rounded up to a power of
+     * two
+     */
+    RingBuffer (int capacity = 64) :
+        _head(0),
+        _size(0)
+    {
+        int rounded = 1;
+        while (rounded < capacity)
+            rounded *= 2;
+        _items.resize(rounded);
+    }
+
+    /*!
+     * It returns the number of elements queued
+     */
+    int size () const { return _size; }
+
+    /*!
+     * It returns whether the queue is empty
+     */
+    bool isEmpty () const { return _size == 0; }
+
+    /*!
+     * It returns the number of elements that fit without growing
+     */
+    int capacity () const { return _items.size(); }
+
+    /*!
+     * It removes all the elements, keeping the capacity
+     */
+    void clear ()
+    {
+        _head = 0;
+        _size = 0;
+    }
+
+    /*!
+     * It queues a copy of an element
+     */
+    void push_back (const T &value)
+    {
+        if (_size == _items.size())
+            _grow();
+        _items[(_head + _size) & (_items.size() - 1)] = value;
+        _size++;
+    }
+
+    /*!
+     * It removes the oldest element
+     */
+    void pop_front ()
+    {
+        _head = (_head + 1) & (_items.size() - 1);
+        _size--;
+    }
+
+    /*!
+     * It removes the oldest elements at once
+     *
+     * \param count Number of elements to remove, at most size()
+     */
+    void pop_front (int count)
+    {
+        _head = (_head + count) & (_items.size() - 1);
+        _size -= count;
+    }
+
+    /*!
+     * It returns the oldest element
+     */
+    T& first () { return _items[_head]; }
+
+    /*!
+     * It returns an element
+     *
+     * \param index Position from the oldest element
+     */
+    T& operator[] (int index) { return _items[(_head + index) & (_items.size() - 1)]; }
+
+private:
+
+    /*!
+     * It doubles the capacity, moving the elements to the start
+     */
+    void _grow ()
+    {
+        QVector<T> items(2 * _items.size());
+        for (int i = 0; i < _size; i++)
+            items[i] = (*this)[i];
+        _items.swap(items);
+        _head = 0;
+    }
+
+    /*!
+     * \property RingBuffer::_items
+     *
+     * Slots of the queue, their number is a power of two
+     */
+    QVector<T> _items;
+
+    /*!
+     * \property RingBuffer::_head
+     *
+     * Slot of the oldest element
+     */
+    int _head;
+
+    /*!
+     * \property RingBuffer::_size
+     *
+     * Number of elements queued
+     */
+    int _size;
+};
+
+#endif // RINGBUFFER_H
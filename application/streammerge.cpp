@@ -0,0 +1,19 @@
+#include "streammerge.h"
+
+void StreamMerge::align (RingBuffer<ChannelData> &eeg, int numOfSamples,
+                         StreamCursor<ChannelData> *accelerometer,
+                         StreamCursor<ChannelData> *additional,
+                         StreamCursor<Trigger> *triggers)
+{
+    if (_samples.size() < numOfSamples)
+        _samples.resize(numOfSamples);
+
+    for (int i = 0; i < numOfSamples; i++)
+    {
+        qint64 timestamp = eeg[i].timestamp();
+        Sample &sample = _samples[i];
+        sample.accelerometer = accelerometer ? accelerometer->takeUntil(timestamp) : 0;
+        sample.additional = additional ? additional->takeUntil(timestamp) : 0;
+        sample.trigger = triggers ? triggers->takeUntil(timestamp) : 0;
+    }
+}
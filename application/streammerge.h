@@ -0,0 +1,183 @@
+#ifndef STREAMMERGE_H
+#define STREAMMERGE_H
+
+#include <QVector>
+
+#include "channeldata.h"
+#include "trigger.h"
+#include "ringbuffer.h"
+
+/*!
+ * It returns the timestamp of an element of a stream
+ */
+inline qint64 streamTimestamp (ChannelData &data) { return data.timestamp(); }
+inline qint64 streamTimestamp (Trigger &trigger) { return trigger.getTimestamp(); }
+
+/*!
+ * \class StreamCursor streammerge.h
+ *
+ * \brief This class walks a queued stream in timestamp order while the
+ * samples of a window are written. The elements taken are only passed
+ * over; commit() removes all of them from the queue at once, so the
+ * pointers returned stay valid until then. The queue can not be modified
+ * while the cursor is in use.
+ */
+template <typename T>
+class StreamCursor
+{
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param stream Queue walked, from its oldest element
+     */
+    StreamCursor (RingBuffer<T> &stream) :
+        _stream(stream),
+        _position(0)
+    {
+    }
+
+    /*!
+     * It returns whether all the elements have been passed
+     */
+    bool isEmpty () const { return _position >= _stream.size(); }
+
+    /*!
+     * It takes the next element if it is not later than a timestamp
+     *
+     * \return The element, NULL if there is none
+     */
+    T* takeUntil (qint64 timestamp)
+    {
+        if (isEmpty() || streamTimestamp(_stream[_position]) > timestamp)
+            return 0;
+        return &_stream[_position++];
+    }
+
+    /*!
+     * It takes all the next elements within a range of timestamps
+     *
+     * \return The first of them, NULL if the next element is out of the
+     * range
+     */
+    T* takeRange (qint64 low, qint64 high)
+    {
+        T *first = 0;
+        while (!isEmpty())
+        {
+            qint64 timestamp = streamTimestamp(_stream[_position]);
+            if (timestamp < low || timestamp > high)
+                break;
+            if (first == 0)
+                first = &_stream[_position];
+            _position++;
+        }
+        return first;
+    }
+
+    /*!
+     * It takes all the next elements up to a timestamp
+     *
+     * \return The first of them not earlier than low, NULL if there is none
+     */
+    T* takeThrough (qint64 low, qint64 high)
+    {
+        T *first = 0;
+        while (!isEmpty())
+        {
+            qint64 timestamp = streamTimestamp(_stream[_position]);
+            if (timestamp > high)
+                break;
+            if (first == 0 && timestamp >= low)
+                first = &_stream[_position];
+            _position++;
+        }
+        return first;
+    }
+
+    /*!
+     * It removes from the queue the elements passed
+     */
+    void commit ()
+    {
+        _stream.pop_front(_position);
+        _position = 0;
+    }
+
+private:
+
+    /*!
+     * \property StreamCursor::_stream
+     *
+     * Queue walked
+     */
+    RingBuffer<T> &_stream;
+
+    /*!
+     * \property StreamCursor::_position
+     *
+     * Index of the next element in the queue
+     */
+    int _position;
+};
+
+/*!
+ * \class StreamMerge streammerge.h
+ *
+ * \brief This class aligns the side streams of a recording with a window
+ * of EEG samples in a single merge pass. Every EEG sample is given at most
+ * one element of each side stream: the oldest one not given yet whose
+ * timestamp is not later than the one of the sample. The streams must be
+ * in timestamp order; their cursors are left after the elements given.
+ */
+class StreamMerge
+{
+public:
+
+    /*!
+     * Side stream elements aligned with an EEG sample, NULL where there is
+     * none
+     */
+    struct Sample
+    {
+        ChannelData *accelerometer;
+        ChannelData *additional;
+        Trigger *trigger;
+    };
+
+    /*!
+     * It aligns the side streams with the oldest samples of the EEG queue
+     *
+     * \param eeg EEG queue
+     *
+     * \param numOfSamples Number of EEG samples of the window
+     *
+     * \param accelerometer Accelerometer stream, NULL if it is not aligned
+     *
+     * \param additional Additional channel stream, NULL if it is not aligned
+     *
+     * \param triggers Trigger stream, NULL if it is not aligned
+     */
+    void align (RingBuffer<ChannelData> &eeg, int numOfSamples,
+                StreamCursor<ChannelData> *accelerometer,
+                StreamCursor<ChannelData> *additional,
+                StreamCursor<Trigger> *triggers);
+
+    /*!
+     * It returns the elements aligned with a sample of the window
+     */
+    const Sample& operator[] (int index) const { return _samples[index]; }
+
+private:
+
+    /*!
+     * \property StreamMerge::_samples
+     *
+     * Elements aligned with every sample of the window, it keeps its
+     * capacity between windows
+     */
+    QVector<Sample> _samples;
+};
+
+#endif // STREAMMERGE_H
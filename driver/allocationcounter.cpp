@@ -0,0 +1,74 @@
+#include "allocationcounter.h"
+
+#include <stdlib.h>
+#include <new>
+
+QAtomicInt AllocationCounter::_counter(0);
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+
+// Plain thread-local flag, so that checking it never allocates
+static thread_local bool isThreadCounted = false;
+
+void AllocationCounter::setCurrentThreadCounted (bool counted)
+{
+    isThreadCounted = counted;
+}
+
+void AllocationCounter::increment ()
+{
+    if (isThreadCounted)
+        _counter.fetchAndAddRelaxed(1);
+}
+
+// Replacements of the global allocation functions so that the number of
+// heap allocations performed while streaming can be checked
+void* operator new (size_t size)
+{
+    AllocationCounter::increment();
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == 0)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[] (size_t size)
+{
+    AllocationCounter::increment();
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == 0)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete (void* pointer) throw()
+{
+    free(pointer);
+}
+
+void operator delete[] (void* pointer) throw()
+{
+    free(pointer);
+}
+
+bool AllocationCounter::isAvailable ()
+{
+    return true;
+}
+
+#else
+
+void AllocationCounter::setCurrentThreadCounted (bool)
+{
+}
+
+void AllocationCounter::increment ()
+{
+}
+
+bool AllocationCounter::isAvailable ()
+{
+    return false;
+}
+
+#endif
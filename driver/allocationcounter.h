@@ -0,0 +1,59 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QAtomicInt>
+
+/*!
+ * \class AllocationCounter allocationcounter.h
+ *
+ * \brief Diagnostic counting the calls to the global operator new made by
+ * the threads that asked for it, e.g. the poll thread, so the figure is not
+ * mixed with the allocations of the GUI or the writers. The counting
+ * operators are only compiled when COUNT_HEAP_ALLOCATIONS is defined,
+ * otherwise count() always returns 0.
+ *
+ * It reports a figure, it does not enforce a budget: every sample crossing
+ * threads through a queued signal still allocates the event carrying it.
+ */
+class AllocationCounter
+{
+public:
+
+    /*!
+     * It returns the number of heap allocations of the counted threads since
+     * the last reset()
+     */
+    static int count () { return _counter.load(); }
+
+    /*!
+     * It sets the allocation counter back to zero
+     */
+    static void reset () { _counter.store(0); }
+
+    /*!
+     * It returns whether the counting operators are compiled in
+     */
+    static bool isAvailable ();
+
+    /*!
+     * It sets whether the allocations of the calling thread are counted,
+     * false by default
+     */
+    static void setCurrentThreadCounted (bool counted);
+
+    /*!
+     * It is called by the counting operator new
+     */
+    static void increment ();
+
+private:
+
+    /*!
+     * \property AllocationCounter::_counter
+     *
+     * Number of allocations since the last reset
+     */
+    static QAtomicInt _counter;
+};
+
+#endif // ALLOCATIONCOUNTER_H
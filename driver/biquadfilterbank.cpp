@@ -0,0 +1,214 @@
+#include "biquadfilterbank.h"
+
+#include <QMutexLocker>
+#include <math.h>
+#include <string.h>
+
+BiquadCoefficients BiquadCoefficients::notch (double frequency, double q, double sampleRate)
+{
+    double w0 = 2.0 * PI * frequency / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    BiquadCoefficients c;
+    c.b0 = 1.0 / a0;
+    c.b1 = -2.0 * cos(w0) / a0;
+    c.b2 = 1.0 / a0;
+    c.a1 = -2.0 * cos(w0) / a0;
+    c.a2 = (1.0 - alpha) / a0;
+    return c;
+}
+
+BiquadCoefficients BiquadCoefficients::highPass (double frequency, double q, double sampleRate)
+{
+    double w0 = 2.0 * PI * frequency / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    BiquadCoefficients c;
+    c.b0 = (1.0 + cos(w0)) / 2.0 / a0;
+    c.b1 = -(1.0 + cos(w0)) / a0;
+    c.b2 = (1.0 + cos(w0)) / 2.0 / a0;
+    c.a1 = -2.0 * cos(w0) / a0;
+    c.a2 = (1.0 - alpha) / a0;
+    return c;
+}
+
+BiquadCoefficients BiquadCoefficients::lowPass (double frequency, double q, double sampleRate)
+{
+    double w0 = 2.0 * PI * frequency / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    BiquadCoefficients c;
+    c.b0 = (1.0 - cos(w0)) / 2.0 / a0;
+    c.b1 = (1.0 - cos(w0)) / a0;
+    c.b2 = (1.0 - cos(w0)) / 2.0 / a0;
+    c.a1 = -2.0 * cos(w0) / a0;
+    c.a2 = (1.0 - alpha) / a0;
+    return c;
+}
+
+BiquadCoefficients BiquadCoefficients::bandPass (double frequency, double q, double sampleRate)
+{
+    double w0 = 2.0 * PI * frequency / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    BiquadCoefficients c;
+    c.b0 = alpha / a0;
+    c.b1 = 0.0;
+    c.b2 = -alpha / a0;
+    c.a1 = -2.0 * cos(w0) / a0;
+    c.a2 = (1.0 - alpha) / a0;
+    return c;
+}
+
+double BiquadCoefficients::dcGain () const
+{
+    double den = 1.0 + a1 + a2;
+    return (den == 0.0) ? 0.0 : (b0 + b1 + b2) / den;
+}
+
+BiquadFilterBank::BiquadFilterBank (QObject *parent) :
+    QObject(parent),
+    _numOfStages(0),
+    _hasPendingStages(0)
+{
+    reset();
+}
+
+BiquadFilterBank::~BiquadFilterBank ()
+{
+}
+
+void BiquadFilterBank::setStages (const QVector<BiquadCoefficients> &stages)
+{
+    QMutexLocker locker(&_mutex);
+    _pendingStages = stages;
+    _hasPendingStages.store(1);
+}
+
+void BiquadFilterBank::reset ()
+{
+    memset(_z1, 0, sizeof(_z1));
+    memset(_z2, 0, sizeof(_z2));
+    _channelInfo = 0;
+    _isPrimed = false;
+}
+
+void BiquadFilterBank::_applyPendingStages ()
+{
+    if (!_hasPendingStages.load())
+        return;
+
+    QMutexLocker locker(&_mutex);
+
+    _numOfStages = _pendingStages.size();
+    if (_numOfStages > BIQUAD_MAX_STAGES)
+        _numOfStages = BIQUAD_MAX_STAGES;
+
+    for (int s = 0; s < _numOfStages; s++)
+    {
+        const BiquadCoefficients &c = _pendingStages.at(s);
+        _b0[s] = c.b0;
+        _b1[s] = c.b1;
+        _b2[s] = c.b2;
+        _a1[s] = c.a1;
+        _a2[s] = c.a2;
+    }
+
+    _hasPendingStages.store(0);
+    _isPrimed = false;
+}
+
+void BiquadFilterBank::_prime (const int *sample)
+{
+    biquad_t x[N_MAX_CHANNELS];
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+        x[c] = sample[c];
+
+    // Steady state of every section for a constant input, the output of a
+    // section is the input of the next one
+    for (int s = 0; s < _numOfStages; s++)
+    {
+        double den = 1.0 + _a1[s] + _a2[s];
+        biquad_t gain = (den == 0.0) ? 0.0 : (_b0[s] + _b1[s] + _b2[s]) / den;
+        for (int c = 0; c < N_MAX_CHANNELS; c++)
+        {
+            biquad_t y = gain * x[c];
+            _z2[s][c] = _b2[s] * x[c] - _a2[s] * y;
+            _z1[s][c] = _b1[s] * x[c] - _a1[s] * y + _z2[s][c];
+            x[c] = y;
+        }
+    }
+
+    _isPrimed = true;
+}
+
+void BiquadFilterBank::_filterSample (int *sample, unsigned int channelInfo)
+{
+    if (!_isPrimed || channelInfo != _channelInfo)
+    {
+        _channelInfo = channelInfo;
+        _prime(sample);
+    }
+
+    biquad_t x[N_MAX_CHANNELS];
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+        x[c] = sample[c];
+
+    for (int s = 0; s < _numOfStages; s++)
+    {
+        const biquad_t b0 = _b0[s];
+        const biquad_t b1 = _b1[s];
+        const biquad_t b2 = _b2[s];
+        const biquad_t a1 = _a1[s];
+        const biquad_t a2 = _a2[s];
+        biquad_t *z1 = _z1[s];
+        biquad_t *z2 = _z2[s];
+
+        for (int c = 0; c < N_MAX_CHANNELS; c++)
+        {
+            biquad_t y = b0 * x[c] + z1[c];
+            z1[c] = b1 * x[c] - a1 * y + z2[c];
+            z2[c] = b2 * x[c] - a2 * y;
+            x[c] = y;
+        }
+    }
+
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+    {
+        if (channelInfo & (1u << c))
+            sample[c] = (int) floor(x[c] + 0.5);
+    }
+}
+
+void BiquadFilterBank::filterBlock (SampleBlock &block)
+{
+    _applyPendingStages();
+    if (_numOfStages == 0)
+        return;
+
+    for (int k = 0; k < block.numOfSamples(); k++)
+        _filterSample(block.sample(k), block.channelInfo());
+    block.setHasRawData(false);
+}
+
+void BiquadFilterBank::onNewData (ChannelData data)
+{
+    _applyPendingStages();
+    if (_numOfStages > 0)
+    {
+        _filterSample(data.data(), data.channelInfo());
+        data.setHasRawData(false);
+    }
+
+    emit filteredData(data);
+}
+
+void BiquadFilterBank::onNewBlock (SampleBlock block)
+{
+    filterBlock(block);
+    emit filteredBlock(block);
+}
@@ -0,0 +1,270 @@
+#ifndef BIQUADFILTERBANK_H
+#define BIQUADFILTERBANK_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "channeldata.h"
+#include "sampleblock.h"
+#include "commonparameters.h"
+
+#define BIQUAD_MAX_STAGES   (8)     // Maximum number of second-order sections
+
+// The sections run in double precision by default. Single precision fits
+// twice as many channels per SIMD register, but the high-pass sections with
+// a cut-off far below the sample rate lose accuracy with it.
+#ifdef BIQUAD_SINGLE_PRECISION
+typedef float biquad_t;
+#else
+typedef double biquad_t;
+#endif
+
+/*!
+ * \class BiquadCoefficients biquadfilterbank.h
+ *
+ * \brief Coefficients of a second-order section normalised so that a0 = 1:
+ *
+ *     H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)
+ *
+ * The designers follow the bilinear-transform formulas of the audio EQ
+ * cookbook by R. Bristow-Johnson.
+ */
+struct BiquadCoefficients
+{
+    double b0;
+    double b1;
+    double b2;
+    double a1;
+    double a2;
+
+    /*!
+     * It returns a notch section
+     *
+     * \param frequency Centre frequency in Hz
+     *
+     * \param q Quality factor, the width of the notch is frequency / q
+     *
+     * \param sampleRate Sample rate in Hz
+     */
+    static BiquadCoefficients notch (double frequency, double q, double sampleRate);
+
+    /*!
+     * It returns a high-pass section
+     *
+     * \param frequency Cut-off frequency in Hz
+     *
+     * \param q Quality factor, 0.7071 for a Butterworth response
+     *
+     * \param sampleRate Sample rate in Hz
+     */
+    static BiquadCoefficients highPass (double frequency, double q, double sampleRate);
+
+    /*!
+     * It returns a low-pass section
+     *
+     * \param frequency Cut-off frequency in Hz
+     *
+     * \param q Quality factor, 0.7071 for a Butterworth response
+     *
+     * \param sampleRate Sample rate in Hz
+     */
+    static BiquadCoefficients lowPass (double frequency, double q, double sampleRate);
+
+    /*!
+     * It returns a band-pass section with unity gain at the centre frequency
+     *
+     * \param frequency Centre frequency in Hz
+     *
+     * \param q Quality factor, the bandwidth is frequency / q
+     *
+     * \param sampleRate Sample rate in Hz
+     */
+    static BiquadCoefficients bandPass (double frequency, double q, double sampleRate);
+
+    /*!
+     * It returns the gain of the section at DC
+     */
+    double dcGain () const;
+};
+
+/*!
+ * \class BiquadFilterBank biquadfilterbank.h
+ *
+ * \brief This class filters all the channels of the EEG stream with a
+ * cascade of second-order sections in transposed direct form II. The state
+ * of every section is stored channel-major per section, so each step of a
+ * section is a multiply-accumulate over the contiguous channels that the
+ * compiler maps onto SIMD registers. The cascade can be redesigned at
+ * runtime from any thread; the new sections are taken at the next sample.
+ *
+ * It sits in the pipeline at the same place as NoiseReduction: it receives
+ * the raw samples or blocks and emits the filtered ones.
+ */
+class BiquadFilterBank : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /*!
+     * Constructor. The cascade is empty, so the samples pass unchanged.
+     *
+     * \param parent Parent object
+     */
+    BiquadFilterBank (QObject *parent = 0);
+
+    /*!
+     * Default destructor
+     */
+    virtual ~BiquadFilterBank ();
+
+    /*!
+     * It sets the sections of the cascade. Only the first
+     * BIQUAD_MAX_STAGES sections are used. It can be called while the
+     * stream is being filtered.
+     *
+     * \param stages Coefficients of the sections in processing order
+     */
+    void setStages (const QVector<BiquadCoefficients> &stages);
+
+    /*!
+     * It returns the number of sections of the cascade in use
+     */
+    int numOfStages () { return _numOfStages; }
+
+    /*!
+     * It clears the state of the sections. The next sample received is
+     * used to initialise them so no start-up transient is produced.
+     */
+    void reset ();
+
+    /*!
+     * It filters in place all the samples of a block for the channels
+     * reported in its channel info
+     *
+     * \param block SampleBlock containing the samples
+     */
+    void filterBlock (SampleBlock &block);
+
+public slots:
+
+    /*!
+     * This slot receives a raw sample
+     *
+     * \param data ChannelData class containing the incoming sample
+     */
+    void onNewData (ChannelData data);
+
+    /*!
+     * This slot receives a block of raw samples
+     *
+     * \param block SampleBlock containing the incoming samples
+     */
+    void onNewBlock (SampleBlock block);
+
+signals:
+
+    /*!
+     * This signal is emitted with every filtered sample
+     *
+     * \param data ChannelData class containing the filtered sample
+     */
+    void filteredData (ChannelData data);
+
+    /*!
+     * This signal is emitted with every filtered block
+     *
+     * \param block SampleBlock containing the filtered samples
+     */
+    void filteredBlock (SampleBlock block);
+
+private:
+
+    /*!
+     * It takes the sections set by setStages if there are new ones
+     */
+    void _applyPendingStages ();
+
+    /*!
+     * It sets the state of every section to its steady state for a
+     * constant input equal to the given sample
+     */
+    void _prime (const int *sample);
+
+    /*!
+     * It filters a sample of all the channels in place
+     */
+    void _filterSample (int *sample, unsigned int channelInfo);
+
+    /*!
+     * \property BiquadFilterBank::_numOfStages
+     *
+     * Number of sections in use
+     */
+    int _numOfStages;
+
+    /*!
+     * \property BiquadFilterBank::_b0
+     *
+     * Coefficients of the sections in use, one array per coefficient
+     */
+    biquad_t _b0[BIQUAD_MAX_STAGES];
+    biquad_t _b1[BIQUAD_MAX_STAGES];
+    biquad_t _b2[BIQUAD_MAX_STAGES];
+    biquad_t _a1[BIQUAD_MAX_STAGES];
+    biquad_t _a2[BIQUAD_MAX_STAGES];
+
+    /*!
+     * \property BiquadFilterBank::_z1
+     *
+     * First state variable of every section, one row per section and one
+     * column per channel
+     */
+    Q_DECL_ALIGN(64) biquad_t _z1[BIQUAD_MAX_STAGES][N_MAX_CHANNELS];
+
+    /*!
+     * \property BiquadFilterBank::_z2
+     *
+     * Second state variable of every section
+     */
+    Q_DECL_ALIGN(64) biquad_t _z2[BIQUAD_MAX_STAGES][N_MAX_CHANNELS];
+
+    /*!
+     * \property BiquadFilterBank::_channelInfo
+     *
+     * Channel mask of the stream. The state is reset whenever it changes.
+     */
+    unsigned int _channelInfo;
+
+    /*!
+     * \property BiquadFilterBank::_isPrimed
+     *
+     * Whether the state has been initialised with a received sample
+     */
+    bool _isPrimed;
+
+    /*!
+     * \property BiquadFilterBank::_pendingStages
+     *
+     * Sections set by setStages and not taken yet
+     */
+    QVector<BiquadCoefficients> _pendingStages;
+
+    /*!
+     * \property BiquadFilterBank::_hasPendingStages
+     *
+     * Whether _pendingStages holds new sections
+     */
+    QAtomicInt _hasPendingStages;
+
+    /*!
+     * \property BiquadFilterBank::_mutex
+     *
+     * It protects _pendingStages
+     */
+    QMutex _mutex;
+};
+
+#endif // BIQUADFILTERBANK_H
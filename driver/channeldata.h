@@ -14,7 +14,7 @@ public:
     /*!
      * Default constructor
      */
-    ChannelData () {}
+    ChannelData () : _hasRawData(false) {}
 
     /*!
      * It returns an integer that reports which channels are present in the
@@ -53,6 +53,34 @@ public:
      */
     void setData(int index, int value) {if (index < 32) _data[index] = value;}
 
+    /*!
+     * It returns whether the sample carries the values sent by the device
+     * besides the ones in physical units
+     */
+    bool hasRawData () {return _hasRawData;}
+
+    /*!
+     * It indicates whether the raw values are valid. It must be cleared by
+     * any stage that changes the values in physical units.
+     */
+    void setHasRawData (bool value) {_hasRawData = value;}
+
+    /*!
+     * It returns the pointer to the vector that contains the values sent by
+     * the device for all the channels, as signed ADC counts. They are only
+     * meaningful if hasRawData() is true.
+     */
+    int * rawData () {return _rawData;}
+
+    /*!
+     * It sets the value sent by the device for a specific channel
+     *
+     * \param index 0-based channel index
+     *
+     * \param value signed ADC counts
+     */
+    void setRawData(int index, int value) {if (index < 32) _rawData[index] = value;}
+
     /*!
      * It gets the timestamp of the sample
      */
@@ -104,6 +132,20 @@ private:
      */
     int _data[32];
 
+    /*!
+     * \property ChannelData::_rawData
+     *
+     * Vector that holds the values sent by the device for all the channels
+     */
+    int _rawData[32];
+
+    /*!
+     * \property ChannelData::_hasRawData
+     *
+     * Whether _rawData holds the values of the sample
+     */
+    bool _hasRawData;
+
     /*!
      * \property ChannelData::_timeStamp
      *
@@ -0,0 +1,152 @@
+#include "decimator.h"
+
+#include <math.h>
+#include <string.h>
+
+Decimator::Decimator (int factor, QObject *parent) :
+    QObject(parent),
+    _factor(factor),
+    _isEnabled(0),
+    _isResetPending(0)
+{
+    if (_factor < 1)
+        _factor = 1;
+
+    _numOfTaps = _factor * DECIMATOR_TAPS_PER_PHASE + 1;
+    if (_numOfTaps > DECIMATOR_MAX_TAPS)
+        _numOfTaps = DECIMATOR_MAX_TAPS - 1;
+
+    _designFilter();
+    _reset();
+}
+
+Decimator::~Decimator ()
+{
+}
+
+void Decimator::setEnabled (bool enabled)
+{
+    // The state is cleared before the first sample is processed
+    if (enabled && !_isEnabled.load())
+        reset();
+
+    _isEnabled.store(enabled ? 1 : 0);
+}
+
+void Decimator::reset ()
+{
+    _isResetPending.store(1);
+}
+
+void Decimator::_reset ()
+{
+    memset(_history, 0, sizeof(_history));
+    memset(_timestamps, 0, sizeof(_timestamps));
+    memset(_repeated, 0, sizeof(_repeated));
+    _head = 0;
+    _phase = 0;
+    _channelInfo = 0;
+    _isPrimed = false;
+}
+
+void Decimator::_designFilter ()
+{
+    // Cut-off at 90% of the Nyquist frequency of the decimated stream
+    // expressed in cycles per input sample
+    double cutOff = 0.45 / _factor;
+    double center = (_numOfTaps - 1) / 2.0;
+    double gain = 0.0;
+
+    for (int k = 0; k < _numOfTaps; k++)
+    {
+        double n = k - center;
+        double sinc = (n == 0.0) ? 2.0 * cutOff :
+                                   sin(2.0 * PI * cutOff * n) / (PI * n);
+        double window = 0.42 - 0.5 * cos(2.0 * PI * k / (_numOfTaps - 1))
+                             + 0.08 * cos(4.0 * PI * k / (_numOfTaps - 1));
+        _coefficients[_numOfTaps - 1 - k] = sinc * window;
+        gain += sinc * window;
+    }
+
+    // Unity gain at DC
+    for (int k = 0; k < _numOfTaps; k++)
+        _coefficients[k] /= gain;
+}
+
+void Decimator::onNewData (ChannelData data)
+{
+    if (!_isEnabled.load())
+        return;
+
+    if (_isResetPending.testAndSetOrdered(1, 0))
+        _reset();
+
+    if (!_isPrimed || data.channelInfo() != _channelInfo)
+    {
+        // Fill the whole delay line with the first sample to avoid the
+        // start-up step response
+        _reset();
+        _channelInfo = data.channelInfo();
+        for (int k = 0; k < 2 * _numOfTaps; k++)
+        {
+            for (int c = 0; c < N_MAX_CHANNELS; c++)
+                _history[k][c] = data.data()[c];
+        }
+        for (int k = 0; k < _numOfTaps; k++)
+            _timestamps[k] = data.timestamp();
+        _isPrimed = true;
+    }
+
+    // Push the new sample in both copies of the delay line
+    int *samples = data.data();
+    double *row = _history[_head];
+    double *rowCopy = _history[_head + _numOfTaps];
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+    {
+        row[c] = samples[c];
+        rowCopy[c] = samples[c];
+    }
+    _timestamps[_head] = data.timestamp();
+    _repeated[_head] = data.isRepeated();
+
+    int newest = _head;
+    _head++;
+    if (_head == _numOfTaps)
+        _head = 0;
+
+    // Only the polyphase branch producing an output is evaluated
+    _phase++;
+    if (_phase < _factor)
+        return;
+    _phase = 0;
+
+    double acum[N_MAX_CHANNELS];
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+        acum[c] = 0.0;
+
+    // The oldest-to-newest window starts at _head
+    for (int k = 0; k < _numOfTaps; k++)
+    {
+        const double coefficient = _coefficients[k];
+        const double *window = _history[_head + k];
+        for (int c = 0; c < N_MAX_CHANNELS; c++)
+            acum[c] += coefficient * window[c];
+    }
+
+    // Timestamp of the sample at the centre of the filter
+    int center = newest - groupDelay();
+    if (center < 0)
+        center += _numOfTaps;
+
+    ChannelData output;
+    output.setChannelInfo(_channelInfo);
+    output.setTimestamp(_timestamps[center]);
+    output.setRepeated(_repeated[center]);
+    for (int c = 0; c < N_MAX_CHANNELS; c++)
+    {
+        output.setData(c, (int) floor(acum[c] + 0.5));
+        output.setCompressionOverflow(c, false);
+    }
+
+    emit decimatedData(output);
+}
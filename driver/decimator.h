@@ -0,0 +1,199 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <QAtomicInt>
+#include <QObject>
+
+#include "channeldata.h"
+#include "commonparameters.h"
+
+#define DECIMATOR_TAPS_PER_PHASE    (8)     // FIR taps evaluated per polyphase branch
+#define DECIMATOR_MAX_TAPS          (128)   // Upper bound for factor * taps per phase + 1
+
+/*!
+ * \class Decimator decimator.h
+ *
+ * \brief This class reduces the rate of the EEG stream by an integer factor.
+ * An anti-aliasing low pass FIR filter is applied in its polyphase form, this
+ * is, only the branch of the filter that produces an output sample is
+ * evaluated. The filter state is stored sample-major so that every tap is a
+ * single multiply-accumulate over all the channels, which the compiler maps
+ * onto SIMD registers.
+ */
+class Decimator : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param factor Number of input samples per output sample
+     *
+     * \param parent Parent object
+     */
+    Decimator (int factor, QObject *parent = 0);
+
+    /*!
+     * Default destructor
+     */
+    virtual ~Decimator ();
+
+    /*!
+     * It returns the decimation factor
+     */
+    int factor () { return _factor; }
+
+    /*!
+     * It returns the number of taps of the anti-aliasing filter
+     */
+    int numOfTaps () { return _numOfTaps; }
+
+    /*!
+     * It returns the delay introduced by the filter in input samples. The
+     * timestamps of the decimated samples are already compensated.
+     */
+    int groupDelay () { return (_numOfTaps - 1) / 2; }
+
+    /*!
+     * It enables or disables the decimation. When disabled the incoming
+     * samples are discarded without any processing. It may be called from
+     * any thread.
+     */
+    void setEnabled (bool enabled);
+
+    /*!
+     * It returns whether the decimation is enabled
+     */
+    bool isEnabled () { return _isEnabled.load() != 0; }
+
+    /*!
+     * It clears the filter state. The next sample received is used to
+     * initialise the history so no start-up transient is produced. It may be
+     * called from any thread: the state is cleared by the thread delivering
+     * the samples, before it processes the next one.
+     */
+    void reset ();
+
+public slots:
+
+    /*!
+     * This slot receives the samples at the full rate
+     *
+     * \param data ChannelData class containing the incoming sample
+     */
+    void onNewData (ChannelData data);
+
+signals:
+
+    /*!
+     * This signal is emitted every factor() input samples with the filtered
+     * and decimated sample
+     *
+     * \param data ChannelData containing the decimated sample
+     */
+    void decimatedData (ChannelData data);
+
+private:
+
+    /*!
+     * It clears the filter state in the thread delivering the samples
+     */
+    void _reset ();
+
+    /*!
+     * It designs a Blackman-windowed sinc low pass filter with its cut-off
+     * below the Nyquist frequency of the decimated stream
+     */
+    void _designFilter ();
+
+    /*!
+     * \property Decimator::_factor
+     *
+     * Number of input samples per output sample
+     */
+    int _factor;
+
+    /*!
+     * \property Decimator::_numOfTaps
+     *
+     * Length of the anti-aliasing filter
+     */
+    int _numOfTaps;
+
+    /*!
+     * \property Decimator::_isEnabled
+     *
+     * Whether incoming samples are processed
+     */
+    QAtomicInt _isEnabled;
+
+    /*!
+     * \property Decimator::_isResetPending
+     *
+     * Whether reset was called and the state has not been cleared yet
+     */
+    QAtomicInt _isResetPending;
+
+    /*!
+     * \property Decimator::_coefficients
+     *
+     * Filter taps stored in reverse order so that they line up with the
+     * oldest-to-newest window of the history
+     */
+    double _coefficients[DECIMATOR_MAX_TAPS];
+
+    /*!
+     * \property Decimator::_history
+     *
+     * Delay line with one row per sample and one column per channel. Every
+     * sample is written twice (at head and head + _numOfTaps) so that the
+     * filter window is always a contiguous block of rows.
+     */
+    Q_DECL_ALIGN(64) double _history[2 * DECIMATOR_MAX_TAPS][N_MAX_CHANNELS];
+
+    /*!
+     * \property Decimator::_timestamps
+     *
+     * Timestamps of the samples stored in the delay line
+     */
+    unsigned long long _timestamps[DECIMATOR_MAX_TAPS];
+
+    /*!
+     * \property Decimator::_repeated
+     *
+     * Repeated flags of the samples stored in the delay line
+     */
+    bool _repeated[DECIMATOR_MAX_TAPS];
+
+    /*!
+     * \property Decimator::_head
+     *
+     * Position of the next sample in the delay line
+     */
+    int _head;
+
+    /*!
+     * \property Decimator::_phase
+     *
+     * Number of input samples received since the last output
+     */
+    int _phase;
+
+    /*!
+     * \property Decimator::_channelInfo
+     *
+     * Channel mask of the stream. The history is reset whenever it changes.
+     */
+    unsigned int _channelInfo;
+
+    /*!
+     * \property Decimator::_isPrimed
+     *
+     * Whether the history has been initialised with a received sample
+     */
+    bool _isPrimed;
+};
+
+#endif // DECIMATOR_H
@@ -26,6 +26,20 @@ DeviceManager::DeviceManager(QObject *parent) :
     connect(_icognosCom, SIGNAL(receivedDeviceStatus(DeviceManagerTypes::DeviceStatus)), this, SIGNAL(receivedDeviceStatus(DeviceManagerTypes::DeviceStatus)));
     connect(_icognosCom, SIGNAL(receivedImpedanceData(ChannelData)),                     this, SIGNAL(receivedImpedanceData(ChannelData)));
 
+    // Decimated streams. Direct connections so that the filtering runs in the
+    // poll thread and only the decimated samples are queued to the consumers
+    _halfRateDecimator    = new Decimator(DeviceManagerTypes::DECIMATION_2, this);
+    _quarterRateDecimator = new Decimator(DeviceManagerTypes::DECIMATION_4, this);
+    _tenthRateDecimator   = new Decimator(DeviceManagerTypes::DECIMATION_10, this);
+
+    connect(_icognosCom, SIGNAL(receivedEEGData(ChannelData)), _halfRateDecimator,    SLOT(onNewData(ChannelData)), Qt::DirectConnection);
+    connect(_icognosCom, SIGNAL(receivedEEGData(ChannelData)), _quarterRateDecimator, SLOT(onNewData(ChannelData)), Qt::DirectConnection);
+    connect(_icognosCom, SIGNAL(receivedEEGData(ChannelData)), _tenthRateDecimator,   SLOT(onNewData(ChannelData)), Qt::DirectConnection);
+
+    connect(_halfRateDecimator,    SIGNAL(decimatedData(ChannelData)), this, SIGNAL(receivedEEGDataHalfRate(ChannelData)));
+    connect(_quarterRateDecimator, SIGNAL(decimatedData(ChannelData)), this, SIGNAL(receivedEEGDataQuarterRate(ChannelData)));
+    connect(_tenthRateDecimator,   SIGNAL(decimatedData(ChannelData)), this, SIGNAL(receivedEEGDataTenthRate(ChannelData)));
+
 }
 
 
@@ -196,19 +210,16 @@ int DeviceManager::checkRegWritten(QByteArray regArray, DeviceManagerTypes::Star
     regArrayRead.clear();
     requestSync(DeviceManagerTypes::READ_REGISTER_REQUEST, family, address, regArrayRead, regArray.size());
 
-    QString regReadStr = QString("regRead: [") +  QString::number(address) + QString("] = ");
-    QString regArrayStr = QString("regArray: [") +  QString::number(address) + QString("] = ");
-    for(int i = 0; i < regArray.size(); i ++){
-        int value = (regArrayRead[i] & 0xFF);
-        regReadStr += aux.sprintf("0x%02X ", value);
-        value = (regArray[i] & 0xFF);
-        regArrayStr += aux.sprintf("0x%02X ", value);
+    // The register dumps are only built when they are written
+    if( LOG_IS_ENABLED(LOG_LEVEL_DEBUG, LOG_DRIVER) ){
+        QString regArrayStr = QString("regArray: [") +  QString::number(address) + QString("] = ");
+        for(int i = 0; i < regArray.size(); i ++){
+            int value = (regArray[i] & 0xFF);
+            regArrayStr += aux.sprintf("0x%02X ", value);
+        }
+        LOG_DEBUG(LOG_DRIVER, regArrayStr)
     }
-    //qDebug() << regReadStr;
-    qDebug() << regArrayStr;
-
 
-    unsigned char * regRead = new unsigned char[regArray.size()];
 
     // Compare whether retry is necessary
     if(memcmp(regArray.data(), regArrayRead.data(), regArray.size()) != 0 ){
@@ -224,12 +235,13 @@ int DeviceManager::checkRegWritten(QByteArray regArray, DeviceManagerTypes::Star
             readRegister( family, address, regArrayRead, regArray.size());
 
             // Print regRead
-            int j = 0;
-            regReadStr = QString("regRead: [") +  QString::number(address) + QString("] = ");
-            for(j = 0; j < regArray.size(); j ++){
-                regReadStr += aux.sprintf("0x%02X ", regRead[j]);
+            if( LOG_IS_ENABLED(LOG_LEVEL_DEBUG, LOG_DRIVER) ){
+                QString regReadStr = QString("regRead: [") +  QString::number(address) + QString("] = ");
+                for(int j = 0; j < regArray.size(); j ++){
+                    regReadStr += aux.sprintf("0x%02X ", (regArrayRead[j] & 0xFF));
+                }
+                LOG_DEBUG(LOG_DRIVER, "Iteration: " << i << regReadStr)
             }
-            qDebug() << "Iteration: "<< i << regReadStr;
 
             if( memcmp(regArray.data(), regArrayRead.data(), regArray.size()) == 0 ) break;
             i++;
@@ -239,7 +251,6 @@ int DeviceManager::checkRegWritten(QByteArray regArray, DeviceManagerTypes::Star
 //        emit abortCurrentStimulationProtocol();
 //        emit newMessage(5, "Error writing registers.");
     }
-    delete regRead;
     return i;
 
 }
@@ -320,6 +331,15 @@ bool DeviceManager::requestSync(DeviceManagerTypes::StarstimRequest request_type
     return true;
 }
 
+void DeviceManager::setDecimatedStreamEnabled(DeviceManagerTypes::DecimationFactor factor, bool enabled){
+
+    if( factor == DeviceManagerTypes::DECIMATION_2 )  _halfRateDecimator->setEnabled(enabled);
+    if( factor == DeviceManagerTypes::DECIMATION_4 )  _quarterRateDecimator->setEnabled(enabled);
+    if( factor == DeviceManagerTypes::DECIMATION_10 ) _tenthRateDecimator->setEnabled(enabled);
+
+    loggerMacroDebug("Decimated stream 1/" + QString::number(factor) + " " + QString(enabled?"ENABLED":"DISABLED"))
+}
+
 void DeviceManager::setSampleRate(DeviceManagerTypes::SampleRate sampleRate){
 
     QByteArray regArray;
@@ -13,6 +13,7 @@
 #include "commonparameters.h"
 #include "icognoscom.h"
 #include "devicemanagertypes.h"
+#include "decimator.h"
 #include "sleeper.h"
 
 
@@ -82,6 +83,24 @@ public:
     void setSampleRate(DeviceManagerTypes::SampleRate sampleRate);
     DeviceManagerTypes::SampleRate getSampleRate(){ return _icognosCom->getSampleRate(); }
 
+    /*!
+     * It returns the object receiving from the device. Its signals are
+     * emitted in the poll thread, so slots connected to them with
+     * Qt::DirectConnection run there without queuing an event per sample.
+     */
+    StarstimCom* getStarstimCom(){ return _icognosCom; }
+
+
+    /*!
+     * It enables or disables one of the decimated EEG streams. Only the
+     * enabled streams spend CPU time filtering the incoming samples.
+     *
+     * \param factor Rate reduction of the stream
+     *
+     * \param enabled True to start publishing the stream, false to stop it
+     */
+    void setDecimatedStreamEnabled(DeviceManagerTypes::DecimationFactor factor, bool enabled);
+
 
     // Open/Close operations
 
@@ -303,6 +322,15 @@ private:
      */
     bool _deviceStimulating;
 
+    /*!
+     * \brief _halfRateDecimator, _quarterRateDecimator, _tenthRateDecimator
+     * filter and decimate the EEG stream for the consumers that do not need
+     * the full sample rate
+     */
+    Decimator* _halfRateDecimator;
+    Decimator* _quarterRateDecimator;
+    Decimator* _tenthRateDecimator;
+
 
     // FUNCTIONS
     // ----------------
@@ -322,6 +350,16 @@ signals:
      */
     void receivedEEGData(ChannelData data);
 
+    /*!
+     * Signals emitted with the EEG stream decimated by 2, 4 and 10. They
+     * are only emitted when enabled through setDecimatedStreamEnabled().
+     *
+     * \param data The decimated sample data
+     */
+    void receivedEEGDataHalfRate(ChannelData data);
+    void receivedEEGDataQuarterRate(ChannelData data);
+    void receivedEEGDataTenthRate(ChannelData data);
+
     /*!
      * Signal that is emitted reporting the new accelerometer data
      * received.
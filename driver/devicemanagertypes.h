@@ -19,6 +19,17 @@ namespace DeviceManagerTypes {
         _37_5_SPS_  = 0x0F
     }SampleRate;
 
+    /*!
+     * \enum DecimationFactor
+     *
+     * Rate reductions available for the decimated EEG streams
+     */
+    typedef enum DecimationFactor {
+        DECIMATION_2  = 2,
+        DECIMATION_4  = 4,
+        DECIMATION_10 = 10
+    }DecimationFactor;
+
     /*!
      * \enum DeviceType
      *
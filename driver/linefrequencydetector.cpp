@@ -0,0 +1,126 @@
+#include "linefrequencydetector.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "commonparameters.h"
+
+LineFrequencyDetector::LineFrequencyDetector (double sampleRate)
+{
+    setSampleRate(sampleRate);
+}
+
+void LineFrequencyDetector::setSampleRate (double sampleRate)
+{
+    _sampleRate = sampleRate;
+
+    // Harmonics above the Nyquist frequency are left out of the energies
+    for (int t = 0; t < 2*LINE_DETECTOR_HARMONICS; t++)
+    {
+        double fundamental = (t < LINE_DETECTOR_HARMONICS) ? 50.0 : 60.0;
+        double f = fundamental * (t % LINE_DETECTOR_HARMONICS + 1);
+        _coeff[t] = 2.0 * cos(2.0 * PI * f / _sampleRate);
+        _isToneUsed[t] = (f < _sampleRate / 2);
+    }
+
+    reset();
+}
+
+void LineFrequencyDetector::reset ()
+{
+    memset(_s1, 0, sizeof(_s1));
+    memset(_s2, 0, sizeof(_s2));
+    _numOfSamples = 0;
+    _frequency = 0;
+    _candidate = 0;
+    _confirmations = 0;
+    _ratio = 1.0;
+}
+
+bool LineFrequencyDetector::process (const int *sample, int numOfChannels)
+{
+    if (numOfChannels > SAMPLE_BLOCK_CHANNELS)
+        numOfChannels = SAMPLE_BLOCK_CHANNELS;
+
+    // One Goertzel step per tone, the inner loop runs over the channels
+    for (int t = 0; t < 2*LINE_DETECTOR_HARMONICS; t++)
+    {
+        const double coeff = _coeff[t];
+        double *s1 = _s1[t];
+        double *s2 = _s2[t];
+        for (int i = 0; i < numOfChannels; i++)
+        {
+            double s = sample[i] + coeff * s1[i] - s2[i];
+            s2[i] = s1[i];
+            s1[i] = s;
+        }
+    }
+
+    if (++_numOfSamples < LINE_DETECTOR_WINDOW)
+        return false;
+
+    return _evaluateWindow(numOfChannels);
+}
+
+bool LineFrequencyDetector::_evaluateWindow (int numOfChannels)
+{
+    double energy[2] = {0.0, 0.0};
+    for (int t = 0; t < 2*LINE_DETECTOR_HARMONICS; t++)
+    {
+        if (!_isToneUsed[t])
+            continue;
+
+        const double coeff = _coeff[t];
+        for (int i = 0; i < numOfChannels; i++)
+        {
+            double s1 = _s1[t][i];
+            double s2 = _s2[t][i];
+            energy[t / LINE_DETECTOR_HARMONICS] += s1*s1 + s2*s2 - coeff*s1*s2;
+        }
+    }
+
+    memset(_s1, 0, sizeof(_s1));
+    memset(_s2, 0, sizeof(_s2));
+    _numOfSamples = 0;
+
+    // A tone of amplitude A gives an energy of (A*N/2)^2 per channel
+    double minEnergy = LINE_DETECTOR_MIN_AMPLITUDE * LINE_DETECTOR_WINDOW / 2.0;
+    minEnergy *= minEnergy * (numOfChannels > 0 ? numOfChannels : 1);
+
+    _ratio = (energy[1] > 0.0) ? energy[0] / energy[1] : LINE_DETECTOR_THRESHOLD;
+
+    int favoured = 0;
+    if (energy[0] + energy[1] >= minEnergy)
+    {
+        if (_ratio >= LINE_DETECTOR_THRESHOLD)
+            favoured = 50;
+        else if (_ratio <= 1.0 / LINE_DETECTOR_THRESHOLD)
+            favoured = 60;
+    }
+
+    // Inconclusive windows and windows favouring the current decision
+    // interrupt the confirmation of a new candidate
+    if (favoured == 0 || favoured == _frequency)
+    {
+        _candidate = 0;
+        _confirmations = 0;
+        return false;
+    }
+
+    if (favoured != _candidate)
+    {
+        _candidate = favoured;
+        _confirmations = 0;
+    }
+    _confirmations++;
+
+    int needed = (_frequency == 0) ? LINE_DETECTOR_CONFIRMATIONS : LINE_DETECTOR_SWITCH_CONFIRMATIONS;
+    if (_confirmations < needed)
+        return false;
+
+    LOG_INFO(LOG_DRIVER, "Power line frequency" << _frequency << "->" << favoured << "Hz, ratio 50/60:" << _ratio)
+    _frequency = favoured;
+    _candidate = 0;
+    _confirmations = 0;
+    return true;
+}
@@ -0,0 +1,157 @@
+#ifndef LINEFREQUENCYDETECTOR_H
+#define LINEFREQUENCYDETECTOR_H
+
+#include "sampleblock.h"
+
+#define LINE_DETECTOR_HARMONICS         (3)       // Fundamental plus two harmonics per candidate
+#define LINE_DETECTOR_WINDOW            (200)     // [samples] Goertzel window, 0.4 s at 500 Hz
+#define LINE_DETECTOR_THRESHOLD         (4.0)     // Energy ratio needed to favour a candidate (6 dB)
+#define LINE_DETECTOR_MIN_AMPLITUDE     (100.0)   // [nV] Windows with weaker line noise are inconclusive
+#define LINE_DETECTOR_CONFIRMATIONS     (2)       // Consecutive windows for the first decision
+#define LINE_DETECTOR_SWITCH_CONFIRMATIONS (5)    // Consecutive windows to change a decision
+
+/*!
+ * \class LineFrequencyDetector linefrequencydetector.h
+ *
+ * \brief This class detects whether the power-line noise of the incoming
+ * signal is at 50 or 60 Hz. It runs, as the samples arrive, the Goertzel
+ * algorithm of every channel at both fundamentals and their harmonics over
+ * consecutive windows of LINE_DETECTOR_WINDOW samples. A window favours a
+ * candidate when its energy, added over channels and harmonics, is
+ * LINE_DETECTOR_THRESHOLD times the energy of the other one. The first
+ * decision needs LINE_DETECTOR_CONFIRMATIONS windows in a row, and the
+ * detector keeps monitoring afterwards so that a later change is followed
+ * once it is confirmed by LINE_DETECTOR_SWITCH_CONFIRMATIONS windows.
+ */
+class LineFrequencyDetector
+{
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param sampleRate Sample rate of the signal in Hz
+     */
+    LineFrequencyDetector (double sampleRate);
+
+    /*!
+     * It sets the sample rate of the signal and restarts the detection
+     */
+    void setSampleRate (double sampleRate);
+
+    /*!
+     * It restarts the detection discarding the current decision
+     */
+    void reset ();
+
+    /*!
+     * It processes a new sample of all the channels
+     *
+     * \param sample Values of the SAMPLE_BLOCK_CHANNELS channels in nV
+     *
+     * \param numOfChannels Number of channels processed, from channel 0
+     *
+     * \return true when the detected frequency changes with this sample
+     */
+    bool process (const int *sample, int numOfChannels);
+
+    /*!
+     * It returns whether a frequency has been detected
+     */
+    bool isDecided () { return _frequency != 0; }
+
+    /*!
+     * It returns the frequency detected, 50 or 60 Hz, or 0 if undecided
+     */
+    int frequency () { return _frequency; }
+
+    /*!
+     * It returns the ratio between the 50 Hz and the 60 Hz energies of the
+     * last window
+     */
+    double ratio () { return _ratio; }
+
+private:
+
+    /*!
+     * It evaluates the energies accumulated at the end of a window
+     *
+     * \param numOfChannels Number of channels processed
+     *
+     * \return true when the detected frequency changes
+     */
+    bool _evaluateWindow (int numOfChannels);
+
+    /*!
+     * \property LineFrequencyDetector::_sampleRate
+     *
+     * Sample rate of the signal in Hz
+     */
+    double _sampleRate;
+
+    /*!
+     * \property LineFrequencyDetector::_coeff
+     *
+     * Goertzel coefficient 2*cos(2*pi*f/fs) of every tone, the 50 Hz
+     * harmonics first and then the 60 Hz ones
+     */
+    double _coeff[2*LINE_DETECTOR_HARMONICS];
+
+    /*!
+     * \property LineFrequencyDetector::_isToneUsed
+     *
+     * Whether every tone is below the Nyquist frequency
+     */
+    bool _isToneUsed[2*LINE_DETECTOR_HARMONICS];
+
+    /*!
+     * \property LineFrequencyDetector::_s1
+     *
+     * Last Goertzel state per tone and channel
+     */
+    double _s1[2*LINE_DETECTOR_HARMONICS][SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     * \property LineFrequencyDetector::_s2
+     *
+     * Previous Goertzel state per tone and channel
+     */
+    double _s2[2*LINE_DETECTOR_HARMONICS][SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     * \property LineFrequencyDetector::_numOfSamples
+     *
+     * Samples accumulated in the current window
+     */
+    int _numOfSamples;
+
+    /*!
+     * \property LineFrequencyDetector::_frequency
+     *
+     * Frequency detected, 0 while undecided
+     */
+    int _frequency;
+
+    /*!
+     * \property LineFrequencyDetector::_candidate
+     *
+     * Frequency favoured by the last conclusive windows
+     */
+    int _candidate;
+
+    /*!
+     * \property LineFrequencyDetector::_confirmations
+     *
+     * Consecutive windows favouring _candidate
+     */
+    int _confirmations;
+
+    /*!
+     * \property LineFrequencyDetector::_ratio
+     *
+     * Ratio between the 50 Hz and 60 Hz energies of the last window
+     */
+    double _ratio;
+};
+
+#endif // LINEFREQUENCYDETECTOR_H
@@ -0,0 +1,68 @@
+#include "mainsfrequencytracker.h"
+
+#include <math.h>
+
+MainsFrequencyTracker::MainsFrequencyTracker (double sampleRate, double nominal) :
+    _sampleRate(sampleRate)
+{
+    // Gains of the continuous loop s^2 + 2*pi*kp*s + 2*pi*ki = 0, the
+    // integral one expressed per sample
+    double wn = 2.0 * PI * MAINS_TRACKER_LOOP_BW;
+    _kp = 2.0 * MAINS_TRACKER_DAMPING * wn / (2.0 * PI);
+    _ki = wn * wn / (2.0 * PI) / _sampleRate;
+    _lowPassAlpha = 1.0 - exp(-2.0 * PI * MAINS_TRACKER_LOWPASS / _sampleRate);
+
+    setNominalFrequency(nominal);
+}
+
+void MainsFrequencyTracker::setNominalFrequency (double nominal)
+{
+    _nominal = nominal;
+    _bandPass = BiquadCoefficients::bandPass(_nominal, MAINS_TRACKER_BANDPASS_Q, _sampleRate);
+    reset();
+}
+
+void MainsFrequencyTracker::reset ()
+{
+    _z1 = 0.0;
+    _z2 = 0.0;
+    _inPhase = 0.0;
+    _quadrature = 0.0;
+    _phase = 0.0;
+    _integrator = 0.0;
+    _isLocked = false;
+}
+
+void MainsFrequencyTracker::process (double x)
+{
+    // Pre-filter, transposed direct form II
+    double y = _bandPass.b0 * x + _z1;
+    _z1 = _bandPass.b1 * x - _bandPass.a1 * y + _z2;
+    _z2 = _bandPass.b2 * x - _bandPass.a2 * y;
+
+    // Phase detector: the low-pass filtered products are the phasor of the
+    // input relative to the oscillator
+    _inPhase    += _lowPassAlpha * ( y * cos(_phase) - _inPhase);
+    _quadrature += _lowPassAlpha * (-y * sin(_phase) - _quadrature);
+
+    double amplitude = 2.0 * sqrt(_inPhase * _inPhase + _quadrature * _quadrature);
+    _isLocked = (amplitude >= MAINS_TRACKER_MIN_AMPLITUDE);
+
+    double deviation = _integrator;
+    if (_isLocked)
+    {
+        double error = atan2(_quadrature, _inPhase);
+
+        _integrator += _ki * error;
+        if (_integrator > MAINS_TRACKER_RANGE)
+            _integrator = MAINS_TRACKER_RANGE;
+        else if (_integrator < -MAINS_TRACKER_RANGE)
+            _integrator = -MAINS_TRACKER_RANGE;
+
+        deviation = _integrator + _kp * error;
+    }
+
+    _phase += 2.0 * PI * (_nominal + deviation) / _sampleRate;
+    if (_phase > PI)
+        _phase -= 2.0 * PI;
+}
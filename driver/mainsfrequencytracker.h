@@ -0,0 +1,158 @@
+#ifndef MAINSFREQUENCYTRACKER_H
+#define MAINSFREQUENCYTRACKER_H
+
+#include "biquadfilterbank.h"
+
+#define MAINS_TRACKER_RANGE         (0.5)     // [Hz] Maximum deviation from the nominal frequency
+#define MAINS_TRACKER_BANDPASS_Q    (2.0)     // Quality factor of the pre-filter around the nominal frequency
+#define MAINS_TRACKER_LOWPASS       (5.0)     // [Hz] Bandwidth of the phase detector
+#define MAINS_TRACKER_LOOP_BW       (0.2)     // [Hz] Natural frequency of the loop
+#define MAINS_TRACKER_DAMPING       (0.7)     // Damping factor of the loop
+#define MAINS_TRACKER_MIN_AMPLITUDE (100.0)   // [nV] Below it the estimate is held
+
+/*!
+ * \class MainsFrequencyTracker mainsfrequencytracker.h
+ *
+ * \brief This class estimates the instantaneous power-line frequency with
+ * a second-order phase-locked loop. The input, usually the mean of all the
+ * channels, is band-pass filtered around the nominal frequency and mixed
+ * with a local oscillator; the phase of the low-pass filtered product is
+ * the error driving a proportional-integral loop filter. The integrator
+ * holds the frequency estimate, limited to MAINS_TRACKER_RANGE around the
+ * nominal frequency, and it is frozen while the line noise is too weak to
+ * be tracked.
+ */
+class MainsFrequencyTracker
+{
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param sampleRate Sample rate of the signal in Hz
+     *
+     * \param nominal Nominal power-line frequency in Hz
+     */
+    MainsFrequencyTracker (double sampleRate, double nominal);
+
+    /*!
+     * It sets the nominal frequency and restarts the loop
+     */
+    void setNominalFrequency (double nominal);
+
+    /*!
+     * It returns the nominal frequency
+     */
+    double nominalFrequency () { return _nominal; }
+
+    /*!
+     * It restarts the loop at the nominal frequency
+     */
+    void reset ();
+
+    /*!
+     * It processes a new sample
+     *
+     * \param x Sample in nV
+     */
+    void process (double x);
+
+    /*!
+     * It returns the estimated power-line frequency in Hz
+     */
+    double frequency () { return _nominal + _integrator; }
+
+    /*!
+     * It returns whether the line noise is strong enough to be tracked
+     */
+    bool isLocked () { return _isLocked; }
+
+private:
+
+    /*!
+     * \property MainsFrequencyTracker::_sampleRate
+     *
+     * Sample rate of the signal in Hz
+     */
+    double _sampleRate;
+
+    /*!
+     * \property MainsFrequencyTracker::_nominal
+     *
+     * Nominal power-line frequency in Hz
+     */
+    double _nominal;
+
+    /*!
+     * \property MainsFrequencyTracker::_bandPass
+     *
+     * Pre-filter around the nominal frequency
+     */
+    BiquadCoefficients _bandPass;
+
+    /*!
+     * \property MainsFrequencyTracker::_z1
+     *
+     * State of the pre-filter
+     */
+    double _z1;
+    double _z2;
+
+    /*!
+     * \property MainsFrequencyTracker::_inPhase
+     *
+     * Low-pass filtered product with the cosine of the oscillator
+     */
+    double _inPhase;
+
+    /*!
+     * \property MainsFrequencyTracker::_quadrature
+     *
+     * Low-pass filtered product with the sine of the oscillator
+     */
+    double _quadrature;
+
+    /*!
+     * \property MainsFrequencyTracker::_lowPassAlpha
+     *
+     * Coefficient of the one-pole low-pass filters of the phase detector
+     */
+    double _lowPassAlpha;
+
+    /*!
+     * \property MainsFrequencyTracker::_phase
+     *
+     * Phase of the oscillator in radians
+     */
+    double _phase;
+
+    /*!
+     * \property MainsFrequencyTracker::_integrator
+     *
+     * Deviation of the estimated frequency from the nominal one in Hz
+     */
+    double _integrator;
+
+    /*!
+     * \property MainsFrequencyTracker::_kp
+     *
+     * Proportional gain of the loop filter in Hz per radian
+     */
+    double _kp;
+
+    /*!
+     * \property MainsFrequencyTracker::_ki
+     *
+     * Integral gain of the loop filter in Hz per radian and sample
+     */
+    double _ki;
+
+    /*!
+     * \property MainsFrequencyTracker::_isLocked
+     *
+     * Whether the line noise is strong enough to be tracked
+     */
+    bool _isLocked;
+};
+
+#endif // MAINSFREQUENCYTRACKER_H
@@ -1,70 +1,89 @@
 #include "noisereduction.h"
 #include <stdio.h>
+#include <string.h>
 #include <QVector>
 
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define NOISEREDUCTION_USE_AVX2
+#endif
 
-double matrix50[]={0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,
-0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,
--0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,
--0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,
--0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,
--0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,
--0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,
--0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,
--0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,
-0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,
-0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,
-0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,
--0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,
--0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,
--0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,
--0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,
--0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,
--0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,
--0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,
-0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3,0.0809016994375,-0.130901699437,-0.0309016994375,-0.0190983005625,-0.1,-0.0190983005625,-0.0309016994375,-0.130901699437,0.0809016994375,0.3};
-
-double matrix60[]={0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,
-0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,
--0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,
-0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,
--0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,
--0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,
--0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,
--0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,
-0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,
-0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,
--0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,
--0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,
--0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,
--0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,
--0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,
--0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,
-0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,
-0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,
--0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,
--0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,
--0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,
--0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,0.00412011005676,
-0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,-0.0893364397097,
--0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24,0.0123468125762,
-0.0123468125762,-0.0893364397097,0.00412011005676,-0.0762646420859,-0.01527864045,-0.0465064804396,-0.070565375832,0.205908677488,0.117993919564,-0.10472135955,-0.00756960961481,-0.0501269720026,-0.0501269720026,-0.00756960961481,-0.10472135955,0.117993919564,0.205908677488,-0.070565375832,-0.0465064804396,-0.01527864045,-0.0762646420859,0.00412011005676,-0.0893364397097,0.0123468125762,0.24};
 
+/*
+ * simd_is_supported
+ * ------------------------------------------------------------------
+ *  Run-time check of the instruction set enabled at compile time.
+ *
+ * */
+bool simd_is_supported()
+{
+#if defined(NOISEREDUCTION_USE_AVX2) && defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return true;
+#endif
+}
 
-void cancel_pwl_first(double *xvec, uint32_t block_len, int offset,double **matrix_m, double *yvec, double *svec)
+
+/*
+ * dot_product
+ * ------------------------------------------------------------------
+ *  Dot product of two vectors. The AVX2 version keeps two independent
+ *  accumulators of four doubles to hide the latency of the FMA.
+ *
+ * */
+double dot_product(const double *a, const double *b, uint32_t len)
+{
+  uint32_t ind = 0;
+  double   acum = 0.0;
+
+#ifdef NOISEREDUCTION_USE_AVX2
+  __m256d acum0 = _mm256_setzero_pd();
+  __m256d acum1 = _mm256_setzero_pd();
+
+  for (; ind + 8 <= len; ind += 8) {
+    acum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + ind),     _mm256_loadu_pd(b + ind),     acum0);
+    acum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + ind + 4), _mm256_loadu_pd(b + ind + 4), acum1);
+  }
+  if (ind + 4 <= len) {
+    acum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + ind), _mm256_loadu_pd(b + ind), acum0);
+    ind += 4;
+  }
+
+  /* Horizontal sum */
+  __m256d sum  = _mm256_add_pd(acum0, acum1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+  half = _mm_add_sd(half, _mm_unpackhi_pd(half, half));
+  acum = _mm_cvtsd_f64(half);
+#endif
+
+  /* Scalar fallback and remaining elements */
+  for (; ind < len; ind++) {
+    acum += a[ind]*b[ind];
+  }
+
+  return acum;
+}
+
+
+void matrix_vector_product(double **matrix_m, const double *xvec, uint32_t block_len, double *out)
 {
   uint32_t row;
-  uint32_t col;
 
-  double acum;
+  for (row = 0; row < block_len; row++) {
+    out[row] = dot_product(matrix_m[row], xvec, block_len);
+  }
+}
+
+
+void cancel_pwl_first(double *xvec, uint32_t block_len, int offset,double **matrix_m, double *yvec, double *svec)
+{
+  uint32_t row;
 
   /* Projects  */
+  matrix_vector_product(matrix_m, xvec + offset, block_len, svec);
   for (row = 0; row < block_len; row++) {
-    acum = 0.0;
-    for (col = 0; col < block_len; col++) {
-      acum += matrix_m[row][col]*xvec[col+offset];
-    }
-    svec[row] = acum;
     yvec[row] = xvec[row] - svec[row];
   }
 }
@@ -73,16 +92,12 @@ void cancel_pwl_first(double *xvec, uint32_t block_len, int offset,double **matr
 void update_svec(double *xvec, uint32_t offset, uint32_t block_len, double **matrix_m, double *svec)
 {
       uint32_t row;
-      uint32_t col;
 
       double acum;
 
       /* Projects  */
       for (row = 0; row < block_len; row++) {
-        acum = 0.0;
-        for (col = 0; col < block_len; col++) {
-          acum += matrix_m[row][col]*xvec[offset+col];
-        }
+        acum = dot_product(matrix_m[row], xvec + offset, block_len);
         svec[row]        = (1.0 - CANCEL_ALPHA)*svec[row] + CANCEL_ALPHA*acum;
       }
 }
@@ -108,16 +123,12 @@ double denoise_sample(double sample, double *svec, int index)
 void cancel_pwl_signal(double *xvec, uint32_t block_len, double **matrix_m, double *yvec, double *svec)
 {
   uint32_t row;
-  uint32_t col;
 
   double acum;
 
   /* Projects  */
   for (row = 0; row < block_len; row++) {
-    acum = 0.0;
-    for (col = 0; col < block_len; col++) {
-      acum += matrix_m[row][col]*xvec[col];
-    }
+    acum = dot_product(matrix_m[row], xvec, block_len);
     svec[row]        = (1.0 - CANCEL_ALPHA)*svec[row] + CANCEL_ALPHA*acum;
     yvec[row] = xvec[row] - svec[row];
   }
@@ -137,7 +148,6 @@ void cancel_pwl_signal(double *xvec, uint32_t block_len, double **matrix_m, doub
 double detect_pwl_freq(double *xvec, uint32_t xlen, double **m50, double **m60, int xlen50, int xlen60)
 {
   uint32_t row;
-  uint32_t col;
 
   double p50_acum;
   double p60_acum;
@@ -156,19 +166,13 @@ double detect_pwl_freq(double *xvec, uint32_t xlen, double **m50, double **m60,
   qDebug()<<"m60[0][0]"<<m60[0][0];
 
   for (row = 0; row < xlen60; row++) {
-    acum_60 = 0.0;
-    for (col = 0; col < xlen60; col++) {
-      acum_60 += m60[row][col]*xvec[col];
-    }
+    acum_60 = dot_product(m60[row], xvec, xlen60);
     p60_acum += acum_60*acum_60;
 
   }
 
   for (row = 0; row < xlen50; row++) {
-    acum_50 = 0.0;
-    for (col = 0; col < xlen50; col++) {
-      acum_50 += m50[row][col]*xvec[col];
-    }
+    acum_50 = dot_product(m50[row], xvec, xlen50);
     p50_acum += acum_50*acum_50;
   }
 
@@ -222,20 +226,33 @@ double* CreateVector(uint32_t vlen)
 double** CreateMatrix(uint32_t rows, uint32_t cols)
 {
   double   **mat;
+  double   *data;
+  char     *buffer;
   uint32_t ind;
+  uint32_t stride;
 
   mat = (double **) calloc(rows, sizeof(double *));
   if (mat == NULL) {
     printf(">>> WARNING: cannot allocate memory\n");
     fflush(stdout);
+    return NULL;
+  }
+
+  /* Single buffer, the original pointer is kept just before the aligned data */
+  stride = (cols + MATRIX_ROW_PADDING - 1) / MATRIX_ROW_PADDING * MATRIX_ROW_PADDING;
+  buffer = (char *) calloc(1, (size_t) rows*stride*sizeof(double) + MATRIX_ALIGNMENT + sizeof(void *));
+  if (buffer == NULL) {
+    printf(">>> WARNING: cannot allocate memory\n");
+    fflush(stdout);
+    free(mat);
+    return NULL;
   }
 
+  data = (double *) (((size_t) (buffer + sizeof(void *)) + MATRIX_ALIGNMENT - 1) & ~((size_t) MATRIX_ALIGNMENT - 1));
+  ((void **) data)[-1] = buffer;
+
   for (ind = 0; ind < rows; ind++) {
-    mat[ind] = (double *) calloc(cols, sizeof(double));
-    if (mat[ind] == NULL) {
-      printf(">>> WARNING: cannot allocate memory\n");
-      fflush(stdout);
-    }
+    mat[ind] = data + ind*stride;
   }
 
   return mat;
@@ -251,10 +268,12 @@ double** CreateMatrix(uint32_t rows, uint32_t cols)
  * */
 void FreeMatrix(double **mat, uint32_t rows, uint32_t cols)
 {
-  uint32_t  ind;
+  if (mat == NULL)
+    return;
 
-  for (ind = 0; ind < rows; ind++) {
-    free(mat[ind]);
+  /* All the rows live in the buffer allocated for the first one */
+  if (rows > 0) {
+    free(((void **) mat[0])[-1]);
   }
   free(mat);
 }
@@ -342,33 +361,9 @@ void read_matrix_from_file(const char *fname, double **matrix, uint32_t block_le
   fclose(fid);
 }
 
-void read_matrix_from_var(double *localmatrix, double **matrix, uint32_t block_len)
-{
-  uint8_t  row;
-  uint8_t  col;
-  double   num;
-
-
-  /* Read M50 M60 matrix from var */
-
-  row = 0;
-  col = 0;
-  int i = 0;
-
-  while (row < block_len) {
-
-      /* read single value from var */
-      matrix[row][col] = localmatrix[i++];
-
-      /* Update Matix indexes */
-      col++;
-      col %= block_len;
-      if (col == 0) {
-        row++;
-      }
-  }
-
-}
+#ifdef NOISEREDUCTION_ACCURACY_HARNESS
+#include <QFile>
+#endif
 
 //#define __DEBUGARTIFACTENOBIO20__
 #ifdef __DEBUGARTIFACTENOBIO20__
@@ -377,42 +372,45 @@ void read_matrix_from_var(double *localmatrix, double **matrix, uint32_t block_l
 QFile _debugArtifacticognos20File;
 #endif
 
-NoiseReduction::NoiseReduction ()
+NoiseReduction::NoiseReduction () :
+    _detector(FREQ_SAMP),
+    _tracker(FREQ_SAMP, 50.0)
 {
     _numOfChannels=8;
-    _delay = 100;
     _noiseFrequency=-1;
     _noiseReductionEnabled=true;
+    _isTrackingEnabled=true;
+    _samplesSinceRetune=0;
+    _precision=DOUBLE_PRECISION;
+    _latencyBudget=0;
+    _weightsVersion=0;
+    _taskPool=NULL;
+    _useSharedPool=true;
+    _parallelMinWork=NOISE_PARALLEL_MIN_WORK;
 
 
     qDebug()<<"Noise Reduction Constructor";
 
     /* Allocate Space for Matrices and Vectors                          */
     /* ---------------------------------------------------------------- */
-    matrix_m50 = CreateMatrix(BLOCK_LEN_50, BLOCK_LEN_50);
-    matrix_m60 = CreateMatrix(BLOCK_LEN_60, BLOCK_LEN_60);
     yvec       = CreateVector(XLEN);
     xvec       = CreateVector(BLOCK_LEN_60);
     svec       = CreateVector(BLOCK_LEN_60);
     /* ---------------------------------------------------------------- */
 
-    for (int i=0;i<_numOfChannels;i++)
-    {
-        _Buffer[i].resize(BLOCK_LEN_60);
-        _Buffer[i].fill(0);
-
-        _BufferDenoised[i].resize(BLOCK_LEN_60);
-        _BufferDenoised[i].fill(0);
+    memset(_history, 0, sizeof(_history));
+    memset(_historyTimestamps, 0, sizeof(_historyTimestamps));
+    memset(_historyRepeated, 0, sizeof(_historyRepeated));
+    _historyHead = 0;
+    _samplesPushed = 0;
+    _nextOutput = 0;
 
-    }
-
-    /* Read M50 and M60 Matrices */
-    //read_matrix_from_file("matrix_s50.dat", matrix_m50, BLOCK_LEN_50);
-    //read_matrix_from_file("matrix_s60.dat", matrix_m60, BLOCK_LEN_60);
-    read_matrix_from_var(matrix50, matrix_m50, BLOCK_LEN_50);
-    read_matrix_from_var(matrix60, matrix_m60, BLOCK_LEN_60);
     _noiseState = EVALUATING_NOISE_FREQUENCY;
 
+    /* Generate M50 and M60 Matrices */
+    matrix_m = NULL;
+    setLineHarmonics(LINE_HARMONICS_DEFAULT);
+
 #ifdef __DEBUGARTIFACTENOBIO20__
     _debugArtifacticognos20File.setFileName(QDateTime::currentDateTime().toString("yyyyMMddhhmss") +
                                            "_debugArtifact_preNoise.txt");
@@ -425,8 +423,7 @@ NoiseReduction::~NoiseReduction()
 {
     /* Free Allocated vectors and Matrices */
     /* ---------------------------------------------------------------- */
-    FreeMatrix(matrix_m50, BLOCK_LEN_50, BLOCK_LEN_50);
-    FreeMatrix(matrix_m60, BLOCK_LEN_60, BLOCK_LEN_60);
+    /* The projection operators belong to ProjectionGenerator */
     free(xvec);
     free(yvec);
     free(svec);
@@ -436,90 +433,557 @@ NoiseReduction::~NoiseReduction()
 #endif
 }
 
-ChannelData NoiseReduction::denoiseSample(ChannelData data)
+void NoiseReduction::_pushHistory(const int *sample, unsigned long long timestamp, bool isRepeated)
 {
+    _historyTimestamps[_historyHead] = timestamp;
+    _historyRepeated[_historyHead] = isRepeated;
 
-#ifdef __DEBUGARTIFACTENOBIO20__
-    QString strSample = "";
-    for (int i=0;i<_numOfChannels;i++)
+    int32_t *first  = _history[_historyHead];
+    int32_t *second = _history[_historyHead + NOISE_HISTORY_LEN];
+    for (int i=0;i<SAMPLE_BLOCK_CHANNELS;i++)
     {
-        strSample.append(QString::number(data.data()[i]) + "\t");
+        first[i]  = sample[i];
+        second[i] = sample[i];
     }
-    strSample.append(QString::number(data.timestamp())+ "\n");
-    _debugArtifacticognos20File.write(strSample.toAscii());
-#endif
 
+    _historyHead++;
+    if (_historyHead == NOISE_HISTORY_LEN)
+        _historyHead = 0;
+    _samplesPushed++;
+}
+
+int32_t (*NoiseReduction::_window())[SAMPLE_BLOCK_CHANNELS]
+{
+    // The rows from _historyHead to _historyHead + NOISE_HISTORY_LEN - 1
+    // hold the history from the oldest to the newest sample
+    return &_history[_historyHead + NOISE_HISTORY_LEN - _blockLength];
+}
 
-    for (int i=0;i<_numOfChannels;i++)
+void NoiseReduction::_selectFrequency(int frequency)
+{
+    _noiseFrequency = frequency;
+
+    qDebug()<<"Power Line Noise Detected: "<<_noiseFrequency;
+
+    if (_noiseFrequency == 50.0)
+    {
+      matrix_m = matrix_m50;
+      _blockLength=ProjectionGenerator::windowLength(FREQ_SAMP, 50.0);
+    } else
     {
-        _Buffer[i].push_back(data.data()[i]);
-        _Buffer[i].pop_front();
+      matrix_m = matrix_m60;
+      _blockLength=ProjectionGenerator::windowLength(FREQ_SAMP, 60.0);
     }
 
+    // Only the row of the projection of the sample being denoised is needed,
+    // the last one when there is no look-ahead. The rows of the operators
+    // around the nominal frequency are precomputed so that the tracked
+    // frequency is followed by interpolation.
+    double step = 2.0 * MAINS_TRACKER_RANGE / (NOISE_TRACKING_GRID - 1);
+    for (int g=0;g<NOISE_TRACKING_GRID;g++)
+    {
+        double fundamental = _noiseFrequency - MAINS_TRACKER_RANGE + g * step;
+        double **operatorMatrix = ProjectionGenerator::generate(FREQ_SAMP, fundamental, _lineHarmonics, _blockLength);
+        for (int j=0;j<_blockLength;j++)
+            _weightGrid[g][j] = operatorMatrix[_targetRow()][j];
+        FreeMatrix(operatorMatrix, _blockLength, _blockLength);
+    }
 
-    if(_noiseState == EVALUATING_NOISE_FREQUENCY)
+    _tracker.setNominalFrequency(_noiseFrequency);
+    _samplesSinceRetune = 0;
+    _weights = _trackedWeights;
+    _retune();
+}
+
+void NoiseReduction::_retune()
+{
+    double position = (NOISE_TRACKING_GRID - 1) / 2.0;
+    if (_isTrackingEnabled && _tracker.isLocked())
     {
-            if (_delay>0)
-            {
-                //qDebug()<<"_delay"<<_delay;
-                _delay--;
-            }
+        double step = 2.0 * MAINS_TRACKER_RANGE / (NOISE_TRACKING_GRID - 1);
+        position = (_tracker.frequency() - _noiseFrequency + MAINS_TRACKER_RANGE) / step;
+        if (position < 0.0)
+            position = 0.0;
+        else if (position > NOISE_TRACKING_GRID - 1)
+            position = NOISE_TRACKING_GRID - 1;
+    }
 
-            else
-            {
-                _noiseFrequency = detect_pwl_freq(_Buffer[0].data(), BLOCK_LEN_50, matrix_m50, matrix_m60, BLOCK_LEN_50 , BLOCK_LEN_60);
+    int g = (int) position;
+    if (g == NOISE_TRACKING_GRID - 1)
+        g--;
+    double t = position - g;
 
-                qDebug()<<"Power Line Noise Detected: "<<_noiseFrequency;
+    for (int j=0;j<_blockLength;j++)
+        _trackedWeights[j] = (1.0 - t) * _weightGrid[g][j] + t * _weightGrid[g+1][j];
 
-                if (_noiseFrequency == 50.0)
-                {
-                  matrix_m = matrix_m50;
-                  _blockLength=BLOCK_LEN_50;
-                } else
-                {
-                  matrix_m = matrix_m60;
-                  _blockLength=BLOCK_LEN_60;
-                }
+    _updateReducedWeights();
+}
 
+void NoiseReduction::_updateReducedWeights()
+{
+    double sum = 0.0;
+    int64_t sumFixed = 0;
+    int largest = 0;
+    for (int j=0;j<_blockLength;j++)
+    {
+        sum += _weights[j];
+        _weightsFloat[j] = (float) _weights[j];
+        _weightsFixed[j] = (int32_t) floor(_weights[j] * NOISE_FIXED_ONE + 0.5);
+        sumFixed += _weightsFixed[j];
+        if (fabs(_weights[j]) > fabs(_weights[largest]))
+            largest = j;
+    }
+    _weightSum = sum;
+    _weightsVersion++;
 
+    // The rounding of the fixed-point weights is corrected on the largest
+    // one so that their sum is exact and the DC level of the channels does
+    // not leak into the estimation
+    _weightsFixed[largest] += (int32_t) (floor(sum * NOISE_FIXED_ONE + 0.5) - sumFixed);
+}
 
-                for (int i=0;i<_numOfChannels;i++)
-                {
-                    for (int k=0;k<_blockLength;k++)
-                        _Buffer[i].replace(k, _Buffer[i].at(k+BLOCK_LEN_60-_blockLength));
+void NoiseReduction::setLatencyBudget(int samples)
+{
+    _latencyBudget = (samples > 0) ? samples : 0;
 
-                    _Buffer[i].resize(_blockLength);
-                    _BufferDenoised[i].resize(_blockLength);
-                    _BufferDenoised[i].fill(0);
+    // The weights are the row of the projection of the delayed sample
+    if (_noiseState == DENOISING)
+        _selectFrequency(_noiseFrequency);
+    else
+    {
+        _weights = matrix_m[_targetRow()];
+        _updateReducedWeights();
+    }
+}
 
-                    cancel_pwl_first(_Buffer[i].data(), _blockLength, BLOCK_LEN_60-_blockLength,matrix_m, yvec,_BufferDenoised[i].data());
-                    data.setData(i,yvec[_blockLength-1]);
+void NoiseReduction::setTaskPool(TaskPool *pool)
+{
+    _taskPool=pool;
+    _useSharedPool=false;
+}
 
-                }
+void NoiseReduction::setPrecision(Precision precision)
+{
+    _precision=precision;
+}
 
-                _noiseState = DENOISING;
-            }
+void NoiseReduction::_estimateDouble(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo)
+{
+    // Interference of the target sample of every channel, the inner loop
+    // runs over the contiguous channels of a sample
+    double estimation[SAMPLE_BLOCK_CHANNELS];
+    for (int i=firstChannel;i<lastChannel;i++)
+        estimation[i] = 0.0;
+
+    for (int j=0;j<weights.length;j++)
+    {
+        const double weight = weights.values[j];
+        const int32_t *row = window[j];
+        for (int i=firstChannel;i<lastChannel;i++)
+            estimation[i] += weight * row[i];
+    }
 
+    const int32_t *target = window[weights.targetRow];
+    for (int i=firstChannel;i<lastChannel;i++)
+    {
+        if (channelInfo & (1u << i))
+            sample[i] = (int) (target[i] - estimation[i]);
+    }
+}
+
+void NoiseReduction::_estimateFloat(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo)
+{
+    // The window is taken relative to the target sample, exactly in
+    // integers, so that the DC level of the channel does not consume the
+    // precision of the float accumulation:
+    //     x - sum(w * x_j) = x * (1 - sum(w)) - sum(w * (x_j - x))
+    const int32_t *target = window[weights.targetRow];
+    float estimation[SAMPLE_BLOCK_CHANNELS];
+    for (int i=firstChannel;i<lastChannel;i++)
+        estimation[i] = 0.0f;
+
+    for (int j=0;j<weights.length;j++)
+    {
+        const float weight = weights.valuesFloat[j];
+        const int32_t *row = window[j];
+        for (int i=firstChannel;i<lastChannel;i++)
+            estimation[i] += weight * (float) (row[i] - target[i]);
+    }
+
+    const double gain = 1.0 - weights.sum;
+    for (int i=firstChannel;i<lastChannel;i++)
+    {
+        if (channelInfo & (1u << i))
+            sample[i] = (int) (target[i] * gain - estimation[i]);
+    }
+}
+
+void NoiseReduction::_estimateFixed(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo)
+{
+    int64_t estimation[SAMPLE_BLOCK_CHANNELS];
+    for (int i=firstChannel;i<lastChannel;i++)
+        estimation[i] = 0;
+
+    for (int j=0;j<weights.length;j++)
+    {
+        const int64_t weight = weights.valuesFixed[j];
+        const int32_t *row = window[j];
+        for (int i=firstChannel;i<lastChannel;i++)
+            estimation[i] += weight * row[i];
+    }
+
+    // The division truncates towards zero like the conversion of the
+    // double path
+    const int32_t *target = window[weights.targetRow];
+    for (int i=firstChannel;i<lastChannel;i++)
+    {
+        if (channelInfo & (1u << i))
+            sample[i] = (int) ((((int64_t) target[i] << NOISE_FIXED_FRACTION) - estimation[i]) / NOISE_FIXED_ONE);
+    }
+}
+
+int NoiseReduction::_snapshotWeights()
+{
+    // A new set is only taken when the weights changed during the block
+    if (_numOfWeightSets > 0 && _weightSets[_numOfWeightSets-1].version == _weightsVersion)
+        return _numOfWeightSets - 1;
+
+    NoiseWeights &weights = _weightSets[_numOfWeightSets];
+    weights.version = _weightsVersion;
+    weights.length = _blockLength;
+    weights.targetRow = _targetRow();
+    weights.sum = _weightSum;
+    for (int j=0;j<_blockLength;j++)
+    {
+        weights.values[j] = _weights[j];
+        weights.valuesFloat[j] = _weightsFloat[j];
+        weights.valuesFixed[j] = _weightsFixed[j];
+    }
+
+    return _numOfWeightSets++;
+}
+
+void NoiseReduction::_runJobs(int numOfChannels, unsigned int channelInfo)
+{
+    if (_numOfJobs == 0)
+        return;
+
+    _jobsNumOfChannels = numOfChannels;
+    _jobsChannelInfo = channelInfo;
+    _jobsPrecision = _precision;
+
+    // Small blocks are not worth the synchronisation of the pool
+    long long work = (long long) _numOfJobs * numOfChannels * _blockLength;
+    if (work >= _parallelMinWork && _taskPool == NULL && _useSharedPool)
+        _taskPool = TaskPool::instance();
+
+    if (_taskPool == NULL || work < _parallelMinWork)
+    {
+        _taskChannels = numOfChannels;
+        _taskSamples = _numOfJobs;
+        _numOfTaskGroups = 1;
+        _denoiseTask(0);
+        return;
+    }
+
+    // Every task reads one cache line of each window row and writes its own
+    // outputs, so the tasks share nothing but the weights
+    _taskChannels = NOISE_TASK_CHANNELS;
+    _taskSamples = NOISE_TASK_SAMPLES;
+    _numOfTaskGroups = (numOfChannels + _taskChannels - 1) / _taskChannels;
+    int numOfChunks = (_numOfJobs + _taskSamples - 1) / _taskSamples;
+
+    _taskPool->run(_runTask, this, _numOfTaskGroups * numOfChunks);
+}
+
+void NoiseReduction::_runTask(void *context, int index)
+{
+    static_cast<NoiseReduction*>(context)->_denoiseTask(index);
+}
+
+void NoiseReduction::_denoiseTask(int index)
+{
+    int firstChannel = (index % _numOfTaskGroups) * _taskChannels;
+    int lastChannel = firstChannel + _taskChannels;
+    if (lastChannel > _jobsNumOfChannels)
+        lastChannel = _jobsNumOfChannels;
+
+    int firstJob = (index / _numOfTaskGroups) * _taskSamples;
+    int lastJob = firstJob + _taskSamples;
+    if (lastJob > _numOfJobs)
+        lastJob = _numOfJobs;
+
+    for (int n=firstJob;n<lastJob;n++)
+    {
+        const NoiseJob &job = _jobs[n];
+        const NoiseWeights &weights = _weightSets[job.weights];
+
+        switch (_jobsPrecision)
+        {
+        case SINGLE_PRECISION:
+            _estimateFloat(job.window, weights, job.output, firstChannel, lastChannel, _jobsChannelInfo);
+            break;
+        case FIXED_POINT:
+            _estimateFixed(job.window, weights, job.output, firstChannel, lastChannel, _jobsChannelInfo);
+            break;
+        default:
+            _estimateDouble(job.window, weights, job.output, firstChannel, lastChannel, _jobsChannelInfo);
+            break;
+        }
+    }
+}
+
+void NoiseReduction::setFrequencyTrackingEnabled(bool enabled)
+{
+    _isTrackingEnabled=enabled;
+    if (_noiseState == DENOISING)
+        _retune();
+}
+
+bool NoiseReduction::denoiseSample(ChannelData data, ChannelData &denoised)
+{
+    SampleBlock block;
+    block.append(data);
+    denoiseBlock(block);
+
+    // Nothing is delivered while the look-ahead is being filled, and a block
+    // never has more outputs than inputs
+    if (block.numOfSamples() == 0)
+        return false;
+
+    int *output = block.sample(0);
+    denoised = data;
+    for (int i=0;i<_numOfChannels;i++)
+        denoised.setData(i, output[i]);
+    denoised.setHasRawData(false);
+    denoised.setTimestamp(block.timestamp(0));
+    denoised.setRepeated(block.isRepeated(0));
+
+    return true;
+}
+
+void NoiseReduction::denoiseBlock(SampleBlock &block)
+{
+    // Channels processed, up to the highest one reported in the block
+    unsigned int channelInfo = block.channelInfo();
+    int numOfChannels = 0;
+    while (numOfChannels < SAMPLE_BLOCK_CHANNELS && (channelInfo >> numOfChannels) != 0)
+        numOfChannels++;
+    if (channelInfo == 0)
+    {
+        numOfChannels = _numOfChannels;
+        channelInfo = (numOfChannels < 32) ? ((1u << numOfChannels) - 1) : 0xFFFFFFFFu;
+    }
+
+    // Samples are written back in place at the position of the output,
+    // which never runs ahead of the input
+    int numOfOutputs = 0;
+    _numOfJobs = 0;
+    _numOfWeightSets = 0;
+    for (int k=0;k<block.numOfSamples();k++)
+    {
+        int *sample = block.sample(k);
+
+#ifdef __DEBUGARTIFACTENOBIO20__
+        QString strSample = "";
+        for (int i=0;i<_numOfChannels;i++)
+        {
+            strSample.append(QString::number(sample[i]) + "\t");
         }
-        else
+        strSample.append(QString::number(block.timestamp(k))+ "\n");
+        _debugArtifacticognos20File.write(strSample.toAscii());
+#endif
+
+        _pushHistory(sample, block.timestamp(k), block.isRepeated(k));
+
+        // The detector keeps running while denoising, so the operator follows
+        // a change of the power-line frequency
+        if (_detector.process(sample, numOfChannels))
+        {
+            _selectFrequency(_detector.frequency());
+            _noiseState = DENOISING;
+        }
+
+        // Mains frequency tracking while denoising
+        if(_noiseState == DENOISING)
+            _track(sample, numOfChannels, channelInfo);
+
+        // The output is the sample latency() positions behind the newest
+        // one, with its own timestamp. When the latency is increased the
+        // samples already delivered are not repeated, and when it is
+        // decreased the samples in between are skipped.
+        long long target = (long long) _samplesPushed - 1 - latency();
+        if (target < (long long) _nextOutput)
+            continue;
+        if (target > (long long) _nextOutput && _nextOutput > 0)
+            LOG_WARNING(LOG_DRIVER, "Noise reduction latency decreased, skipped" << target - (long long) _nextOutput << "samples")
+        _nextOutput = target + 1;
+
+        int32_t (*window)[SAMPLE_BLOCK_CHANNELS] = _window();
+        int row = _historyHead + NOISE_HISTORY_LEN - 1 - latency();
+        if (row >= NOISE_HISTORY_LEN)
+            row -= NOISE_HISTORY_LEN;
+
+        int *output = block.sample(numOfOutputs);
+        const int32_t *raw = window[_targetRow()];
+        for (int i=0;i<SAMPLE_BLOCK_CHANNELS;i++)
+            output[i] = raw[i];
+        block.setTimestamp(numOfOutputs, _historyTimestamps[row]);
+        block.setRepeated(numOfOutputs, _historyRepeated[row]);
+        numOfOutputs++;
+
+        //If noise reduction is not enabled the noise reduction algorithm is not applied
+        //Nevertheless the noise frequency stimation is previously calculated and the buffering
+        //Is being performed in case the user decides to apply the noise reduction
+        if(_noiseState == EVALUATING_NOISE_FREQUENCY || !_noiseReductionEnabled)
+            continue;
+
+        // The estimation is deferred so that all the samples of the block
+        // are denoised together, in parallel when there is a task pool. The
+        // window stays in _history until the block is done.
+        NoiseJob &job = _jobs[_numOfJobs++];
+        job.window = window;
+        job.output = output;
+        job.weights = _snapshotWeights();
+    }
+
+    // The raw values are not delayed nor denoised with the samples
+    block.setNumOfSamples(numOfOutputs);
+    block.setHasRawData(false);
+    _runJobs(numOfChannels, channelInfo);
+}
+
+void NoiseReduction::_track(const int *sample, int numOfChannels, unsigned int channelInfo)
+{
+    // The mains frequency is tracked on the mean of the channels and the
+    // weights retuned every NOISE_TRACKING_PERIOD samples
+    if (_isTrackingEnabled)
+    {
+        double mean = 0.0;
+        int numOfActive = 0;
+        for (int i=0;i<numOfChannels;i++)
         {
-            //If noise reduction is not enabled the noise reduction algorithm is not applied
-            //Nevertheless the noise frequency stimation is previously calculated and the buffering
-            //Is being performed in case the user decides to apply the noise reduction
-            if (_noiseReductionEnabled)
+            if (channelInfo & (1u << i))
             {
-                for (int i=0;i<_numOfChannels;i++)
-                {
-                    cancel_pwl_first(_Buffer[i].data(), _blockLength, 0,matrix_m, yvec,_BufferDenoised[i].data());
-                    data.setData(i,yvec[_blockLength-1]);
+                mean += sample[i];
+                numOfActive++;
+            }
+        }
+        if (numOfActive > 0)
+            _tracker.process(mean / numOfActive);
+
+        if (++_samplesSinceRetune >= NOISE_TRACKING_PERIOD)
+        {
+            _samplesSinceRetune = 0;
+            _retune();
+        }
+    }
+}
+
+#ifdef NOISEREDUCTION_ACCURACY_HARNESS
+bool NoiseReduction::compareArithmetics(const QString &fileName, int numOfChannels)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qDebug()<<"Cannot open"<<fileName;
+        return false;
+    }
+
+    // The parallel instances split every block into tasks, the serial ones
+    // denoise it in this thread
+    NoiseReduction reference;
+    NoiseReduction single;
+    NoiseReduction fixed;
+    NoiseReduction serial[3];
+    NoiseReduction *parallel[3] = { &reference, &single, &fixed };
+    const Precision precisions[3] = { DOUBLE_PRECISION, SINGLE_PRECISION, FIXED_POINT };
+    for (int p=0;p<3;p++)
+    {
+        parallel[p]->setNumOfChannels(numOfChannels);
+        parallel[p]->setPrecision(precisions[p]);
+        parallel[p]->_parallelMinWork = 0;
+        serial[p].setNumOfChannels(numOfChannels);
+        serial[p].setPrecision(precisions[p]);
+        serial[p].setTaskPool(NULL);
+    }
 
-                }
+    unsigned int channelInfo = (numOfChannels < 32) ? ((1u << numOfChannels) - 1) : 0xFFFFFFFFu;
+    double maxErrorSingle = 0.0;
+    double maxErrorFixed = 0.0;
+    long long numOfParallelDifferences = 0;
+    long long numOfSamples = 0;
+    bool isEnd = false;
+
+    while (!isEnd)
+    {
+        SampleBlock block;
+        block.setChannelInfo(channelInfo);
+        int k = 0;
+        while (k < SAMPLE_BLOCK_CAPACITY)
+        {
+            QByteArray line = file.readLine();
+            if (line.isEmpty())
+            {
+                isEnd = true;
+                break;
             }
+
+            QList<QByteArray> columns = line.trimmed().split('\t');
+            if (columns.size() < numOfChannels)
+                continue;
+
+            int *sample = block.sample(k);
+            for (int i=0;i<SAMPLE_BLOCK_CHANNELS;i++)
+                sample[i] = (i < numOfChannels) ? columns.at(i).toInt() : 0;
+            block.setTimestamp(k, numOfSamples);
+            block.setRepeated(k, false);
+            k++;
+            numOfSamples++;
         }
+        block.setNumOfSamples(k);
+
+        SampleBlock blockSingle = block;
+        SampleBlock blockFixed = block;
+        SampleBlock blockSerial[3] = { block, block, block };
+        reference.denoiseBlock(block);
+        single.denoiseBlock(blockSingle);
+        fixed.denoiseBlock(blockFixed);
 
+        SampleBlock *blockParallel[3] = { &block, &blockSingle, &blockFixed };
+        for (int p=0;p<3;p++)
+        {
+            serial[p].denoiseBlock(blockSerial[p]);
+            if (blockSerial[p].numOfSamples() != blockParallel[p]->numOfSamples() ||
+                memcmp(blockSerial[p].sample(0), blockParallel[p]->sample(0),
+                       blockSerial[p].numOfSamples() * SAMPLE_BLOCK_CHANNELS * sizeof(int)) != 0)
+                numOfParallelDifferences++;
+        }
 
-     return data;
+        for (int s=0;s<k;s++)
+        {
+            for (int i=0;i<numOfChannels;i++)
+            {
+                maxErrorSingle = fmax(maxErrorSingle, fabs((double) blockSingle.sample(s)[i] - block.sample(s)[i]));
+                maxErrorFixed  = fmax(maxErrorFixed,  fabs((double) blockFixed.sample(s)[i]  - block.sample(s)[i]));
+            }
+        }
+    }
+
+    qDebug()<<"NoiseReduction accuracy"<<fileName<<numOfSamples<<"samples"
+            <<"line"<<reference._noiseFrequency<<"Hz"
+            <<"max error single precision"<<maxErrorSingle<<"nV"
+            <<"fixed point"<<maxErrorFixed<<"nV"
+            <<"parallel blocks differing from serial"<<numOfParallelDifferences;
+    return numOfParallelDifferences == 0;
 }
+#endif
+
+ void NoiseReduction::onNewBlock(SampleBlock block)
+ {
+     denoiseBlock(block);
+     emit DenoisedBlock(block);
+ }
 
  void NoiseReduction::onNewData(ChannelData data, int numOfChannels)
  {
@@ -548,18 +1012,35 @@ bool NoiseReduction::isDenoising()
     return isDenoising;
 }
 
-void NoiseReduction::setNumOfChannels(int channels)
+void NoiseReduction::setLineHarmonics(unsigned int harmonics)
 {
-    _numOfChannels=channels;
-
-    for (int i=0;i<_numOfChannels;i++)
-    {
-        _Buffer[i].resize(BLOCK_LEN_60);
-        _Buffer[i].fill(0);
+    _lineHarmonics=harmonics;
 
-        _BufferDenoised[i].resize(BLOCK_LEN_60);
-        _BufferDenoised[i].fill(0);
+    matrix_m50 = ProjectionGenerator::matrix(FREQ_SAMP, 50.0, _lineHarmonics);
+    matrix_m60 = ProjectionGenerator::matrix(FREQ_SAMP, 60.0, _lineHarmonics);
+    LOG_DEBUG(LOG_DRIVER, "Projection operators harmonics:" << _lineHarmonics
+              << "window 50Hz:" << ProjectionGenerator::windowLength(FREQ_SAMP, 50.0)
+              << "60Hz:" << ProjectionGenerator::windowLength(FREQ_SAMP, 60.0))
 
+    if (_noiseState == DENOISING)
+        _selectFrequency(_noiseFrequency);
+    else
+    {
+        matrix_m = matrix_m50;
+        _blockLength = ProjectionGenerator::windowLength(FREQ_SAMP, 50.0);
+        _weights = matrix_m[_targetRow()];
+        _updateReducedWeights();
     }
+}
+
+void NoiseReduction::setNumOfChannels(int channels)
+{
+    _numOfChannels=channels;
 
+    memset(_history, 0, sizeof(_history));
+    memset(_historyTimestamps, 0, sizeof(_historyTimestamps));
+    memset(_historyRepeated, 0, sizeof(_historyRepeated));
+    _historyHead = 0;
+    _samplesPushed = 0;
+    _nextOutput = 0;
 }
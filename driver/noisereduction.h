@@ -9,12 +9,28 @@
 #include <stdio.h>
 #include <math.h>
 #include "channeldata.h"
+#include "projectiongenerator.h"
+#include "sampleblock.h"
+#include "linefrequencydetector.h"
+#include "mainsfrequencytracker.h"
+#include "taskpool.h"
+#include "commonparameters.h"
 
 #define  BLOCK_LEN      (20)
 #define  BLOCK_LEN_50      (20)
 #define  BLOCK_LEN_60      (25)
 #define  XLEN           (50000)
 #define  CANCEL_ALPHA   (0.3)
+#define  MATRIX_ALIGNMENT   (64)    // [bytes] Alignment of the matrix rows
+#define  MATRIX_ROW_PADDING (8)     // [doubles] Row stride is a multiple of it
+#define  NOISE_HISTORY_LEN  (PROJECTION_MAX_LEN + SAMPLE_BLOCK_CAPACITY)    // [samples] History kept to denoise a block
+#define  NOISE_TRACKING_GRID    (21)    // Operators precomputed over +-MAINS_TRACKER_RANGE
+#define  NOISE_TRACKING_PERIOD  (10)    // [samples] Period of the retuning of the weights
+#define  NOISE_FIXED_FRACTION   (28)    // Fractional bits of the fixed-point weights
+#define  NOISE_FIXED_ONE        (1LL << NOISE_FIXED_FRACTION)
+#define  NOISE_TASK_CHANNELS    (16)    // Channels of a parallel task, a cache line of a history row
+#define  NOISE_TASK_SAMPLES     (8)     // Samples of a parallel task
+#define  NOISE_PARALLEL_MIN_WORK (16384) // [products] Smaller blocks are denoised serially
 
 
 
@@ -78,6 +94,41 @@ void cancel_pwl_signal(double *xvec, uint32_t block_len, double **matrix_m, doub
  */
 double detect_pwl_freq(double *xvec, uint32_t xlen, double **m50, double **m60, int xlen50, int xlen60);
 
+/*!
+ *  This function returns whether the CPU runs the instructions the code
+ *  was compiled with. It is always true unless the build enables AVX2/FMA
+ *  (CONFIG+=avx2), and must be checked before any other code of such a
+ *  build runs.
+ */
+bool simd_is_supported();
+
+/*!
+ *  This function returns the dot product of the vectors A and B of
+ *  length LEN. It uses AVX2/FMA instructions when the code is compiled
+ *  with them enabled (CONFIG+=avx2) and a scalar loop otherwise.
+ *
+ * \param a First vector
+ *
+ * \param b Second vector, it does not need to be aligned
+ *
+ * \param len Length of the vectors
+ */
+double dot_product(const double *a, const double *b, uint32_t len);
+
+/*!
+ *  This function multiplies the square matrix MATRIX_M of dimensions
+ *  BLOCK_LEN x BLOCK_LEN by the vector XVEC and writes the result in OUT.
+ *
+ * \param matrix_m Matrix created with CreateMatrix
+ *
+ * \param xvec Vector of length BLOCK_LEN
+ *
+ * \param block_len Dimension of the matrix
+ *
+ * \param out Output vector of length BLOCK_LEN
+ */
+void matrix_vector_product(double **matrix_m, const double *xvec, uint32_t block_len, double *out);
+
 /*!
  * Allocates memory for a Vector of dimensions 1 x VLEN of type doubl
  * returning a pointer to the vector
@@ -89,7 +140,10 @@ double* CreateVector(uint32_t vlen);
 
 /*!
  * Allocates memory for a Matrix of dimensions ROWS x COLS of typw doule
- * returning a pointer to the matrix
+ * returning a pointer to the matrix. The elements are stored in a single
+ * row-major buffer aligned to MATRIX_ALIGNMENT bytes with the rows padded
+ * to a multiple of MATRIX_ROW_PADDING doubles; the returned row pointers
+ * point into that buffer.
  *
  * \param rows number of rows
  *
@@ -191,12 +245,23 @@ public:
         DENOISING
     };
 
+    /*!
+     * Arithmetic used to estimate the interference. The history is kept
+     * as 32-bit integers in all of them.
+     */
+    enum Precision {
+        DOUBLE_PRECISION,   // Reference path
+        SINGLE_PRECISION,   // float weights and accumulation, twice the SIMD width
+        FIXED_POINT         // Q28 weights and 64-bit integer accumulation
+    };
+
     uint32_t ind;
 
     /*!
      * \property NoiseReduction:matrix_m50
      *
      * Matrix to project the received signl onto the 50Hz power-line signal
+     * and its harmonics, owned by ProjectionGenerator
      */
     double   **matrix_m50;
 
@@ -206,6 +271,7 @@ public:
      * \property NoiseReduction:matrix_m60
      *
      * Matrix to project the received signl onto the 60Hz power-line signal
+     * and its harmonics, owned by ProjectionGenerator
      */
     double   **matrix_m60;
 
@@ -216,6 +282,15 @@ public:
      */
     double   **matrix_m;
 
+    /*!
+     * \property NoiseReduction:_weights
+     *
+     * Last row of the projection operator of the power-line frequency
+     * detected, or of the tracked one when tracking. The estimation of the interference of the newest sample is
+     * its dot product with the window of the last _blockLength samples.
+     */
+    const double *_weights;
+
     /*!
      * \property NoiseReduction:xvec
      *
@@ -252,11 +327,27 @@ public:
     double   pwl_freq;
 
     /*!
-     * \property NoiseReduction:_delay
+     * \property NoiseReduction:_detector
+     *
+     * Detector of the noise frequency, it is fed with every sample so that
+     * a change of the power-line frequency is followed while denoising
+     */
+    LineFrequencyDetector _detector;
+
+    /*!
+     * \property NoiseReduction:_tracker
+     *
+     * Tracker of the instantaneous power-line frequency around the one
+     * detected
+     */
+    MainsFrequencyTracker _tracker;
+
+    /*!
+     * \property NoiseReduction:_isTrackingEnabled
      *
-     * Delay in samples at startUp to evaluate if the noise frequency is 50 or 60 Hz
+     * Whether the weights follow the frequency estimated by _tracker
      */
-    int _delay;
+    bool _isTrackingEnabled;
 
     /*!
      * \property NoiseReduction:_noiseFrequency
@@ -266,6 +357,13 @@ public:
     int _noiseFrequency;
 
 
+    /*!
+     * \property NoiseReduction:_lineHarmonics
+     *
+     * Harmonics of the power-line frequency cancelled, organised at bit level
+     */
+    unsigned int _lineHarmonics;
+
     /*!
      * \property NoiseReduction:_numOfChannels
      *
@@ -298,14 +396,34 @@ public:
     bool _noiseReductionEnabled;
 
     /*!
-     *  This method denoises the incoming sample
+     *  This method denoises the incoming sample. The output is the sample
+     *  latency() positions behind it, with its own timestamp, so nothing is
+     *  delivered while the look-ahead is being filled.
      *
      * \param data ChannelData class containing the incoming sample
      *
-     * \return ChannelData class containing the incoming sample denoised if _noiseReductionEnabled is set to true
+     * \param denoised ChannelData class receiving the output sample, denoised if _noiseReductionEnabled is set to true
+     *
+     * \return false if there is no output for this sample, denoised is then left unchanged
      *
      */
-    ChannelData denoiseSample(ChannelData data);
+    bool denoiseSample(ChannelData data, ChannelData &denoised);
+
+    /*!
+     *  This method denoises in place all the samples of a block for the
+     *  channels reported in its channel info. The channels of every sample
+     *  are processed together, so the projection weights are loaded once
+     *  per sample and the products vectorise across channels. With a task
+     *  pool the block is split into groups of channels and samples denoised
+     *  in parallel, and the method returns once all of them are done.
+     *
+     * \param block SampleBlock containing the incoming samples, they are
+     * replaced by the samples latency() positions behind, denoised if
+     * _noiseReductionEnabled is set to true. The block can come back with
+     * fewer samples while the look-ahead is being filled.
+     *
+     */
+    void denoiseBlock(SampleBlock &block);
 
     /*!
      *  Gets wether the denoising state is denoising or evaluating the noise frequency
@@ -323,6 +441,98 @@ public:
      */
     void setNumOfChannels(int channels);
 
+    /*!
+     *  Sets the harmonics of the power-line frequency cancelled. The
+     *  fundamental and all the harmonics are removed by a single projection.
+     *
+     * \param harmonics harmonics cancelled organised at bit level, the least
+     * significant bit corresponds to the fundamental
+     *
+     */
+    void setLineHarmonics(unsigned int harmonics);
+
+    /*!
+     *  Enables or disables the tracking of the power-line frequency. When
+     *  disabled the operator of the nominal frequency is used.
+     *
+     * \param enabled true to follow the drift of the power-line frequency
+     *
+     */
+    void setFrequencyTrackingEnabled(bool enabled);
+
+    /*!
+     *  Sets the arithmetic used to estimate the interference. It can be
+     *  changed at any time, the history is shared by all of them.
+     *
+     * \param precision arithmetic of the estimation
+     *
+     */
+    void setPrecision(Precision precision);
+
+    /*!
+     *  Gets the arithmetic used to estimate the interference
+     */
+    Precision precision() { return _precision; }
+
+    /*!
+     *  Sets the pool denoising the channels of every block in parallel. By
+     *  default TaskPool::instance() is taken when the first block large
+     *  enough to be split arrives, so that the instances of all the devices
+     *  share the same workers and no worker is started until then. With NULL
+     *  the blocks are denoised in the calling thread.
+     *
+     * \param pool task pool, it must outlive the noise reduction
+     *
+     */
+    void setTaskPool(TaskPool *pool);
+
+    /*!
+     *  Gets the pool denoising the blocks in parallel, NULL until the shared
+     *  pool has been needed
+     */
+    TaskPool* taskPool() { return _taskPool; }
+
+    /*!
+     *  Sets the maximum delay allowed between the arrival of a sample and
+     *  its delivery denoised. With 0 the newest sample is denoised from the
+     *  past ones only; with larger values the denoised sample is centred
+     *  further into the projection window, using the following samples as
+     *  look-ahead. The delivered samples keep their own timestamps.
+     *
+     * \param samples latency budget in samples
+     *
+     */
+    void setLatencyBudget(int samples);
+
+    /*!
+     *  Gets the latency budget in samples
+     */
+    int latencyBudget() { return _latencyBudget; }
+
+    /*!
+     *  Gets the actual delay of the denoised samples in samples, which is
+     *  the latency budget limited to the projection window
+     */
+    int latency() { return (_latencyBudget < _blockLength - 1) ? _latencyBudget : _blockLength - 1; }
+
+#ifdef NOISEREDUCTION_ACCURACY_HARNESS
+    /*!
+     *  It denoises a recorded EASY file with the three arithmetics and logs
+     *  the maximum difference of the single precision and fixed-point paths
+     *  to the double precision one, in nV. Every arithmetic is run both on
+     *  the shared task pool, with every block split into tasks, and in the
+     *  calling thread; both outputs must be identical.
+     *
+     * \param fileName EASY file with the raw channels in its first columns
+     *
+     * \param numOfChannels number of channels of the file
+     *
+     * \return false if the file cannot be read or a parallel output differs
+     * from the serial one
+     */
+    static bool compareArithmetics(const QString &fileName, int numOfChannels);
+#endif
+
     /*!
      *  Enables the noise cancelling procedure
      */
@@ -344,6 +554,15 @@ signals:
      */
     void DenoisedData(ChannelData data);
 
+    /*!
+     *  This signal is emitted to deliver to the following stages
+     * a block of samples after applying the denoising procedure
+     *
+     * \param block SampleBlock containing the denoised samples
+     *
+     */
+    void DenoisedBlock(SampleBlock block);
+
 public slots:
 
 
@@ -360,23 +579,301 @@ private slots:
      */
      void onNewData(ChannelData data, int numOfChannels);
 
+    /*!
+     * This slot receives a block of raw samples before being denoised
+     *
+     * \param block SampleBlock containing the samples to be denoised
+     *
+     */
+     void onNewBlock(SampleBlock block);
+
 private:
 
+    /*!
+     * Weights of the estimation in the three arithmetics, as they were when
+     * a sample of the block was received
+     */
+    struct NoiseWeights
+    {
+        unsigned int version;           // _weightsVersion of the copy
+        int length;                     // Window length
+        int targetRow;                  // Row of the window of the denoised sample
+        double sum;                     // Sum of the weights
+        double values[PROJECTION_MAX_LEN];
+        float valuesFloat[PROJECTION_MAX_LEN];
+        int32_t valuesFixed[PROJECTION_MAX_LEN];
+    };
+
+    /*!
+     * Estimation of a sample of the block, deferred until the whole block
+     * has been received
+     */
+    struct NoiseJob
+    {
+        const int32_t (*window)[SAMPLE_BLOCK_CHANNELS];     // Window in _history
+        int *output;                                        // Denoised sample in the block
+        int weights;                                        // Index in _weightSets
+    };
+
+    /*!
+     *  It appends a sample of all the channels to _history
+     *
+     * \param sample Values of the SAMPLE_BLOCK_CHANNELS channels
+     */
+    void _pushHistory(const int *sample, unsigned long long timestamp, bool isRepeated);
+
+    /*!
+     *  It returns the window of the last _blockLength samples of _history,
+     *  from the oldest to the newest one, one row per sample
+     */
+    int32_t (*_window())[SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     *  It returns the row of the window of the sample being denoised
+     */
+    int _targetRow() { return _blockLength - 1 - latency(); }
+
+    /*!
+     *  It feeds the mains frequency tracker with a new sample and retunes
+     *  the weights periodically
+     */
+    void _track(const int *sample, int numOfChannels, unsigned int channelInfo);
+
+    /*!
+     *  It selects the projection operator of the power-line frequency
+     *  detected
+     *
+     * \param frequency Power-line frequency, 50 or 60 Hz
+     */
+    void _selectFrequency(int frequency);
+
+    /*!
+     *  It interpolates _weightGrid at the frequency estimated by _tracker
+     *  and writes the result in _trackedWeights
+     */
+    void _retune();
+
+    /*!
+     *  It derives the single precision and fixed-point weights from _weights
+     */
+    void _updateReducedWeights();
+
+    /*!
+     *  They replace the channels FIRSTCHANNEL to LASTCHANNEL - 1 of SAMPLE
+     *  reported in CHANNELINFO by the target sample of WINDOW minus its
+     *  estimated interference, with the double precision, single precision
+     *  and fixed-point arithmetics
+     */
+    void _estimateDouble(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo);
+    void _estimateFloat(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo);
+    void _estimateFixed(const int32_t (*window)[SAMPLE_BLOCK_CHANNELS], const NoiseWeights &weights, int *sample, int firstChannel, int lastChannel, unsigned int channelInfo);
+
+    /*!
+     *  It copies the current weights to _weightSets unless they are already
+     *  there, and returns their index
+     */
+    int _snapshotWeights();
+
+    /*!
+     *  It denoises the samples of _jobs, in parallel if there is a task pool
+     *  and the block is large enough
+     */
+    void _runJobs(int numOfChannels, unsigned int channelInfo);
+
+    /*!
+     *  Task of the pool, CONTEXT is the NoiseReduction
+     */
+    static void _runTask(void *context, int index);
+
+    /*!
+     *  It denoises a group of channels of a group of samples of _jobs
+     *
+     * \param index Task index, the channel group varies fastest
+     */
+    void _denoiseTask(int index);
+
 private:
 
     /*!
-     * \property NoiseReduction:_Buffer
+     * \property NoiseReduction:_history
+     *
+     * Last NOISE_HISTORY_LEN samples of all the channels in nV, one row per
+     * sample, where the denoising algorrithm is applied. Every sample is written
+     * twice, NOISE_HISTORY_LEN rows apart, so that any window of the history is
+     * contiguous without copying. It holds a whole block on top of the
+     * longest window, so the windows of all the samples of a block are
+     * still valid when the block is denoised.
+     */
+    int32_t _history[2*NOISE_HISTORY_LEN][SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     * \property NoiseReduction:_weightGrid
+     *
+     * Last row of the projection operators of NOISE_TRACKING_GRID
+     * frequencies evenly spaced over the nominal one +-MAINS_TRACKER_RANGE
+     */
+    double _weightGrid[NOISE_TRACKING_GRID][PROJECTION_MAX_LEN];
+
+    /*!
+     * \property NoiseReduction:_trackedWeights
+     *
+     * Weights interpolated at the tracked frequency, pointed by _weights
+     */
+    double _trackedWeights[PROJECTION_MAX_LEN];
+
+    /*!
+     * \property NoiseReduction:_weightsFloat
+     *
+     * _weights in single precision
+     */
+    float _weightsFloat[PROJECTION_MAX_LEN];
+
+    /*!
+     * \property NoiseReduction:_weightsFixed
+     *
+     * _weights in fixed point with NOISE_FIXED_FRACTION fractional bits
+     */
+    int32_t _weightsFixed[PROJECTION_MAX_LEN];
+
+    /*!
+     * \property NoiseReduction:_weightSum
+     *
+     * Sum of _weights
+     */
+    double _weightSum;
+
+    /*!
+     * \property NoiseReduction:_weightsVersion
+     *
+     * It is incremented every time the weights change
+     */
+    unsigned int _weightsVersion;
+
+    /*!
+     * \property NoiseReduction:_weightSets
+     *
+     * Weights used by the samples of the current block
+     */
+    NoiseWeights _weightSets[SAMPLE_BLOCK_CAPACITY];
+
+    /*!
+     * \property NoiseReduction:_numOfWeightSets
+     *
+     * Number of weights in _weightSets
+     */
+    int _numOfWeightSets;
+
+    /*!
+     * \property NoiseReduction:_jobs
+     *
+     * Samples of the current block to be denoised
+     */
+    NoiseJob _jobs[SAMPLE_BLOCK_CAPACITY];
+
+    /*!
+     * \property NoiseReduction:_numOfJobs
+     *
+     * Number of samples in _jobs
+     */
+    int _numOfJobs;
+
+    /*!
+     * \property NoiseReduction:_jobsNumOfChannels
+     *
+     * Number of channels, channel mask and arithmetic of the current block
+     */
+    int _jobsNumOfChannels;
+    unsigned int _jobsChannelInfo;
+    Precision _jobsPrecision;
+
+    /*!
+     * \property NoiseReduction:_taskChannels
+     *
+     * Channels and samples of a task of the current block, and number of
+     * channel groups
+     */
+    int _taskChannels;
+    int _taskSamples;
+    int _numOfTaskGroups;
+
+    /*!
+     * \property NoiseReduction:_taskPool
+     *
+     * Pool denoising the blocks in parallel, NULL to denoise them serially
+     */
+    TaskPool *_taskPool;
+
+    /*!
+     * \property NoiseReduction:_useSharedPool
+     *
+     * TaskPool::instance() is taken on the first large block, it is cleared
+     * by setTaskPool()
+     */
+    bool _useSharedPool;
+
+    /*!
+     * \property NoiseReduction:_parallelMinWork
+     *
+     * [products] Smaller blocks are denoised serially, NOISE_PARALLEL_MIN_WORK
+     * unless the accuracy harness lowers it
+     */
+    long long _parallelMinWork;
+
+    /*!
+     * \property NoiseReduction:_precision
+     *
+     * Arithmetic used to estimate the interference
+     */
+    Precision _precision;
+
+    /*!
+     * \property NoiseReduction:_samplesSinceRetune
+     *
+     * Samples processed since the weights were last retuned
+     */
+    int _samplesSinceRetune;
+
+    /*!
+     * \property NoiseReduction:_historyTimestamps
+     *
+     * Timestamps of the samples of _history
+     */
+    unsigned long long _historyTimestamps[NOISE_HISTORY_LEN];
+
+    /*!
+     * \property NoiseReduction:_historyRepeated
+     *
+     * Repeated flags of the samples of _history
+     */
+    bool _historyRepeated[NOISE_HISTORY_LEN];
+
+    /*!
+     * \property NoiseReduction:_samplesPushed
+     *
+     * Number of samples written to _history
+     */
+    unsigned long long _samplesPushed;
+
+    /*!
+     * \property NoiseReduction:_nextOutput
+     *
+     * Index of the next sample to deliver, counted as _samplesPushed
+     */
+    unsigned long long _nextOutput;
+
+    /*!
+     * \property NoiseReduction:_latencyBudget
      *
-     * FIFO Buffer where the data stored and where the denoising algorrithm is applied
+     * Maximum delay of the denoised samples in samples
      */
-    QVector <double> _Buffer[32];
+    int _latencyBudget;
 
     /*!
-     * \property NoiseReduction:_BufferDenoise
+     * \property NoiseReduction:_historyHead
      *
-     * Buffer where the denoised data is stored
+     * Row of _history where the next sample is written
      */
-    QVector <double> _BufferDenoised[32];
+    int _historyHead;
 
 };
 
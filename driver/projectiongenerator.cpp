@@ -0,0 +1,132 @@
+#include "projectiongenerator.h"
+#include "noisereduction.h"
+
+#include <QMutexLocker>
+#include <math.h>
+
+QList<ProjectionGenerator::Entry> ProjectionGenerator::_cache;
+QMutex ProjectionGenerator::_mutex;
+
+double** ProjectionGenerator::matrix (double sampleRate, double fundamental, unsigned int harmonics)
+{
+    QMutexLocker locker(&_mutex);
+
+    for (int i = 0; i < _cache.size(); i++)
+    {
+        const Entry &entry = _cache.at(i);
+        if (entry.sampleRate == sampleRate && entry.fundamental == fundamental && entry.harmonics == harmonics)
+            return entry.matrix;
+    }
+
+    Entry entry;
+    entry.sampleRate  = sampleRate;
+    entry.fundamental = fundamental;
+    entry.harmonics   = harmonics;
+    entry.len         = windowLength(sampleRate, fundamental);
+    entry.matrix      = generate(sampleRate, fundamental, harmonics, entry.len);
+    _cache.append(entry);
+
+    return entry.matrix;
+}
+
+uint32_t ProjectionGenerator::windowLength (double sampleRate, double fundamental)
+{
+    double period = sampleRate / fundamental;
+
+    for (uint32_t len = PROJECTION_MIN_LEN; len <= PROJECTION_MAX_LEN; len++)
+    {
+        double periods = len / period;
+        if (fabs(periods - floor(periods + 0.5)) < PROJECTION_PERIOD_TOL * len)
+            return len;
+    }
+
+    // No window holds a whole number of periods, take about two of them
+    uint32_t len = (uint32_t) floor(2.0 * period + 0.5);
+    if (len < PROJECTION_MIN_LEN)
+        len = PROJECTION_MIN_LEN;
+    if (len > PROJECTION_MAX_LEN)
+        len = PROJECTION_MAX_LEN;
+    return len;
+}
+
+double** ProjectionGenerator::generate (double sampleRate, double fundamental, unsigned int harmonics, uint32_t len)
+{
+    if (len > PROJECTION_MAX_LEN)
+        len = PROJECTION_MAX_LEN;
+
+    // Orthonormal basis of the interference space, one row per vector
+    double basis[2*32][PROJECTION_MAX_LEN];
+    int rank = 0;
+
+    for (int h = 1; h <= 32; h++)
+    {
+        if (!(harmonics & (1u << (h - 1))))
+            continue;
+
+        double frequency = fundamental * h;
+        if (frequency >= sampleRate / 2)
+            break;
+
+        // The interference space must leave most of the window to the
+        // signal, otherwise the projection removes it
+        if (2 * (rank + 2) > (int) len)
+        {
+            qDebug() << "Projection window of" << len << "samples too short for harmonic" << h;
+            break;
+        }
+
+        for (int phase = 0; phase < 2; phase++)
+        {
+            double *v = basis[rank];
+            for (uint32_t i = 0; i < len; i++)
+            {
+                double angle = 2.0 * PI * frequency * i / sampleRate;
+                v[i] = (phase == 0) ? cos(angle) : sin(angle);
+            }
+            double norm0 = sqrt(dot_product(v, v, len));
+
+            // Modified Gram-Schmidt, repeated once to recover the
+            // orthogonality lost to rounding
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (int k = 0; k < rank; k++)
+                {
+                    double projection = dot_product(basis[k], v, len);
+                    for (uint32_t i = 0; i < len; i++)
+                        v[i] -= projection * basis[k][i];
+                }
+            }
+
+            double norm = sqrt(dot_product(v, v, len));
+            if (norm <= PROJECTION_RANK_TOL * norm0 || norm0 == 0.0)
+                continue;
+
+            for (uint32_t i = 0; i < len; i++)
+                v[i] /= norm;
+            rank++;
+        }
+    }
+
+    double **matrix = CreateMatrix(len, len);
+    for (uint32_t row = 0; row < len; row++)
+    {
+        for (uint32_t col = 0; col < len; col++)
+        {
+            double acum = 0.0;
+            for (int k = 0; k < rank; k++)
+                acum += basis[k][row] * basis[k][col];
+            matrix[row][col] = acum;
+        }
+    }
+
+    return matrix;
+}
+
+void ProjectionGenerator::clear ()
+{
+    QMutexLocker locker(&_mutex);
+
+    for (int i = 0; i < _cache.size(); i++)
+        FreeMatrix(_cache.at(i).matrix, _cache.at(i).len, _cache.at(i).len);
+    _cache.clear();
+}
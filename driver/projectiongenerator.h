@@ -0,0 +1,110 @@
+#ifndef PROJECTIONGENERATOR_H
+#define PROJECTIONGENERATOR_H
+
+#include <QList>
+#include <QMutex>
+#include <stdint.h>
+
+#define PROJECTION_MAX_LEN          (64)      // Maximum dimension of a projection operator
+#define PROJECTION_MIN_LEN          (20)      // Minimum window of a generated operator
+#define PROJECTION_PERIOD_TOL       (1e-9)    // Tolerance to consider a window a whole number of periods
+#define PROJECTION_RANK_TOL         (1e-9)    // Relative norm below which a tone adds no dimension
+
+// Harmonic sets are organised at bit level, the least significant bit
+// corresponds to the fundamental
+#define LINE_HARMONICS_FUNDAMENTAL  (0x01)
+#define LINE_HARMONICS_DEFAULT      (0x07)    // Fundamental, 2nd and 3rd harmonics
+
+/*!
+ * \class ProjectionGenerator projectiongenerator.h
+ *
+ * \brief This class generates the operators that project a window of
+ * samples onto the space of the power-line interference: the sines and
+ * cosines of a fundamental frequency and a set of its harmonics. The basis
+ * of every tone is orthonormalised with the modified Gram-Schmidt process
+ * and the operator is the sum of the outer products of the basis, so all
+ * the harmonics are cancelled together by a single projection.
+ *
+ * The window is the shortest one of at least PROJECTION_MIN_LEN samples
+ * holding a whole number of periods of the fundamental, which makes the
+ * operator circulant. The operators are cached per sample rate,
+ * fundamental and harmonic set, and shared by all their users.
+ */
+class ProjectionGenerator
+{
+public:
+
+    /*!
+     * It returns the projection operator of a harmonic set, generating it
+     * the first time it is requested. It is a square matrix of
+     * windowLength() rows, owned by the cache and valid until clear() is
+     * called.
+     *
+     * \param sampleRate Sample rate of the signal in Hz
+     *
+     * \param fundamental Fundamental frequency of the interference in Hz
+     *
+     * \param harmonics Harmonics cancelled, organised at bit level
+     */
+    static double** matrix (double sampleRate, double fundamental, unsigned int harmonics);
+
+    /*!
+     * It returns the window length of the operators of a fundamental
+     *
+     * \param sampleRate Sample rate of the signal in Hz
+     *
+     * \param fundamental Fundamental frequency of the interference in Hz
+     */
+    static uint32_t windowLength (double sampleRate, double fundamental);
+
+    /*!
+     * It generates the projection operator of a harmonic set. Harmonics at
+     * or above the Nyquist frequency are left out.
+     *
+     * \param sampleRate Sample rate of the signal in Hz
+     *
+     * \param fundamental Fundamental frequency of the interference in Hz
+     *
+     * \param harmonics Harmonics cancelled, organised at bit level
+     *
+     * \param len Window length, at most PROJECTION_MAX_LEN
+     *
+     * \return Matrix created with CreateMatrix, to be freed by the caller
+     */
+    static double** generate (double sampleRate, double fundamental, unsigned int harmonics, uint32_t len);
+
+    /*!
+     * It deletes all the cached operators
+     */
+    static void clear ();
+
+private:
+
+    /*!
+     * Cached operator
+     */
+    struct Entry
+    {
+        double sampleRate;
+        double fundamental;
+        unsigned int harmonics;
+        uint32_t len;
+        double **matrix;
+    };
+
+    /*!
+     * \property ProjectionGenerator::_cache
+     *
+     * Operators generated so far
+     */
+    static QList<Entry> _cache;
+
+    /*!
+     * \property ProjectionGenerator::_mutex
+     *
+     * It protects _cache
+     */
+    static QMutex _mutex;
+};
+
+#endif // PROJECTIONGENERATOR_H
@@ -0,0 +1,221 @@
+#ifndef SAMPLEBLOCK_H
+#define SAMPLEBLOCK_H
+
+#include "channeldata.h"
+
+#define SAMPLE_BLOCK_CAPACITY   (32)    // Samples per block, 64 ms at 500 Hz
+#define SAMPLE_BLOCK_CHANNELS   (32)    // Channels stored per sample
+
+/*!
+ * \class SampleBlock
+ *
+ * \brief This class holds a block of consecutive EEG samples of all the
+ * channels. The samples are stored sample-major, so that the values of all
+ * the channels of a sample are contiguous and the processing stages can
+ * vectorise across channels. The channel info is common to the whole block.
+ */
+class SampleBlock
+{
+public:
+    /*!
+     * Default constructor
+     */
+    SampleBlock () : _channelInfo(0), _numOfSamples(0), _hasRawData(false) {}
+
+    /*!
+     * It removes all the samples of the block
+     */
+    void clear () { _numOfSamples = 0; }
+
+    /*!
+     * It returns the number of samples stored in the block
+     */
+    int numOfSamples () { return _numOfSamples; }
+
+    /*!
+     * It sets the number of valid samples of the block
+     */
+    void setNumOfSamples (int value) { _numOfSamples = (value > SAMPLE_BLOCK_CAPACITY) ? SAMPLE_BLOCK_CAPACITY : value; }
+
+    /*!
+     * It returns the maximum number of samples of the block
+     */
+    int capacity () { return SAMPLE_BLOCK_CAPACITY; }
+
+    /*!
+     * It returns whether the block is full
+     */
+    bool isFull () { return _numOfSamples == SAMPLE_BLOCK_CAPACITY; }
+
+    /*!
+     * It returns the channels reported in the block, organised at bit level
+     * as in ChannelData::channelInfo()
+     */
+    unsigned int channelInfo () { return _channelInfo; }
+
+    /*!
+     * It sets the channels reported in the block
+     */
+    void setChannelInfo (unsigned int channelInfo) { _channelInfo = channelInfo; }
+
+    /*!
+     * It returns the pointer to the values of all the channels of a sample
+     *
+     * \param index 0-based sample index
+     */
+    int * sample (int index) { return _data[index]; }
+
+    /*!
+     * It returns whether all the samples of the block carry the values sent
+     * by the device besides the ones in physical units
+     */
+    bool hasRawData () { return _hasRawData; }
+
+    /*!
+     * It indicates whether the raw values are valid. It must be cleared by
+     * any stage that changes the values in physical units.
+     */
+    void setHasRawData (bool value) { _hasRawData = value; }
+
+    /*!
+     * It returns the pointer to the values sent by the device for all the
+     * channels of a sample, as signed ADC counts
+     *
+     * \param index 0-based sample index
+     */
+    int * rawSample (int index) { return _rawData[index]; }
+
+    /*!
+     * It returns the timestamp of a sample
+     */
+    unsigned long long timestamp (int index) { return _timeStamps[index]; }
+
+    /*!
+     * It sets the timestamp of a sample
+     */
+    void setTimestamp (int index, unsigned long long value) { _timeStamps[index] = value; }
+
+    /*!
+     * It returns whether a sample is a repeated one due to packet loss
+     */
+    bool isRepeated (int index) { return _isRepeated[index]; }
+
+    /*!
+     * It indicates whether a sample is a repeated one due to packet loss
+     */
+    void setRepeated (int index, bool value) { _isRepeated[index] = value; }
+
+    /*!
+     * It appends a sample at the end of the block
+     *
+     * \return false if the block was already full
+     */
+    bool append (ChannelData &data)
+    {
+        if (_numOfSamples == SAMPLE_BLOCK_CAPACITY)
+            return false;
+
+        if (_numOfSamples == 0)
+        {
+            _channelInfo = data.channelInfo();
+            _hasRawData = data.hasRawData();
+        }
+        else if (!data.hasRawData())
+        {
+            _hasRawData = false;
+        }
+
+        int *values = data.data();
+        int *row = _data[_numOfSamples];
+        for (int i = 0; i < SAMPLE_BLOCK_CHANNELS; i++)
+            row[i] = values[i];
+        if (_hasRawData)
+        {
+            int *rawValues = data.rawData();
+            int *rawRow = _rawData[_numOfSamples];
+            for (int i = 0; i < SAMPLE_BLOCK_CHANNELS; i++)
+                rawRow[i] = rawValues[i];
+        }
+        _timeStamps[_numOfSamples] = data.timestamp();
+        _isRepeated[_numOfSamples] = data.isRepeated();
+        _numOfSamples++;
+        return true;
+    }
+
+    /*!
+     * It returns a sample of the block as a ChannelData
+     *
+     * \param index 0-based sample index
+     */
+    ChannelData channelData (int index)
+    {
+        ChannelData data;
+        data.setChannelInfo(_channelInfo);
+        for (int i = 0; i < SAMPLE_BLOCK_CHANNELS; i++)
+        {
+            data.setData(i, _data[index][i]);
+            data.setCompressionOverflow(i, false);
+        }
+        if (_hasRawData)
+        {
+            for (int i = 0; i < SAMPLE_BLOCK_CHANNELS; i++)
+                data.setRawData(i, _rawData[index][i]);
+        }
+        data.setHasRawData(_hasRawData);
+        data.setTimestamp(_timeStamps[index]);
+        data.setRepeated(_isRepeated[index]);
+        return data;
+    }
+
+private:
+    /*!
+     * \property SampleBlock::_channelInfo
+     *
+     * Channels reported in the block
+     */
+    unsigned int _channelInfo;
+
+    /*!
+     * \property SampleBlock::_numOfSamples
+     *
+     * Number of valid samples in the block
+     */
+    int _numOfSamples;
+
+    /*!
+     * \property SampleBlock::_data
+     *
+     * Values of the samples, one row per sample
+     */
+    int _data[SAMPLE_BLOCK_CAPACITY][SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     * \property SampleBlock::_rawData
+     *
+     * Values sent by the device, one row per sample
+     */
+    int _rawData[SAMPLE_BLOCK_CAPACITY][SAMPLE_BLOCK_CHANNELS];
+
+    /*!
+     * \property SampleBlock::_hasRawData
+     *
+     * Whether _rawData holds the values of all the samples
+     */
+    bool _hasRawData;
+
+    /*!
+     * \property SampleBlock::_timeStamps
+     *
+     * Timestamp of every sample
+     */
+    unsigned long long _timeStamps[SAMPLE_BLOCK_CAPACITY];
+
+    /*!
+     * \property SampleBlock::_isRepeated
+     *
+     * Whether every sample is repeated to compensate for packet loss
+     */
+    bool _isRepeated[SAMPLE_BLOCK_CAPACITY];
+};
+
+#endif // SAMPLEBLOCK_H
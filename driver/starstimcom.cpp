@@ -2,7 +2,9 @@
 
 
 StarstimCom::StarstimCom(QObject* parent) :
-    _samplesPerBeacon(1)
+    _samplesPerBeacon(1),
+    _isEEGBlockFlushPending(0),
+    _isEEGBlocksEnabled(0)
 {
     _deviceType   = DeviceManagerTypes::ENOBIO;
     _numOfChannels = 8;
@@ -168,9 +170,18 @@ void StarstimCom::runPoll(){
 
     loggerMacroDebug("Running poll thread ...")
 
+#ifdef COUNT_HEAP_ALLOCATIONS
+    AllocationCounter::setCurrentThreadCounted(true);
+    AllocationCounter::reset();
+#endif
+
     // Run the poll function
     _poll();
 
+#ifdef COUNT_HEAP_ALLOCATIONS
+    AllocationCounter::setCurrentThreadCounted(false);
+#endif
+
     // Return _wifiDevice to its original thread
     _wifiDevice->moveToThread(formerThread);
     moveToThread(formerThread);
@@ -211,8 +222,10 @@ int StarstimCom::_poll(){
     qDebug() << QThread::currentThreadId();
 
 
-    // Initialise to no operation pending
-    sharedTxBuffer.clear();
+    // Initialise to no operation pending. The capacity is reserved once so
+    // that the requests reuse the same storage.
+    sharedTxBuffer.reserve(MAX_LENGTH_TX_BUFFER);
+    sharedTxBuffer.resize(0);
 
     _beaconCounterStayAlive = 0;
 
@@ -234,7 +247,7 @@ int StarstimCom::_poll(){
             if( sharedTxBuffer.size() > 0 ){
                 //loggerMacroDebug("Writing command")
                 _wifiDevice->write((char*)sharedTxBuffer.data(), sharedTxBuffer.size());
-                sharedTxBuffer.clear();
+                sharedTxBuffer.resize(0);
             }
 
 
@@ -271,6 +284,12 @@ int StarstimCom::_poll(){
 
         // Evaluate wheter data was received
         int processDataResult = _processData();
+
+        // Once the streaming is stopped and the samples in flight have
+        // been received, the partial block is delivered
+        if (processDataResult <= 0 && _isEEGBlockFlushPending.testAndSetOrdered(1, 0))
+            _flushEEGBlock();
+
         if (processDataResult > 0){
             // Instrument is still there!
             if (monitorTimer.elapsed()>=4000){
@@ -305,6 +324,7 @@ int StarstimCom::_poll(){
                 _deviceStatusStruct.set( _deviceStatus, false, false );
                 emit receivedDeviceStatus( _deviceStatusStruct );
                 loggerMacroDebug("Device lost. Finishing _poll thread. Where is your device?")
+                _flushEEGBlock();
                 return -1;
             }
 
@@ -312,6 +332,9 @@ int StarstimCom::_poll(){
 
     }
 
+    // Samples of the last block when the device is closed
+    _flushEEGBlock();
+
     loggerMacroDebug("Stopped poll thread")
     return 0;
 }
@@ -346,7 +369,9 @@ int StarstimCom::_processData (int nBytes)
 
 //        // ---------------------------------
 
-        // NOTE: Keep it for debug purposes
+        // NOTE: Keep it for debug purposes. It builds a string for every
+        // read, so it is only compiled on demand.
+#ifdef DEBUG_FRAME_CONTENTS
         QString aux = "Frame contents: ";
         QString str;
         for (int i = 0; i < nBytesRead; i++){
@@ -362,10 +387,10 @@ int StarstimCom::_processData (int nBytes)
             aux+= str.sprintf("0x%02X ", value );
 
         }
-/**/
-//        if( _waitingFirstEEGSample == false)
-//          if( nBytesRead != 0 )
-//            qDebug()<<aux;
+        if( _waitingFirstEEGSample == false)
+          if( nBytesRead != 0 )
+            qDebug()<<aux;
+#endif
 //        // ---------------------------------
 
         // Indicate that operation was ok!
@@ -386,9 +411,7 @@ int StarstimCom::_processData (int nBytes)
                 _beaconCounterStayAlive++;
                 StarstimData * data = _protocol.getStarStimData();
                 if (data->isCommandToggled()){
-                    QtMessageHandler message = qInstallMessageHandler(0);
-                    loggerMacroDebug("Got acknowledge")
-                    qInstallMessageHandler(message);
+                    LOG_DEBUG(LOG_DRIVER, "Got acknowledge")
                     _beaconCounterStayAlive = 0;
 
                     // Operation is done
@@ -444,7 +467,7 @@ int StarstimCom::_processData (int nBytes)
                     }else{
                         // Processes the EEG data given the fact that between packets has been diff
                         this->_eegProcessing(data, diff);
-                        if( diff != _sampleRate ) loggerMacroDebug("Some packets were lost diff:" + QString::number(diff))
+                        if( diff != _sampleRate ) LOG_DEBUG_EVERY_N(LOG_DRIVER, 100, "Some packets were lost diff:" << diff)
                     }
 
                 } // END: data->isEEGDataPresent()
@@ -629,7 +652,16 @@ int StarstimCom::_timestampAnalysis(StarstimData * data){
         if (_countPacketsPer30Seconds>=SAMPLES_PER_SECOND*30) //We check packet loss each 15000 packets (30 seconds)
         {
             if (_countPacketsLostPer30Seconds>0)
-                qDebug()<<"DeviceManager percentage of packets lost"<<_countPacketsLostPer30Seconds<<_countPacketsPer30Seconds<<_countPacketsLostPer30Seconds*100.0/_countPacketsPer30Seconds;
+                LOG_INFO(LOG_DRIVER, "DeviceManager percentage of packets lost"<<_countPacketsLostPer30Seconds<<_countPacketsPer30Seconds<<_countPacketsLostPer30Seconds*100.0/_countPacketsPer30Seconds)
+#ifdef COUNT_HEAP_ALLOCATIONS
+            // Only the poll thread is counted. The frame and sample buffers
+            // are reused, what is left are mostly the events of the queued
+            // signals carrying the samples to the other threads
+            int nAllocations = AllocationCounter::count();
+            LOG_INFO(LOG_DRIVER, "Poll thread heap allocations during the last 30 seconds:" << nAllocations
+                     << "per sample:" << (double) nAllocations / _countPacketsPer30Seconds)
+            AllocationCounter::reset();
+#endif
 //            if (_countPacketsOverflowPer30Seconds>0)
 //            qDebug()<<"DeviceManager percentage of packets overflow"<<_countPacketsOverflowPer30Seconds<<_countPacketsPer30Seconds<<_countPacketsOverflowPer30Seconds*100.0/_countPacketsPer30Seconds;
 
@@ -650,10 +682,11 @@ int StarstimCom::_timestampAnalysis(StarstimData * data){
 
 void StarstimCom::_eegProcessing(StarstimData * data, int nLostPacket){
 
-    // Convert rawEEG to nV
-    int rawEEG[32];
+    // Convert rawEEG to nV, the counts are kept for the sinks writing them
     for(int j = 0; j < data->eegDataArray().count(); j++){
-        int* dataEEG = data->eegDataArray()[j].data();
+        ChannelData &sample = data->eegDataArray()[j];
+        int* dataEEG = sample.data();
+        int* rawEEG = sample.rawData();
         for (int i=0; i<32;i++)
         {
             if (dataEEG[i] >=0x800000 )
@@ -667,6 +700,7 @@ void StarstimCom::_eegProcessing(StarstimData * data, int nLostPacket){
                                                 8388607.0 / 6.0;
 
         }
+        sample.setHasRawData(true);
 
 //        QString str = "decom dataEEG" + QString::number(j) + " ";
 //        QString aux;
@@ -677,6 +711,12 @@ void StarstimCom::_eegProcessing(StarstimData * data, int nLostPacket){
 
     }
 
+    // Blocks are only filled when a consumer has enabled them. The samples
+    // gathered before they were disabled are delivered
+    bool isBlockEnabled = _isEEGBlocksEnabled.loadAcquire() != 0;
+    if (!isBlockEnabled)
+        _flushEEGBlock();
+
     // Emit nLostPacket packets
     while(nLostPacket > 1){
 
@@ -687,6 +727,8 @@ void StarstimCom::_eegProcessing(StarstimData * data, int nLostPacket){
             _lastEEGData.setTimestamp(_currentEEGTimestamp);
             _lastEEGData.setRepeated(true);
             emit receivedEEGData(_lastEEGData);
+            if (isBlockEnabled)
+                _appendToEEGBlock(_lastEEGData);
         }
         nLostPacket--;
     }
@@ -700,14 +742,42 @@ void StarstimCom::_eegProcessing(StarstimData * data, int nLostPacket){
         _lastEEGData.setTimestamp(_currentEEGTimestamp);
         _lastEEGData.setRepeated(false);
         emit receivedEEGData(_lastEEGData);
+        if (isBlockEnabled)
+            _appendToEEGBlock(_lastEEGData);
     }
 
 
     if( _lastEEGData.isRepeated() ){
-        loggerMacroDebug("Packet is repeated!")
+        LOG_DEBUG_EVERY_N(LOG_DRIVER, 100, "Packet is repeated!")
     }
 }
 
+void StarstimCom::_appendToEEGBlock(ChannelData &data){
+
+    // A block holds a single channel configuration
+    if (_eegBlock.numOfSamples() > 0 && _eegBlock.channelInfo() != (unsigned int) data.channelInfo())
+        _flushEEGBlock();
+
+    _eegBlock.append(data);
+    if (_eegBlock.isFull())
+        _flushEEGBlock();
+}
+
+void StarstimCom::_flushEEGBlock(){
+
+    if (_eegBlock.numOfSamples() == 0)
+        return;
+
+    emit receivedEEGBlock(_eegBlock);
+    _eegBlock.clear();
+}
+
+void StarstimCom::setEEGBlocksEnabled(bool enabled){
+
+    _isEEGBlocksEnabled.storeRelease(enabled ? 1 : 0);
+    LOG_DEBUG(LOG_DRIVER, "EEG blocks" << (enabled ? "ENABLED" : "DISABLED"))
+}
+
 //////////////////////////////////////////
 // Request operations
 //////////////////////////////////////////
@@ -730,7 +800,11 @@ bool StarstimCom::request(DeviceManagerTypes::StarstimRequest request, DeviceMan
         _firstTimestampRequest = QDateTime::currentMSecsSinceEpoch();
         txBuffer = StarStimProtocol::buildStartEEGFrame();
     }
-    if (request == DeviceManagerTypes::STOP_STREAMING_REQUEST)  txBuffer = StarStimProtocol::buildStopEEGFrame();
+    if (request == DeviceManagerTypes::STOP_STREAMING_REQUEST){
+        // The poll thread delivers the partial EEG block
+        _isEEGBlockFlushPending.store(1);
+        txBuffer = StarStimProtocol::buildStopEEGFrame();
+    }
 
 
     // RW Fields request
@@ -808,7 +882,7 @@ bool StarstimCom::request(DeviceManagerTypes::StarstimRequest request, DeviceMan
     }
 
     // Add new command to sharedTxBuffer
-    sharedTxBuffer.clear();
+    sharedTxBuffer.resize(0);
     sharedTxBuffer.append(txBuffer);
     sync.unlock();
     // --------------------------------------------------------------
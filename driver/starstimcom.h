@@ -3,10 +3,12 @@
 
 #define MAX_N_REGISTER         65536  // [bytes] maximum number of registers in a single bank
 #define MAX_LENGTH_RX_BUFFER   2048   // [bytes] maximum length of read operation
+#define MAX_LENGTH_TX_BUFFER   256    // [bytes] capacity reserved for the request frames
 #define SAMPLES_PER_SECOND     500
 
 // Qt includes
 #include <QObject>
+#include <QAtomicInt>
 #include <QElapsedTimer>
 #include <QMutex>
 #include <QWaitCondition>
@@ -19,6 +21,8 @@
 #include "icognosprotocol.h"
 #include "icognosregister.h"
 #include "devicemanagertypes.h"
+#include "allocationcounter.h"
+#include "sampleblock.h"
 #include "fw/eeg_mgr.h"
 #include "fw/stim_mgr.h"
 #include "fw/accel_mgr.h"
@@ -136,6 +140,22 @@ public:
                  DeviceManagerTypes::StarstimRegisterFamily family = DeviceManagerTypes::EEG_REGISTERS,
                  int address = 0, QByteArray frame = QByteArray());
 
+    /*!
+     * It enables or disables the building of the EEG blocks emitted through
+     * receivedEEGBlock. It is disabled by default, so that the poll thread
+     * only copies the samples into blocks once a block consumer, e.g.
+     * NoiseReduction::onNewBlock, has been connected. It can be called from
+     * any thread; when disabled the partial block is still delivered.
+     *
+     * \param enabled True to start emitting blocks, false to stop it
+     */
+    void setEEGBlocksEnabled(bool enabled);
+
+    /*!
+     * It returns whether the EEG blocks are being built
+     */
+    bool isEEGBlocksEnabled() { return _isEEGBlocksEnabled.load() != 0; }
+
 private:
 
 
@@ -345,6 +365,30 @@ private:
      */
     ChannelData _lastEEGData;
 
+    /*!
+     * \property StarstimCom::_eegBlock
+     *
+     * Block of EEG samples being filled, it is emitted through
+     * receivedEEGBlock when full
+     */
+    SampleBlock _eegBlock;
+
+    /*!
+     * \property StarstimCom::_isEEGBlockFlushPending
+     *
+     * Whether the streaming was stopped and the partial _eegBlock has not
+     * been emitted yet
+     */
+    QAtomicInt _isEEGBlockFlushPending;
+
+    /*!
+     * \property StarstimCom::_isEEGBlocksEnabled
+     *
+     * Whether the samples are gathered in _eegBlock, set through
+     * setEEGBlocksEnabled()
+     */
+    QAtomicInt _isEEGBlocksEnabled;
+
     /*!
      * \property DeviceManager::_lastAccelerometerData
      *
@@ -424,6 +468,17 @@ private:
      */
     void _eegProcessing(StarstimData * data, int diff);
 
+    /*!
+     * It appends an EEG sample to _eegBlock and emits the block when it is
+     * full or when the channels reported change
+     */
+    void _appendToEEGBlock(ChannelData &data);
+
+    /*!
+     * It emits the samples of _eegBlock, if any, even if it is not full
+     */
+    void _flushEEGBlock();
+
 public slots:
 
     /*!
@@ -456,6 +511,16 @@ signals:
      */
     void receivedEEGData(ChannelData data);
 
+    /*!
+     * Signal that is emitted whenever SAMPLE_BLOCK_CAPACITY consecutive EEG
+     * samples are received, only while enabled through
+     * setEEGBlocksEnabled(). The samples are also emitted one by one through
+     * receivedEEGData.
+     *
+     * \param block The new received samples
+     */
+    void receivedEEGBlock(SampleBlock block);
+
 
     /*!
      * Signal that is emitted reporting the new accelerometer data
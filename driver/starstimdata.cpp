@@ -164,18 +164,19 @@ void StarstimData::eegData(int index, int value, int sample, int eegCompressionT
 void StarstimData::nSamples(int value){
     this->_nSamples = value;
 
-    _eegDataArray.clear();
-    ChannelData channelData;
-    channelData.setChannelInfo(0);
-    for (int i = 0; i < 32; i++)
-    {
-        channelData.data()[i] = 0;
-        channelData.compressionOverflow()[i] = false;
-    }
-
-
-    for(int i = 0; i< _nSamples; i++){
-        _eegDataArray.append(channelData);
+    // The samples are reset in place, the storage is only reallocated
+    // when the number of samples per frame grows
+    if (_eegDataArray.size() != _nSamples)
+        _eegDataArray.resize(_nSamples);
+
+    for(int j = 0; j < _nSamples; j++){
+        ChannelData& channelData = _eegDataArray[j];
+        channelData.setChannelInfo(0);
+        for (int i = 0; i < 32; i++)
+        {
+            channelData.data()[i] = 0;
+            channelData.compressionOverflow()[i] = false;
+        }
     }
 
 }
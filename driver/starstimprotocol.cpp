@@ -270,8 +270,6 @@ bool StarStimProtocol::_transitionToNextBlock ()
 bool StarStimProtocol::parseByte (unsigned char byte)
 {
 
-    QString debugString = "";
-
     int auxArtifactCorrector;
 
     /* JUST WHILE DEVELOPING ****/
@@ -790,6 +788,7 @@ bool StarStimProtocol::parseByte (unsigned char byte)
 #ifdef __DEBUGARTIFACTENOBIO20PROTOCOL__
             if (_starStimData.deviceStatus() & 0x02)
             {
+                QString debugString;
                 for (unsigned int k = 0; k < _debugErrorFrameIndex; k++)
                 {
                     debugString.append(" ");
@@ -838,13 +837,17 @@ bool StarStimProtocol::parseByte (unsigned char byte)
             return true;
         }
 
-
-        for (unsigned int k = 0; k < _debugErrorFrameIndex; k++)
+        // Only built for the frames with errors that are written
+        if (LOG_IS_ENABLED(LOG_LEVEL_WARNING, LOG_PROTOCOL))
         {
-            QString aux;
-            debugString.append(aux.sprintf(" 0x%02X", _debugErrorFrame[k]));
+            QString debugString;
+            for (unsigned int k = 0; k < _debugErrorFrameIndex; k++)
+            {
+                QString aux;
+                debugString.append(aux.sprintf(" 0x%02X", _debugErrorFrame[k]));
+            }
+            LOG_WARNING(LOG_PROTOCOL, "Frame with errors: byte"<<byte<<"nBytes" << _nBytes << "_dataLength"<<_dataLength << "_state"<<_state << "\n" << debugString)
         }
-        qDebug() << "Frame with errors: byte"<<byte<<"nBytes" << _nBytes << "_dataLength"<<_dataLength << "_state"<<_state << "\n" << debugString;
         _debugErrorFrameIndex = 0;
         break;
     }
@@ -0,0 +1,190 @@
+#include "taskpool.h"
+
+#include <QMutexLocker>
+
+TaskPool *TaskPool::_instance = 0;
+QMutex TaskPool::_instanceMutex;
+
+TaskPool::TaskPool (int numOfThreads) :
+    _nextQueue(0),
+    _numOfQueued(0),
+    _isRunning(1)
+{
+    // The thread calling run() works too
+    if (numOfThreads <= 0)
+        numOfThreads = QThread::idealThreadCount() - 1;
+    if (numOfThreads < 0)
+        numOfThreads = 0;
+
+    _queues = new Queue[(numOfThreads > 0) ? numOfThreads : 1];
+    for (int i = 0; i < numOfThreads; i++)
+    {
+        _queues[i].head = 0;
+        _queues[i].tail = 0;
+        _workers.append(new Worker(this, i));
+    }
+
+    for (int i = 0; i < _workers.size(); i++)
+        _workers[i]->start();
+}
+
+TaskPool::~TaskPool ()
+{
+    _isRunning.store(0);
+    {
+        QMutexLocker locker(&_idleMutex);
+        _wakeUp.wakeAll();
+    }
+
+    for (int i = 0; i < _workers.size(); i++)
+    {
+        _workers[i]->wait();
+        delete _workers[i];
+    }
+
+    delete[] _queues;
+}
+
+TaskPool* TaskPool::instance ()
+{
+    QMutexLocker locker(&_instanceMutex);
+    if (_instance == 0)
+        _instance = new TaskPool();
+    return _instance;
+}
+
+void TaskPool::run (TaskFunction function, void *context, int numOfTasks)
+{
+    const int numOfQueues = _workers.size();
+    if (numOfQueues == 0 || numOfTasks <= 1)
+    {
+        for (int i = 0; i < numOfTasks; i++)
+            function(context, i);
+        return;
+    }
+
+    Batch batch;
+    batch.function = function;
+    batch.context = context;
+    batch.remaining.store(numOfTasks);
+
+    // The first task is kept for the calling thread, the rest are dealt out
+    // round-robin. A task that does not fit is executed here.
+    unsigned int first = (unsigned int) _nextQueue.fetchAndAddRelaxed(1);
+    for (int i = 1; i < numOfTasks; i++)
+    {
+        Task task = { &batch, i };
+        if (!_push((first + i) % numOfQueues, task))
+            _execute(task);
+    }
+
+    {
+        QMutexLocker locker(&_idleMutex);
+        _wakeUp.wakeAll();
+    }
+
+    Task task = { &batch, 0 };
+    _execute(task);
+
+    // Barrier: help with the queued tasks, then sleep until the workers
+    // finish the ones they took
+    while (batch.remaining.loadAcquire() > 0 && _take(first % numOfQueues, task))
+        _execute(task);
+
+    QMutexLocker locker(&batch.mutex);
+    while (batch.remaining.loadAcquire() > 0)
+        batch.finished.wait(&batch.mutex);
+}
+
+void TaskPool::_work (int id)
+{
+    Task task;
+    while (_isRunning.load())
+    {
+        if (_take(id, task))
+        {
+            _execute(task);
+            continue;
+        }
+
+        // The queued count is checked with the mutex held, so a batch queued
+        // meanwhile wakes the worker up
+        QMutexLocker locker(&_idleMutex);
+        if (_numOfQueued.load() == 0 && _isRunning.load())
+            _wakeUp.wait(&_idleMutex);
+    }
+}
+
+bool TaskPool::_push (int queue, const Task &task)
+{
+    Queue &q = _queues[queue];
+    QMutexLocker locker(&q.mutex);
+
+    if (q.tail - q.head == TASK_POOL_QUEUE_CAPACITY)
+        return false;
+
+    q.tasks[q.tail & (TASK_POOL_QUEUE_CAPACITY - 1)] = task;
+    q.tail++;
+    _numOfQueued.fetchAndAddRelaxed(1);
+    return true;
+}
+
+bool TaskPool::_pop (int queue, Task &task)
+{
+    Queue &q = _queues[queue];
+    QMutexLocker locker(&q.mutex);
+
+    if (q.tail == q.head)
+        return false;
+
+    q.tail--;
+    task = q.tasks[q.tail & (TASK_POOL_QUEUE_CAPACITY - 1)];
+    _numOfQueued.fetchAndAddRelaxed(-1);
+    return true;
+}
+
+bool TaskPool::_steal (int queue, Task &task)
+{
+    Queue &q = _queues[queue];
+    QMutexLocker locker(&q.mutex);
+
+    if (q.tail == q.head)
+        return false;
+
+    task = q.tasks[q.head & (TASK_POOL_QUEUE_CAPACITY - 1)];
+    q.head++;
+    _numOfQueued.fetchAndAddRelaxed(-1);
+    return true;
+}
+
+bool TaskPool::_take (int first, Task &task)
+{
+    if (_numOfQueued.load() == 0)
+        return false;
+
+    if (_pop(first, task))
+        return true;
+
+    const int numOfQueues = _workers.size();
+    for (int i = 1; i < numOfQueues; i++)
+    {
+        if (_steal((first + i) % numOfQueues, task))
+            return true;
+    }
+    return false;
+}
+
+void TaskPool::_execute (const Task &task)
+{
+    task.batch->function(task.batch->context, task.index);
+
+    // Ordered so that the results of the task are visible to the thread
+    // waiting for the batch. The last task wakes it up with the mutex held,
+    // so the batch is not released before the wake up is done.
+    Batch *batch = task.batch;
+    if (batch->remaining.fetchAndAddOrdered(-1) == 1)
+    {
+        QMutexLocker locker(&batch->mutex);
+        batch->finished.wakeAll();
+    }
+}
@@ -0,0 +1,228 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+
+#define TASK_POOL_QUEUE_CAPACITY    (256)   // Tasks per worker queue, it must be a power of two
+
+/*!
+ * Function executing a task of a batch
+ *
+ * \param context Context given to TaskPool::run
+ *
+ * \param index Index of the task in the batch
+ */
+typedef void (*TaskFunction)(void *context, int index);
+
+/*!
+ * \class TaskPool taskpool.h
+ *
+ * \brief This class runs batches of short independent tasks on a fixed set
+ * of worker threads. Every worker owns a queue; the tasks of a batch are
+ * spread over the queues, each worker takes the newest task of its own
+ * queue and, once it is empty, steals the oldest task of the others, so
+ * the load is balanced without a central queue.
+ *
+ * run() returns when every task of the batch has finished, so it acts as a
+ * barrier: the results of all the tasks are visible to the caller. The
+ * calling thread executes tasks too and, once none is left to take, sleeps
+ * until the last one finishes. Idle workers sleep until a batch is queued.
+ * Several threads can run batches on the same pool at the same time, e.g.
+ * one per device.
+ */
+class TaskPool
+{
+public:
+
+    /*!
+     * Constructor. It starts the workers.
+     *
+     * \param numOfThreads Number of worker threads. With 0 there is one per
+     * core besides the calling thread.
+     */
+    TaskPool (int numOfThreads = 0);
+
+    /*!
+     * Default destructor. It stops the workers; no batch can be running.
+     */
+    virtual ~TaskPool ();
+
+    /*!
+     * It returns the number of worker threads
+     */
+    int numOfThreads () { return _workers.size(); }
+
+    /*!
+     * It executes a batch of tasks and waits until all of them have
+     * finished. The tasks of a batch must not depend on each other.
+     *
+     * \param function Function executing a task
+     *
+     * \param context Context passed to every task
+     *
+     * \param numOfTasks Number of tasks, they are given indices 0 to
+     * numOfTasks - 1
+     */
+    void run (TaskFunction function, void *context, int numOfTasks);
+
+    /*!
+     * It returns the pool shared by all the devices, created the first
+     * time it is requested
+     */
+    static TaskPool* instance ();
+
+private:
+
+    /*!
+     * Tasks of a call to run()
+     */
+    struct Batch
+    {
+        TaskFunction function;
+        void *context;
+        QAtomicInt remaining;       // Tasks not finished yet
+        QMutex mutex;               // It protects the sleep of the caller
+        QWaitCondition finished;    // Signalled by the last task
+    };
+
+    /*!
+     * Queued task
+     */
+    struct Task
+    {
+        Batch *batch;
+        int index;
+    };
+
+    /*!
+     * Queue of a worker. The owner takes from the tail and the thieves from
+     * the head.
+     */
+    struct Queue
+    {
+        QMutex mutex;
+        Task tasks[TASK_POOL_QUEUE_CAPACITY];
+        unsigned int head;
+        unsigned int tail;
+    };
+
+    /*!
+     * Worker thread
+     */
+    class Worker : public QThread
+    {
+    public:
+        Worker (TaskPool *pool, int id) : _pool(pool), _id(id) {}
+
+    protected:
+        void run () { _pool->_work(_id); }
+
+    private:
+        TaskPool *_pool;
+        int _id;
+    };
+
+    /*!
+     * Body of the worker threads
+     *
+     * \param id Index of the queue of the worker
+     */
+    void _work (int id);
+
+    /*!
+     * It queues a task
+     *
+     * \return false when the queue is full
+     */
+    bool _push (int queue, const Task &task);
+
+    /*!
+     * It takes the newest task of a queue
+     */
+    bool _pop (int queue, Task &task);
+
+    /*!
+     * It takes the oldest task of a queue
+     */
+    bool _steal (int queue, Task &task);
+
+    /*!
+     * It takes a task from any queue, starting with the given one
+     */
+    bool _take (int first, Task &task);
+
+    /*!
+     * It executes a task and accounts it in its batch
+     */
+    void _execute (const Task &task);
+
+    /*!
+     * \property TaskPool::_workers
+     *
+     * Worker threads
+     */
+    QVector<Worker*> _workers;
+
+    /*!
+     * \property TaskPool::_queues
+     *
+     * Queue of every worker
+     */
+    Queue *_queues;
+
+    /*!
+     * \property TaskPool::_nextQueue
+     *
+     * Queue receiving the first task of the next batch, it rotates so that
+     * concurrent batches start on different workers
+     */
+    QAtomicInt _nextQueue;
+
+    /*!
+     * \property TaskPool::_numOfQueued
+     *
+     * Number of tasks in the queues
+     */
+    QAtomicInt _numOfQueued;
+
+    /*!
+     * \property TaskPool::_isRunning
+     *
+     * It is cleared to stop the workers
+     */
+    QAtomicInt _isRunning;
+
+    /*!
+     * \property TaskPool::_idleMutex
+     *
+     * It protects the sleep of the idle workers
+     */
+    QMutex _idleMutex;
+
+    /*!
+     * \property TaskPool::_wakeUp
+     *
+     * Condition the idle workers wait on
+     */
+    QWaitCondition _wakeUp;
+
+    /*!
+     * \property TaskPool::_instance
+     *
+     * Pool shared by all the devices
+     */
+    static TaskPool *_instance;
+
+    /*!
+     * \property TaskPool::_instanceMutex
+     *
+     * It protects the creation of _instance
+     */
+    static QMutex _instanceMutex;
+};
+
+#endif // TASKPOOL_H
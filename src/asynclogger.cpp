@@ -0,0 +1,225 @@
+#include "asynclogger.h"
+
+#include <QTime>
+
+#include <stdio.h>
+
+AsyncLogger::AsyncLogger (QFile *file, QObject *parent) :
+    QThread(parent),
+    _enqueuePosition(0),
+    _dequeuePosition(0),
+    _writtenPosition(0),
+    _numOfDropped(0),
+    _isRunning(1),
+    _file(file),
+    _consoleSink(0),
+    _consoleWindowStart(0),
+    _numOfConsoleLines(0),
+    _numOfConsoleSkipped(0)
+{
+    _entries = new Entry[LOG_QUEUE_CAPACITY];
+    for (int i = 0; i < LOG_QUEUE_CAPACITY; i++)
+        _entries[i].sequence.store(i);
+
+    _fileBatch.reserve(LOG_QUEUE_CAPACITY * 64);
+    _stderrBatch.reserve(LOG_QUEUE_CAPACITY * 64);
+
+    _startTimeOfDay = QTime::currentTime().msecsSinceStartOfDay();
+    _timer.start();
+}
+
+AsyncLogger::~AsyncLogger ()
+{
+    stop();
+    delete[] _entries;
+}
+
+bool AsyncLogger::log (QtMsgType type, const QString &msg, bool toConsole)
+{
+    const quint32 mask = LOG_QUEUE_CAPACITY - 1;
+
+    // Claim a slot (Vyukov bounded queue)
+    Entry *entry;
+    quint32 position = _enqueuePosition.load();
+    for (;;)
+    {
+        entry = &_entries[position & mask];
+        qint32 diff = (qint32) (entry->sequence.loadAcquire() - position);
+        if (diff == 0)
+        {
+            if (_enqueuePosition.testAndSetRelaxed(position, position + 1))
+                break;
+            position = _enqueuePosition.load();
+        }
+        else if (diff < 0)
+        {
+            // Queue is full
+            _numOfDropped.fetchAndAddRelaxed(1);
+            return false;
+        }
+        else
+        {
+            position = _enqueuePosition.load();
+        }
+    }
+
+    // Copy the message without any conversion that allocates
+    int length = msg.length();
+    if (length > LOG_ENTRY_MAX_LENGTH)
+        length = LOG_ENTRY_MAX_LENGTH;
+    const QChar *chars = msg.constData();
+    for (int i = 0; i < length; i++)
+        entry->text[i] = chars[i].toLatin1();
+
+    entry->length = length;
+    entry->type = type;
+    entry->toConsole = toConsole;
+    entry->timestamp = _timer.nsecsElapsed();
+
+    // Publish the slot
+    entry->sequence.storeRelease(position + 1);
+    return true;
+}
+
+void AsyncLogger::flush ()
+{
+    quint32 target = _enqueuePosition.load();
+
+    if (!isRunning())
+    {
+        _drain();
+        return;
+    }
+
+    while ((qint32) (target - _writtenPosition.loadAcquire()) > 0)
+        QThread::msleep(1);
+}
+
+void AsyncLogger::stop ()
+{
+    _isRunning.store(0);
+    if (isRunning())
+        wait();
+
+    // Anything queued while stopping
+    _drain();
+}
+
+void AsyncLogger::run ()
+{
+    while (_isRunning.load())
+    {
+        if (_drain() == 0)
+            QThread::msleep(LOG_DRAIN_PERIOD);
+    }
+}
+
+int AsyncLogger::_drain ()
+{
+    QMutexLocker locker(&_drainMutex);
+
+    const quint32 mask = LOG_QUEUE_CAPACITY - 1;
+    int numOfEntries = 0;
+
+    _fileBatch.resize(0);
+    _stderrBatch.resize(0);
+
+    int numOfDropped = _numOfDropped.fetchAndStoreRelaxed(0);
+    if (numOfDropped > 0)
+    {
+        QByteArray line;
+        _appendTime(line, _timer.nsecsElapsed());
+        line.append("Logging queue full, ");
+        line.append(QByteArray::number(numOfDropped));
+        line.append(" messages dropped\n");
+        _fileBatch.append(line);
+        _stderrBatch.append(line);
+    }
+
+    // Only the holder of _drainMutex advances the dequeue position
+    quint32 position = _dequeuePosition.load();
+    for (;;)
+    {
+        Entry *entry = &_entries[position & mask];
+        qint32 diff = (qint32) (entry->sequence.loadAcquire() - (position + 1));
+        if (diff != 0)
+            break;
+
+        int start = _stderrBatch.size();
+        _appendTime(_stderrBatch, entry->timestamp);
+        switch (entry->type)
+        {
+        case QtWarningMsg:  _stderrBatch.append("Warning: "); break;
+        case QtCriticalMsg: _stderrBatch.append("Critical: "); break;
+        case QtFatalMsg:    _stderrBatch.append("FATAL "); break;
+        default: break;
+        }
+        _stderrBatch.append(entry->text, entry->length);
+        _stderrBatch.append('\n');
+
+        // Debug and fatal messages go also to the log file
+        if (entry->type == QtDebugMsg || entry->type == QtFatalMsg)
+            _fileBatch.append(_stderrBatch.constData() + start, _stderrBatch.size() - start);
+
+        if (entry->toConsole)
+            _writeConsole(_stderrBatch.mid(start, _stderrBatch.size() - start - 1), entry->timestamp);
+
+        // Release the slot for the producers
+        entry->sequence.storeRelease(position + mask + 1);
+        position++;
+        numOfEntries++;
+    }
+    _dequeuePosition.store(position);
+
+    // A single write and flush per batch
+    if (_fileBatch.size() > 0 && _file != 0)
+    {
+        _file->write(_fileBatch);
+        _file->flush();
+    }
+    if (_stderrBatch.size() > 0)
+    {
+        fwrite(_stderrBatch.constData(), 1, _stderrBatch.size(), stderr);
+        fflush(stderr);
+    }
+
+    _writtenPosition.storeRelease(position);
+    return numOfEntries;
+}
+
+void AsyncLogger::_appendTime (QByteArray &line, qint64 timestamp)
+{
+    qint64 ms = (_startTimeOfDay + timestamp / 1000000) % (24 * 3600 * 1000);
+
+    char buffer[32];
+    int length = sprintf(buffer, "%02d:%02d:%02d:%03d | ",
+                         (int) (ms / 3600000), (int) ((ms / 60000) % 60),
+                         (int) ((ms / 1000) % 60), (int) (ms % 1000));
+    line.append(buffer, length);
+}
+
+void AsyncLogger::_writeConsole (const QByteArray &line, qint64 timestamp)
+{
+    if (_consoleSink == 0)
+        return;
+
+    // Windows of one second
+    if (timestamp - _consoleWindowStart >= 1000000000LL)
+    {
+        if (_numOfConsoleSkipped > 0)
+            _consoleSink(QString::number(_numOfConsoleSkipped) + " messages not shown in the console");
+        _consoleWindowStart = timestamp;
+        _numOfConsoleLines = 0;
+        _numOfConsoleSkipped = 0;
+    }
+
+    if (_numOfConsoleLines < LOG_CONSOLE_MAX_LINES_PER_SEC)
+    {
+        _consoleSink(QString::fromLatin1(line.constData(), line.size()));
+        _numOfConsoleLines++;
+    }
+    else
+    {
+        _numOfConsoleSkipped++;
+    }
+}
@@ -0,0 +1,245 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+// Qt includes
+#include <QThread>
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+#define LOG_QUEUE_CAPACITY             2048   // Entries in the queue, it must be a power of two
+#define LOG_ENTRY_MAX_LENGTH           512    // [chars] Longer messages are truncated
+#define LOG_DRAIN_PERIOD               20     // [ms] Sleep of the logging thread when the queue is empty
+#define LOG_CONSOLE_MAX_LINES_PER_SEC  50     // Lines per second forwarded to the GUI console
+
+/*!
+ * Function receiving the lines shown in the GUI console
+ */
+typedef void (*ConsoleSink)(const QString &line);
+
+/*!
+ * \class AsyncLogger asynclogger.h
+ *
+ * \brief This class takes the writing of the log out of the threads that
+ * produce it. The message handlers only copy the message into a bounded
+ * lock-free multi-producer single-consumer queue together with a monotonic
+ * timestamp. A background thread drains the queue, formats the lines and
+ * writes every batch to the log file and stderr with a single write and
+ * flush. The lines forwarded to the GUI console are rate limited.
+ *
+ * When the queue is full the message is dropped and counted rather than
+ * blocking the producer; the number of dropped messages is reported in the
+ * log.
+ */
+class AsyncLogger : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /*!
+     * Constructor
+     *
+     * \param file Log file, it must be already open. It is only written from
+     * the logging thread.
+     *
+     * \param parent Parent object
+     */
+    AsyncLogger (QFile *file, QObject *parent = 0);
+
+    /*!
+     * Default destructor. It drains the queue and stops the thread.
+     */
+    virtual ~AsyncLogger ();
+
+    /*!
+     * It sets the function receiving the lines of the GUI console
+     */
+    void setConsoleSink (ConsoleSink sink) { _consoleSink = sink; }
+
+    /*!
+     * It queues a message. It is safe to call from any thread and it never
+     * blocks nor allocates.
+     *
+     * \param type Type of the message
+     *
+     * \param msg Text of the message
+     *
+     * \param toConsole Whether the line is also shown in the GUI console
+     *
+     * \return false when the queue is full and the message was dropped
+     */
+    bool log (QtMsgType type, const QString &msg, bool toConsole);
+
+    /*!
+     * It blocks until every message queued before the call has been written
+     * and flushed. It is used for fatal messages, before aborting.
+     */
+    void flush ();
+
+    /*!
+     * It drains the queue and stops the logging thread
+     */
+    void stop ();
+
+protected:
+
+    /*!
+     * Body of the logging thread
+     */
+    void run ();
+
+private:
+
+    /*!
+     * Queue slot
+     */
+    struct Entry
+    {
+        QAtomicInteger<quint32> sequence;       // Vyukov sequence number of the slot
+        qint64 timestamp;                       // [ns] Since the logger was created
+        QtMsgType type;
+        bool toConsole;
+        int length;
+        char text[LOG_ENTRY_MAX_LENGTH];
+    };
+
+    /*!
+     * It moves the pending entries to the sinks. It is called by the
+     * logging thread and, when the thread is not running, by flush() and
+     * stop() in the caller's thread; _drainMutex serializes them.
+     *
+     * \return The number of entries written
+     */
+    int _drain ();
+
+    /*!
+     * It appends the wall clock time of the given timestamp as
+     * "HH:mm:ss:zzz | "
+     */
+    void _appendTime (QByteArray &line, qint64 timestamp);
+
+    /*!
+     * It forwards a line to the GUI console if the rate limit allows it
+     */
+    void _writeConsole (const QByteArray &line, qint64 timestamp);
+
+    /*!
+     * \property AsyncLogger::_entries
+     *
+     * Ring of LOG_QUEUE_CAPACITY slots
+     */
+    Entry *_entries;
+
+    /*!
+     * \property AsyncLogger::_enqueuePosition
+     *
+     * Next position claimed by a producer
+     */
+    QAtomicInteger<quint32> _enqueuePosition;
+
+    /*!
+     * \property AsyncLogger::_dequeuePosition
+     *
+     * Next position read by the consumer. Only written by _drain.
+     */
+    QAtomicInteger<quint32> _dequeuePosition;
+
+    /*!
+     * \property AsyncLogger::_writtenPosition
+     *
+     * Position up to which the entries have been written and flushed
+     */
+    QAtomicInteger<quint32> _writtenPosition;
+
+    /*!
+     * \property AsyncLogger::_numOfDropped
+     *
+     * Messages dropped because the queue was full
+     */
+    QAtomicInt _numOfDropped;
+
+    /*!
+     * \property AsyncLogger::_isRunning
+     *
+     * Whether the logging thread keeps running
+     */
+    QAtomicInt _isRunning;
+
+    /*!
+     * \property AsyncLogger::_file
+     *
+     * Log file
+     */
+    QFile *_file;
+
+    /*!
+     * \property AsyncLogger::_consoleSink
+     *
+     * Function receiving the lines of the GUI console
+     */
+    ConsoleSink _consoleSink;
+
+    /*!
+     * \property AsyncLogger::_timer
+     *
+     * Monotonic clock of the entries
+     */
+    QElapsedTimer _timer;
+
+    /*!
+     * \property AsyncLogger::_startTimeOfDay
+     *
+     * [ms] Wall clock time of the day when _timer was started
+     */
+    qint64 _startTimeOfDay;
+
+    /*!
+     * \property AsyncLogger::_fileBatch
+     *
+     * Lines of the current batch for the log file
+     */
+    QByteArray _fileBatch;
+
+    /*!
+     * \property AsyncLogger::_stderrBatch
+     *
+     * Lines of the current batch for stderr
+     */
+    QByteArray _stderrBatch;
+
+    /*!
+     * \property AsyncLogger::_consoleWindowStart
+     *
+     * [ns] Start of the current rate limiting window of the console
+     */
+    qint64 _consoleWindowStart;
+
+    /*!
+     * \property AsyncLogger::_numOfConsoleLines
+     *
+     * Lines sent to the console in the current window
+     */
+    int _numOfConsoleLines;
+
+    /*!
+     * \property AsyncLogger::_numOfConsoleSkipped
+     *
+     * Lines not sent to the console in the current window
+     */
+    int _numOfConsoleSkipped;
+
+    /*!
+     * \property AsyncLogger::_drainMutex
+     *
+     * It keeps a single consumer of the queue, the batches and the console
+     * rate limit
+     */
+    QMutex _drainMutex;
+};
+
+#endif // ASYNCLOGGER_H
@@ -6,11 +6,14 @@
 #include <QHash>
 #include <QDebug>
 
+#include "logging.h"
+
 #ifdef Q_WS_MAC
 #include <unistd.h>
 #endif
 
-// This is used for debug
+// This is used for debug. The levelled LOG_* macros of logging.h skip the
+// evaluation of line when the message is filtered out.
 #define loggerMacroDebug(line) qDebug() << __FILE__ << " | " << __LINE__ << " | " << __FUNCTION__ << " | " << line;
 
 // NIC
@@ -0,0 +1,26 @@
+#include "logging.h"
+
+QAtomicInt LogFilter::_levels[LOG_NUM_CATEGORIES] = {
+    LOG_LEVEL_DEBUG,    // LOG_DRIVER
+    LOG_LEVEL_DEBUG,    // LOG_PROTOCOL
+    LOG_LEVEL_DEBUG,    // LOG_FILEWRITER
+    LOG_LEVEL_DEBUG     // LOG_GUI
+};
+
+void LogFilter::setLevel (LogLevel level)
+{
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++)
+        _levels[i].store(level);
+}
+
+const char* LogFilter::categoryName (LogCategory category)
+{
+    switch (category)
+    {
+    case LOG_DRIVER:     return "DRV";
+    case LOG_PROTOCOL:   return "PRT";
+    case LOG_FILEWRITER: return "FWR";
+    case LOG_GUI:        return "GUI";
+    default:             return "";
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QAtomicInt>
+#include <QDebug>
+
+/*!
+ * Severity of a log message
+ */
+enum LogLevel
+{
+    LOG_LEVEL_TRACE   = 0,
+    LOG_LEVEL_DEBUG   = 1,
+    LOG_LEVEL_INFO    = 2,
+    LOG_LEVEL_WARNING = 3,
+    LOG_LEVEL_ERROR   = 4,
+    LOG_LEVEL_NONE    = 5
+};
+
+/*!
+ * Subsystem producing a log message
+ */
+enum LogCategory
+{
+    LOG_DRIVER      = 0,    // Device communication and poll thread
+    LOG_PROTOCOL    = 1,    // Frame parsing and stimulation protocols
+    LOG_FILEWRITER  = 2,    // Recording files
+    LOG_GUI         = 3,    // User interface
+    LOG_NUM_CATEGORIES
+};
+
+// Messages below this level are removed at compile time, their arguments
+// are never evaluated. It can be overridden with DEFINES in the .pro file.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/*!
+ * \class LogFilter logging.h
+ *
+ * \brief Runtime level of every log category. The levels can be changed
+ * from any thread; checking them is a single relaxed atomic load.
+ */
+class LogFilter
+{
+public:
+
+    /*!
+     * It returns whether messages of the given level are written for the
+     * given category
+     */
+    static bool isEnabled (LogCategory category, LogLevel level)
+    {
+        return level >= _levels[category].load();
+    }
+
+    /*!
+     * It sets the minimum level written for a category
+     */
+    static void setLevel (LogCategory category, LogLevel level)
+    {
+        _levels[category].store(level);
+    }
+
+    /*!
+     * It sets the minimum level written for every category
+     */
+    static void setLevel (LogLevel level);
+
+    /*!
+     * It returns the minimum level written for a category
+     */
+    static LogLevel level (LogCategory category)
+    {
+        return (LogLevel) _levels[category].load();
+    }
+
+    /*!
+     * It returns the tag written in front of the messages of a category
+     */
+    static const char* categoryName (LogCategory category);
+
+private:
+
+    /*!
+     * \property LogFilter::_levels
+     *
+     * Minimum level written per category
+     */
+    static QAtomicInt _levels[LOG_NUM_CATEGORIES];
+};
+
+// The body of the loop, and therefore the evaluation of the streamed
+// arguments, only runs when the message is written. Like loggerMacroDebug
+// the macros include the trailing semicolon, and they can be used as the
+// single statement of an if/else.
+#define LOG_IS_ENABLED(level, category) \
+    ((level) >= LOG_COMPILE_LEVEL && LogFilter::isEnabled((category), (level)))
+
+#define LOG_WRITE(category, line) \
+    qDebug() << LogFilter::categoryName(category) << " | " << __FILE__ << " | " \
+             << __LINE__ << " | " << __FUNCTION__ << " | " << line
+
+#define LOG_AT(level, category, line) \
+    for (bool _logEnabled = LOG_IS_ENABLED(level, category); _logEnabled; _logEnabled = false) \
+        LOG_WRITE(category, line);
+
+// Sampled logging: the site writes the first occurrence and then once every
+// n occurrences. The counter is private to the call site.
+#define LOG_AT_EVERY_N(level, category, n, line) \
+    for (bool _logEnabled = LOG_IS_ENABLED(level, category) && \
+                            [&]() { static QAtomicInt counter; \
+                                    return (counter.fetchAndAddRelaxed(1) % (n)) == 0; }(); \
+         _logEnabled; _logEnabled = false) \
+        LOG_WRITE(category, line);
+
+#define LOG_TRACE(category, line)       LOG_AT(LOG_LEVEL_TRACE,   category, line)
+#define LOG_DEBUG(category, line)       LOG_AT(LOG_LEVEL_DEBUG,   category, line)
+#define LOG_INFO(category, line)        LOG_AT(LOG_LEVEL_INFO,    category, line)
+#define LOG_WARNING(category, line)     LOG_AT(LOG_LEVEL_WARNING, category, line)
+#define LOG_ERROR(category, line)       LOG_AT(LOG_LEVEL_ERROR,   category, line)
+
+#define LOG_DEBUG_EVERY_N(category, n, line)    LOG_AT_EVERY_N(LOG_LEVEL_DEBUG,   category, n, line)
+#define LOG_INFO_EVERY_N(category, n, line)     LOG_AT_EVERY_N(LOG_LEVEL_INFO,    category, n, line)
+#define LOG_WARNING_EVERY_N(category, n, line)  LOG_AT_EVERY_N(LOG_LEVEL_WARNING, category, n, line)
+
+#endif // LOGGING_H
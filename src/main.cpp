@@ -2,6 +2,8 @@
 #include <QApplication>
 
 #include "commonparameters.h"
+#include "asynclogger.h"
+#include "noisereduction.h"
 
 // Qt Includes
 #include <QApplication>
@@ -12,95 +14,64 @@
 #include <QTime>
 #include <QPlainTextEdit>
 
+#include <cstdlib>
+#include <cstring>
+
 // Variable to ouput the log
 QFile debuggingFile;
 
+// Background writer of the log
+AsyncLogger* asyncLogger = NULL;
+
 MainWindow* pMainWindow = NULL;
 
 #define ENABLE_MESSAGE_HANDLER
 
 /**
- * @brief nicMessageHandler Handles all qDebug
+ * @brief consoleSink Forwards a log line to the GUI console. It is called
+ * from the logging thread, consoleWrite() queues the line to the GUI thread.
+ * @param line Line to be displayed
+ */
+void consoleSink(const QString &line)
+{
+    if(pMainWindow != NULL){
+        pMainWindow->consoleWrite( line );
+    }
+}
+
+/**
+ * @brief nicLog Queues a message in the asynchronous logger. Fatal messages
+ * are flushed before returning.
  * @param type Type of message sent
  * @param msg  Message sent
+ * @param toConsole Whether the message is shown in the GUI console
  */
-
-void nicMessageHandlerVisual(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+void nicLog(QtMsgType type, const QString &msg, bool toConsole)
 {
-
-    QString line = msg;
-//    if (!debuggingFile.open(QIODevice::WriteOnly | QIODevice::Append))
-//        qDebug()<<"Error opening debuggingFile"<<debuggingFile.fileName()<<line;
-
-    //in this function, you can write the message to any stream!
-    switch (type) {
-        case QtDebugMsg:
-            line.insert(0,QTime::currentTime().toString("HH:mm:ss:zzz | "));
-            line.append("\n");
-            debuggingFile.write(line.toLatin1());
-        break;
-        case QtWarningMsg:
-            fprintf(stderr, "Warning: %s\n", msg.constData());
-        break;
-        case QtCriticalMsg:
-            fprintf(stderr, "Critical: %s\n", msg.constData());
-        break;
-        case QtFatalMsg:
-            line.insert(0,QTime::currentTime().toString("HH:mm:ss:zzz | FATAL "));
-            line.append("\n");
-            debuggingFile.write(line.toLatin1());
-            //abort();
+    if (asyncLogger == NULL){
+        fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
+        return;
     }
 
-    debuggingFile.flush();
+    asyncLogger->log(type, msg, toConsole);
+    if (type == QtFatalMsg)
+        asyncLogger->flush();
+}
 
-    // Output to GUI
-    QString lineGUI = QTime::currentTime().toString("HH:mm:ss:zzz | ") + msg;
-    if(pMainWindow != NULL){
-        pMainWindow->consoleWrite( lineGUI );
-    }
-/**/
-    // Print also to console
-    line = QTime::currentTime().toString("HH:mm:ss:zzz | ") + msg;
-    fprintf(stderr, "%s\n", line.toLocal8Bit().data());
-    fflush(stderr);
+/**
+ * @brief nicMessageHandler Handles all qDebug
+ * @param type Type of message sent
+ * @param msg  Message sent
+ */
 
+void nicMessageHandlerVisual(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    nicLog(type, msg, true);
 }
 
 void nicMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-
-    QString line = msg;
-//    if (!debuggingFile.open(QIODevice::WriteOnly | QIODevice::Append))
-//        qDebug()<<"Error opening debuggingFile"<<debuggingFile.fileName()<<line;
-
-    //in this function, you can write the message to any stream!
-    switch (type) {
-        case QtDebugMsg:
-            line.insert(0,QTime::currentTime().toString("HH:mm:ss:zzz | "));
-            line.append("\n");
-            debuggingFile.write(line.toLatin1());
-        break;
-        case QtWarningMsg:
-            fprintf(stderr, "Warning: %s\n", msg.constData());
-        break;
-        case QtCriticalMsg:
-            fprintf(stderr, "Critical: %s\n", msg.constData());
-        break;
-        case QtFatalMsg:
-            line.insert(0,QTime::currentTime().toString("HH:mm:ss:zzz | FATAL "));
-            line.append("\n");
-            debuggingFile.write(line.toLatin1());
-            //abort();
-    }
-
-    debuggingFile.flush();
-
-    // Print also to console
-    line = QTime::currentTime().toString("HH:mm:ss:zzz | ") + msg;
-    fprintf(stderr, "%s\n", line.toLocal8Bit().data());
-    fflush(stderr);
-
+    nicLog(type, msg, false);
 }
 
 
@@ -129,6 +100,11 @@ void configureLoggging(){
     if (!debuggingFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
         qDebug()<<"Error opening debuggingFile"<<debuggingFile.fileName();
 
+    // Start the thread writing the log
+    asyncLogger = new AsyncLogger(&debuggingFile);
+    asyncLogger->setConsoleSink(consoleSink);
+    asyncLogger->start();
+
     // Install the message handler for qDebug() calls
 #ifdef ENABLE_MESSAGE_HANDLER
     qInstallMessageHandler(nicMessageHandlerVisual);
@@ -138,6 +114,27 @@ void configureLoggging(){
 
 int main(int argc, char *argv[])
 {
+    // A build with AVX2/FMA kernels can not run on older CPUs
+    if (!simd_is_supported()){
+        fprintf(stderr, "This build requires a CPU with AVX2 and FMA\n");
+        return 1;
+    }
+
+#ifdef NOISEREDUCTION_ACCURACY_HARNESS
+    // Accuracy harness: --compare-arithmetics <file.easy> <channels>. It
+    // exits with 1 when the parallel and serial outputs differ.
+    if (argc > 1 && strcmp(argv[1], "--compare-arithmetics") == 0){
+        int numOfChannels = (argc == 4) ? atoi(argv[3]) : 0;
+        if (numOfChannels <= 0){
+            fprintf(stderr, "Usage: %s --compare-arithmetics <file.easy> <channels>\n", argv[0]);
+            return 2;
+        }
+
+        QCoreApplication harness(argc, argv);
+        return NoiseReduction::compareArithmetics(QString::fromLocal8Bit(argv[2]), numOfChannels) ? 0 : 1;
+    }
+#endif
+
     qDebug() << "-- Simple Manager Start --";
 
 
@@ -166,7 +163,15 @@ int main(int argc, char *argv[])
     QObject::connect(&mainWindow, SIGNAL(quit()), &a, SLOT(quit()));
 
 
-    return a.exec();
+    int result = a.exec();
+
+    // Write the pending log lines before leaving
+    qInstallMessageHandler(0);
+    asyncLogger->stop();
+    delete asyncLogger;
+    asyncLogger = NULL;
+
+    return result;
 }
 
 
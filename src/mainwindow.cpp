@@ -15,6 +15,7 @@ MainWindow::MainWindow(QWidget *parent) :
     protocolManager  = new ProtocolManager(deviceManager);
     deviceStatus     = new DeviceStatus(deviceManager, protocolManager);
     fileWriter       = new FileWriter();
+    streamStatistics = new StreamStatistics();
 
     // Set window title
     this->setWindowTitle(APP_NAME);
@@ -30,16 +31,21 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Register MetaTypes
     qRegisterMetaType<ChannelData>("ChannelData");
+    qRegisterMetaType<SampleBlock>("SampleBlock");
     qRegisterMetaType<DeviceManagerTypes::DeviceStatus>("DeviceManagerTypes::DeviceStatus");
     qRegisterMetaType<StimulationState>("StimulationState");
     qRegisterMetaType<DeviceManagerTypes::DeviceType>("DeviceManagerTypes::DeviceType");
 
     // Connect signals&slots from deviceManager
     connect(deviceManager, SIGNAL(receivedDeviceStatus(DeviceManagerTypes::DeviceStatus)),            deviceStatus, SLOT(receivedDeviceStatus(DeviceManagerTypes::DeviceStatus)));
-    connect(deviceManager, SIGNAL(receivedEEGData(ChannelData)),         this, SLOT(receivedEEGData(ChannelData)));
-    connect(deviceManager, SIGNAL(receivedAccelData(ChannelData)),       this, SLOT(receivedAccelData(ChannelData)));
-    connect(deviceManager, SIGNAL(receivedStimulationData(ChannelData)), this, SLOT(receivedStimulationData(ChannelData)));
-    connect(deviceManager, SIGNAL(receivedImpedanceData(ChannelData)),   this, SLOT(receivedImpedanceData(ChannelData)));
+    // The statistics are updated in the poll thread, connected straight to
+    // the StarstimCom signals so that no event is queued per sample. The GUI
+    // only reads them every STATISTICS_REFRESH_PERIOD
+    StarstimCom *starstimCom = deviceManager->getStarstimCom();
+    connect(starstimCom, SIGNAL(receivedEEGData(ChannelData)),         streamStatistics, SLOT(onEEGData(ChannelData)),         Qt::DirectConnection);
+    connect(starstimCom, SIGNAL(receivedAccelData(ChannelData)),       streamStatistics, SLOT(onAccelData(ChannelData)),       Qt::DirectConnection);
+    connect(starstimCom, SIGNAL(receivedStimulationData(ChannelData)), streamStatistics, SLOT(onStimulationData(ChannelData)), Qt::DirectConnection);
+    connect(starstimCom, SIGNAL(receivedImpedanceData(ChannelData)),   streamStatistics, SLOT(onImpedanceData(ChannelData)),   Qt::DirectConnection);
 
     connect(deviceManager, SIGNAL(receivedFirmwareVersion(int)),         this, SLOT(receivedFirmwareVersion(int)));
     connect(deviceManager, SIGNAL(receivedProfile(DeviceManagerTypes::DeviceType,int, int,int,int,int)),
@@ -82,9 +88,15 @@ MainWindow::MainWindow(QWidget *parent) :
     deviceStatus->moveToThread(statusThread);
     statusThread->start();
 
+    // Refresh of the stream statistics
+    statisticsTimer = new QTimer(this);
+    connect(statisticsTimer, SIGNAL(timeout()), this, SLOT(refreshStatistics()));
+    statisticsTimer->start(STATISTICS_REFRESH_PERIOD);
+
 }
 
 MainWindow::~MainWindow(){
+    statisticsTimer->stop();
     delete ui;
 }
 
@@ -111,6 +123,7 @@ void MainWindow::initialize(){
     fileWriter->setRecordingEASYFile(true);
     fileWriter->setRecordingSTIMFile(true);
     fileWriter->setRecordingNEDFFile(false);
+    fileWriter->setSyncPolicy(AsyncFileSink::SYNC_PERIODIC, 1000);
 
     // Value of address
     QHostAddress mask = QHostAddress("255.255.255.0");
@@ -369,9 +382,10 @@ void MainWindow::startStreaming(){
 //    deviceManager->writeRegister(DeviceManagerTypes::SDCARD_REGISTERS, 280, array);
     return;
 /**/
-    // Start Writing
+    // Start Writing, the length of the recording is not known
 #ifdef ENABLE_EASY_FILE
     loggerMacroDebug("Start Writing easy file")
+    fileWriter->setExpectedDuration(0);
     fileWriter->startWriting();
 #endif
 
@@ -437,13 +451,6 @@ void MainWindow::stopStreaming(){
 void MainWindow::launchStimulation(){
     loggerMacroDebug("clicked launchStimulation")
 
-    // Start Writing
-#ifdef ENABLE_EASY_FILE
-    loggerMacroDebug("Start Writing easy file")
-    fileWriter->startWriting();
-    fileWriter->startWritingStimData();
-#endif
-
 // -----------------------------------------------
 // NEW SIMPLEMANAGER Current Configuration
 // -----------------------------------------------
@@ -558,6 +565,14 @@ void MainWindow::launchStimulation(){
 // ---------------------------------------
 
 
+    // Start Writing, the files are reserved for the whole session
+#ifdef ENABLE_EASY_FILE
+    loggerMacroDebug("Start Writing easy file")
+    fileWriter->setExpectedDuration(currentConfiguration.sessionDuration());
+    fileWriter->startWriting();
+    fileWriter->startWritingStimData();
+#endif
+
     // Create Fake StimSession for compatibility with NICHome
     StimSession stimSession;
     stimSession.sessionId = 0;
@@ -593,51 +608,32 @@ void MainWindow::receivedProfile(DeviceManagerTypes::DeviceType deviceType, int
 
 
 
-void MainWindow::receivedEEGData(ChannelData data){
-    QMutexLocker locker(&_mutex);
-//    QtMessageHandler msgHandler = qInstallMessageHandler(0);
-    qInstallMessageHandler(nicMessageHandler);
+void MainWindow::refreshStatistics(){
 
-    static int eeg_counter = 0;    
-    if( (eeg_counter % 300) == 0){
-        loggerMacroDebug("New EEG Data with timestamp " + QString::number(data.timestamp()) + " Total EEG Data:" + QString::number(eeg_counter) + " samples")
+    QString message;
+    for (int i = 0; i < StreamStatistics::NUM_OF_STREAMS; i++){
+        StreamStatistics::Stream stream = (StreamStatistics::Stream) i;
+        StreamStatistics::Snapshot snapshot = streamStatistics->takeSnapshot(stream);
+        message += QString(StreamStatistics::streamName(stream)) + ": "
+                + QString::number(snapshot.numOfSamples) + " samples "
+                + QString::number(snapshot.rate, 'f', 1) + " Hz "
+                + QString::number(snapshot.numOfGaps) + " gaps "
+                + "last " + QString::number(snapshot.lastTimestamp) + "   ";
     }
-    eeg_counter ++;
 
-
-//    qInstallMessageHandler(msgHandler);
-    qInstallMessageHandler(nicMessageHandlerVisual);
-}
-
-void MainWindow::receivedAccelData(ChannelData data){
-    QMutexLocker locker(&_mutex);
-    //QtMessageHandler msgHandler = qInstallMessageHandler(0);
-    qInstallMessageHandler(nicMessageHandler);
-
-    static int accel_counter = 0;
-    if( (accel_counter % 300) == 0){
-        loggerMacroDebug("New AccelData with timestamp " + QString::number(data.timestamp()) + " Total ACCEL Data:" + QString::number(accel_counter) + " samples")
+    // Buffers waiting for the disk and time the data reception waited
+    const char *writerNames[] = { "EASY", "NEDF", "NEDC", "STIM" };
+    AsyncFileSink::Statistics writers[] = { fileWriter->easyWriterStatistics(),
+                                            fileWriter->binaryWriterStatistics(),
+                                            fileWriter->compressedWriterStatistics(),
+                                            fileWriter->stimWriterStatistics() };
+    for (int i = 0; i < 4; i++){
+        message += QString(writerNames[i]) + " writer: queue "
+                + QString::number(writers[i].queueDepth) + "/"
+                + QString::number(writers[i].maxQueueDepth) + " stall "
+                + QString::number(writers[i].producerStallTime) + " ms   ";
     }
-    accel_counter ++;
-
-
-//    qInstallMessageHandler(msgHandler);
-    qInstallMessageHandler(nicMessageHandlerVisual);
-}
-
-void MainWindow::receivedStimulationData(ChannelData data){
-    QMutexLocker locker(&_mutex);
-    //QtMessageHandler msgHandler = qInstallMessageHandler(0);
-    qInstallMessageHandler(nicMessageHandler);
-    //loggerMacroDebug("new stimulation data at " + QString::number(data.timestamp()))
-    //loggerMacroDebug("Sample[0]" + QString::number(data.data()[0]))
-    static int stim_counter = 0;
-    if( (stim_counter % 1000) == 0){
-        loggerMacroDebug("New STM Data with timestamp " + QString::number(data.timestamp()) + " Total STM Data:" + QString::number(stim_counter) + " samples")
-    }
-    stim_counter ++;
-//    qInstallMessageHandler(msgHandler);
-    qInstallMessageHandler(nicMessageHandlerVisual);
+    statusBar()->showMessage(message);
 }
 
 void MainWindow::receivedFirmwareVersion(int firmwareVersion){
@@ -647,17 +643,6 @@ void MainWindow::receivedFirmwareVersion(int firmwareVersion){
     loggerMacroDebug("Device type ->" + deviceManager->deviceType2String())
 }
 
-void MainWindow::receivedImpedanceData(ChannelData data){
-    QMutexLocker locker(&_mutex);
-    //QtMessageHandler msgHandler = qInstallMessageHandler(0);
-    qInstallMessageHandler(nicMessageHandler);
-    loggerMacroDebug("New impedance data at " + QString::number(data.timestamp()))
-
-//    qInstallMessageHandler(msgHandler);
-    qInstallMessageHandler(nicMessageHandlerVisual);
-}
-
-
 //////////////////////////////////
 // Protocol Manager Slots
 //////////////////////////////////
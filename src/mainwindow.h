@@ -4,16 +4,19 @@
 // Qt Includes
 #include <QMainWindow>
 #include <QTcpSocket>
+#include <QTimer>
 
 // Project includes
 #include "commonparameters.h"
 #include "devicemanager.h"
 #include "devicestatus.h"
+#include "streamstatistics.h"
 #include "filewriter.h"
 #include "devicemanagertypes.h"
 #include "deviceconfiguration.h"
 
 #define APP_NAME "NICBenchmark2"
+#define STATISTICS_REFRESH_PERIOD 250 // [ms] refresh period of the stream statistics
 
 namespace Ui {
 class MainWindow;
@@ -71,8 +74,6 @@ private:
     // ATTRIBUTES
     // ----------------
 
-    QMutex _mutex;
-
     /*!
      * \brief ui holds the graphical representation made by the UI designer
      */
@@ -108,6 +109,16 @@ private:
      */
     FileWriter* fileWriter;
 
+    /*!
+     * Counters of the received streams, updated from the poll thread
+     */
+    StreamStatistics* streamStatistics;
+
+    /*!
+     * Timer refreshing the stream statistics in the status bar
+     */
+    QTimer* statisticsTimer;
+
     /*!
      * Searches the device with an UDP protocol
      */
@@ -198,18 +209,10 @@ private slots:
     void receivedProfile(DeviceManagerTypes::DeviceType deviceType, int n_channel,
                          int batteryLevel, int firmwareVersion, int t1, int t2);
     /*!
-     * Slot that is raised whenever a new EEG data is received.
-     *
-     * \param data The new received sample data
+     * Slot raised by statisticsTimer. It shows the statistics of the
+     * received streams and of the file writers in the status bar.
      */
-    void receivedEEGData(ChannelData data);
-
-    /*!
-     * Slot that is raised whenever a new ACCEL data is received.
-     *
-     * \param data The new received sample data
-     */
-    void receivedAccelData(ChannelData data);
+    void refreshStatistics();
 
 
     /*!
@@ -220,22 +223,6 @@ private slots:
      */
     void receivedFirmwareVersion(int firmwareVersion);
 
-    /*!
-     * Signal that is emitted whenever a new stimulation data is received.
-     *
-     * \param data The new received sample data
-     */
-    void receivedStimulationData(ChannelData data);
-
-    /*!
-     * Signal that is emitted whenever a new Impedance data is received.
-     *
-     * \param data The new received sample data
-     *
-     * \param timeStamp The timeStamp of the data
-     */
-    void receivedImpedanceData(ChannelData data);
-
     // Slots for signals from protocol Manager
 
     /*!
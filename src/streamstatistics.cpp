@@ -0,0 +1,79 @@
+#include "streamstatistics.h"
+
+StreamStatistics::StreamStatistics (QObject *parent) :
+    QObject(parent)
+{
+    _timer.start();
+    reset();
+}
+
+void StreamStatistics::reset ()
+{
+    for (int i = 0; i < NUM_OF_STREAMS; i++)
+    {
+        _numOfSamples[i].store(0);
+        _numOfGaps[i].store(0);
+        _lastTimestamp[i].store(0);
+        _previousNumOfSamples[i] = 0;
+        _previousSnapshotTime[i] = _timer.elapsed();
+    }
+}
+
+StreamStatistics::Snapshot StreamStatistics::takeSnapshot (Stream stream)
+{
+    Snapshot snapshot;
+    snapshot.numOfSamples  = _numOfSamples[stream].load();
+    snapshot.numOfGaps     = _numOfGaps[stream].load();
+    snapshot.lastTimestamp = (unsigned long long) _lastTimestamp[stream].load();
+
+    qint64 now = _timer.elapsed();
+    qint64 elapsed = now - _previousSnapshotTime[stream];
+    snapshot.rate = (elapsed > 0) ?
+                (snapshot.numOfSamples - _previousNumOfSamples[stream]) * 1000.0 / elapsed : 0.0;
+
+    _previousNumOfSamples[stream] = snapshot.numOfSamples;
+    _previousSnapshotTime[stream] = now;
+
+    return snapshot;
+}
+
+const char* StreamStatistics::streamName (Stream stream)
+{
+    switch (stream)
+    {
+    case EEG_STREAM:         return "EEG";
+    case ACCEL_STREAM:       return "ACCEL";
+    case STIMULATION_STREAM: return "STM";
+    case IMPEDANCE_STREAM:   return "IMP";
+    default:                 return "";
+    }
+}
+
+void StreamStatistics::onEEGData (ChannelData data)
+{
+    _update(EEG_STREAM, data);
+}
+
+void StreamStatistics::onAccelData (ChannelData data)
+{
+    _update(ACCEL_STREAM, data);
+}
+
+void StreamStatistics::onStimulationData (ChannelData data)
+{
+    _update(STIMULATION_STREAM, data);
+}
+
+void StreamStatistics::onImpedanceData (ChannelData data)
+{
+    _update(IMPEDANCE_STREAM, data);
+}
+
+void StreamStatistics::_update (Stream stream, ChannelData& data)
+{
+    // Single writer per stream, so relaxed increments are enough
+    _numOfSamples[stream].fetchAndAddRelaxed(1);
+    if (data.isRepeated())
+        _numOfGaps[stream].fetchAndAddRelaxed(1);
+    _lastTimestamp[stream].storeRelease((qint64) data.timestamp());
+}
@@ -0,0 +1,150 @@
+#ifndef STREAMSTATISTICS_H
+#define STREAMSTATISTICS_H
+
+// Qt includes
+#include <QObject>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+// Project includes
+#include "channeldata.h"
+
+/*!
+ * \class StreamStatistics streamstatistics.h
+ *
+ * \brief This class aggregates the statistics of the streams received from
+ * the device. The slots are meant to be connected with
+ * Qt::DirectConnection so that they run in the poll thread; they only
+ * perform a few atomic stores per sample and never lock. The GUI reads the
+ * figures with takeSnapshot() at its own refresh rate.
+ */
+class StreamStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /*!
+     * Streams whose statistics are collected
+     */
+    enum Stream
+    {
+        EEG_STREAM,
+        ACCEL_STREAM,
+        STIMULATION_STREAM,
+        IMPEDANCE_STREAM,
+        NUM_OF_STREAMS
+    };
+
+    /*!
+     * Values of one stream at a given time
+     */
+    struct Snapshot
+    {
+        int numOfSamples;                   // Samples received since the last reset
+        int numOfGaps;                      // Repeated samples filling lost packets
+        unsigned long long lastTimestamp;   // Timestamp of the last sample
+        double rate;                        // [samples/s] Since the previous snapshot
+    };
+
+    /*!
+     * Constructor
+     *
+     * \param parent Parent object
+     */
+    StreamStatistics (QObject *parent = 0);
+
+    /*!
+     * It sets all the counters to zero
+     */
+    void reset ();
+
+    /*!
+     * It returns the statistics of the given stream. The rate is computed
+     * from the samples received since the previous call, so it should only
+     * be called from a single thread.
+     *
+     * \param stream Stream to query
+     */
+    Snapshot takeSnapshot (Stream stream);
+
+    /*!
+     * It returns the name of the given stream
+     */
+    static const char* streamName (Stream stream);
+
+public slots:
+
+    /*!
+     * Slot that is raised whenever a new EEG data is received.
+     */
+    void onEEGData (ChannelData data);
+
+    /*!
+     * Slot that is raised whenever a new ACCEL data is received.
+     */
+    void onAccelData (ChannelData data);
+
+    /*!
+     * Slot that is raised whenever a new stimulation data is received.
+     */
+    void onStimulationData (ChannelData data);
+
+    /*!
+     * Slot that is raised whenever a new impedance data is received.
+     */
+    void onImpedanceData (ChannelData data);
+
+private:
+
+    /*!
+     * It updates the counters of the given stream with a new sample
+     */
+    void _update (Stream stream, ChannelData& data);
+
+    /*!
+     * \property StreamStatistics::_numOfSamples
+     *
+     * Samples received per stream. Written by the poll thread only.
+     */
+    QAtomicInt _numOfSamples[NUM_OF_STREAMS];
+
+    /*!
+     * \property StreamStatistics::_numOfGaps
+     *
+     * Repeated samples received per stream. Written by the poll thread only.
+     */
+    QAtomicInt _numOfGaps[NUM_OF_STREAMS];
+
+    /*!
+     * \property StreamStatistics::_lastTimestamp
+     *
+     * Timestamp of the last sample per stream
+     */
+    QAtomicInteger<qint64> _lastTimestamp[NUM_OF_STREAMS];
+
+    /*!
+     * \property StreamStatistics::_previousNumOfSamples
+     *
+     * Number of samples at the previous snapshot. Only accessed by the
+     * thread calling takeSnapshot().
+     */
+    int _previousNumOfSamples[NUM_OF_STREAMS];
+
+    /*!
+     * \property StreamStatistics::_previousSnapshotTime
+     *
+     * Time of the previous snapshot per stream in ms
+     */
+    qint64 _previousSnapshotTime[NUM_OF_STREAMS];
+
+    /*!
+     * \property StreamStatistics::_timer
+     *
+     * Monotonic time base of the rate computation
+     */
+    QElapsedTimer _timer;
+};
+
+#endif // STREAMSTATISTICS_H